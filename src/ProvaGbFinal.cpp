@@ -13,6 +13,29 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <memory>
+#include <deque>
+#include <atomic>
+#include <numeric>
+#include <iomanip>
+
+// SSE2 para filtrar os mipmaps (um pixel RGBA em float = um registrador de 4 floats) e tesselar a curva (4 amostras por vez)
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIPMAP_SSE2
+#endif
 
 using namespace std;
 
@@ -25,28 +48,220 @@ using namespace std;
 // GLM
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+// Mapeamento de arquivos em memória (leitura das imagens sem cópia intermediária)
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 using namespace glm;
 
 #include <cmath>
 
+// Formatos S3TC (EXT_texture_compression_s3tc) - a GLAD foi gerada sem extensões
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
 // Protótipo da função de callback de teclado
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mode);
-void updateCameraPos(GLFWwindow *window);
 void mouse_callback(GLFWwindow *window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void mouse_button_callback(GLFWwindow *window, int button, int action, int mods);
 // Protótipos das funções
 int setupShader();
 int setupSkyboxShader();
+int setupShaderCaixa();
 GLuint loadTexture(string filePath, int &width, int &height);
-int loadSimpleOBJ(string filePATH, int &nVertices, string &nomeMtl);
+int loadSimpleOBJ(string filePATH, int &nVertices, string &nomeMtl, glm::vec3 &centro, float &raio);
+GLuint criarVAOdoOBJ(GLuint VBO);
 GLuint loadCubemap(vector<std::string> faces);
 std::vector<glm::vec3> loadPontosDaCurvaDoArquivo(const std::string& filePath);
 
+// Um nível da cadeia de mipmaps (RGBA8 ou blocos BC já comprimidos)
+struct NivelMip
+{
+    int largura, altura;
+    std::vector<unsigned char> dados;
+};
+
+// Textura pronta para upload, com todos os níveis de mip
+struct TexturaCache
+{
+    GLenum formato; // GL_COMPRESSED_RGB_S3TC_DXT1_EXT / GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, ou GL_RGB8 / GL_RGBA8 (pixels sempre com 4 bytes)
+    std::vector<NivelMip> niveis;
+};
+
+// Filtro usado para gerar os mipmaps na CPU
+enum FiltroMipmap
+{
+    FILTRO_CAIXA, // média simples dos pixels cobertos
+    FILTRO_KAISER // sinc com janela de Kaiser, mais nítido e com menos aliasing
+};
+
+// Pesos de um filtro 1D para um pixel de destino: origem[primeiro + k] * pesos[k]
+struct PesosFiltro
+{
+    int primeiro;
+    std::vector<float> pesos;
+};
+
+// Arquivo inteiro mapeado em memória (somente leitura)
+struct ArquivoMapeado
+{
+    const unsigned char *dados = nullptr;
+    size_t tamanho = 0;
+#ifdef _WIN32
+    HANDLE arquivo = INVALID_HANDLE_VALUE, mapeamento = nullptr;
+#endif
+};
+
+// Imagem já decodificada pela stb_image; os pixels são liberados quando a última cópia sai de escopo
+struct ImagemDecodificada
+{
+    int largura = 0, altura = 0;
+    int canais = 0;        // canais em dados
+    int canaisArquivo = 0; // canais da imagem original
+    std::shared_ptr<unsigned char> dados;
+};
+
+// Resultado da parte de CPU do carregamento de uma textura (feita fora da thread da OpenGL)
+struct TexturaPreparada
+{
+    std::string caminho;
+    TexturaCache textura; // niveis vazio se a imagem não pôde ser lida
+    bool usouCache = false;
+    float msCPU = 0.0f;
+};
+
+struct ContadorJobs;
+
+// Unidade de trabalho do sistema de jobs; o contador (opcional) é decrementado quando ela termina
+struct Job
+{
+    std::function<void()> funcao;
+    ContadorJobs *contador = nullptr;
+};
+
+// Deque de um worker: o dono insere e retira do fim (o job mais recente, com os dados ainda no cache)
+// e os outros workers roubam do início
+struct DequeDeJobs
+{
+    std::mutex mutex;
+    std::deque<Job> jobs;
+};
+
+// Contador de dependências: jobs que ainda faltam terminar e os que só podem começar quando ele chegar a zero
+struct ContadorJobs
+{
+    std::atomic<int> restantes{0};
+    std::mutex mutex;
+    std::vector<Job> continuacoes;
+};
+
+// Sistema de jobs com roubo de trabalho: uma deque por worker e mais uma para as threads de fora
+// (a principal e a de carregamento). É o único pool do processo: carregamento, mipmaps, culling e curva usam ele
+struct SistemaDeJobs
+{
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<DequeDeJobs>> deques; // [0, n) workers, [n] threads de fora
+    std::atomic<int> jobsNaFila{0};
+    std::atomic<bool> encerrar{false};
+    std::mutex mutexSono;
+    std::condition_variable temJob;
+    std::atomic<long> roubos{0};
+};
+
+void iniciarSistemaDeJobs(SistemaDeJobs &sistema, int nWorkers);
+void encerrarSistemaDeJobs(SistemaDeJobs &sistema);
+void enviarJob(SistemaDeJobs &sistema, std::function<void()> funcao, ContadorJobs *contador = nullptr);
+void enviarJobDepoisDe(SistemaDeJobs &sistema, ContadorJobs &dependencia, std::function<void()> funcao, ContadorJobs *contador = nullptr);
+void inserirJob(SistemaDeJobs &sistema, Job job);
+bool pegarJob(SistemaDeJobs &sistema, Job &job);
+void executarJob(SistemaDeJobs &sistema, Job &job);
+void esperarContador(SistemaDeJobs &sistema, ContadorJobs &contador);
+template <typename Funcao> auto enviarJobComResultado(SistemaDeJobs &sistema, Funcao funcao) -> std::future<decltype(funcao())>;
+bool mapearArquivo(const std::string &filePath, ArquivoMapeado &arquivo);
+void desmapearArquivo(ArquivoMapeado &arquivo);
+ImagemDecodificada decodificarImagem(const std::string &filePath, int canaisDesejados);
+TexturaPreparada prepararTextura(const std::string &filePath, bool comprimir, bool repetirBordas);
+TexturaPreparada prepararTexturaProvisoria(const std::string &filePath, bool repetirBordas);
+bool cacheDeTexturaValido(const std::string &filePath, bool comprimir);
+ImagemDecodificada decodificarJPEGReduzido(const std::string &filePath);
+
+// Textura provisória (1/8 da resolução) esperando a versão completa ficar pronta no pool
+struct TrocaDeTextura
+{
+    GLuint texID;
+    GLenum alvo; // GL_TEXTURE_2D ou GL_TEXTURE_CUBE_MAP (6 partes, uma por face)
+    std::vector<std::shared_future<TexturaPreparada>> partes;
+};
+
+// Par de preparações de uma textura: a provisória só existe quando não há cache pronto
+struct RequisicaoTextura
+{
+    std::shared_future<TexturaPreparada> provisoria;
+    std::shared_future<TexturaPreparada> completa;
+};
+
+void processarTrocasDeTexturas();
+void enviarFacesCubemap(GLuint texID, const std::vector<TexturaPreparada> &faces);
+GLuint enviarTextura(const TexturaPreparada &preparada, int &width, int &height);
+void requisitarTextura(const std::string &filePath);
+void marcarFaseInicializacao(const std::string &nome);
+void imprimirFasesInicializacao();
+bool suportaCompressaoS3TC();
+std::vector<NivelMip> gerarCadeiaMipmapRGBA(const unsigned char *rgba, int width, int height, bool repetirBordas);
+std::vector<PesosFiltro> calcularPesosFiltro(int tamanhoOrigem, int tamanhoDestino, FiltroMipmap filtro);
+const float *tabelaSRGBParaLinear();
+unsigned char linearParaSRGB(float valor);
+void comprimirBlocoBC1(const unsigned char *bloco, unsigned char *saida);
+void comprimirBlocoBC3(const unsigned char *bloco, unsigned char *saida);
+NivelMip comprimirNivelBC(const NivelMip &nivel, bool comAlpha);
+bool salvarCacheDDS(const std::string &filePath, const TexturaCache &textura);
+bool carregarCacheDDS(const std::string &filePath, TexturaCache &textura);
+bool cabecalhoDDSAtual(const uint32_t cabecalho[31]);
+bool formatoComprimido(GLenum formato);
+const char *nomeFormato(GLenum formato);
+void enviarNiveisMip(GLenum alvo, const TexturaCache &textura);
+GLuint uploadTextura2D(const TexturaCache &textura, GLuint texExistente = 0);
+void alocarNivelMip(GLenum alvo, const TexturaCache &textura, int nivel);
+void enviarNivelMip(GLenum alvo, const TexturaCache &textura, int nivel);
+
+// Textura 2D com residência controlada por GL_TEXTURE_BASE_LEVEL: todos os níveis são alocados uma vez,
+// mas só os níveis >= nivelResidente são enviados e amostrados
+struct TexturaStreaming
+{
+    GLuint texID;
+    TexturaCache textura; // cópia de todos os níveis na CPU
+    int nivelResidente;   // GL_TEXTURE_BASE_LEVEL atual
+    int nivelMinimo;      // níveis a partir deste ficam sempre na GPU (mips pequenos)
+    int nivelDesejado;    // calculado pelo tamanho dos objetos na tela
+    long ultimoUso;       // último frame em que algum objeto usou a textura
+    int nivelEmEnvio = -1; // nível sendo enviado pelo agendador de uploads (-1 = nenhum)
+};
+
+GLuint registrarTexturaStreaming(const TexturaCache &textura, GLuint texExistente = 0);
+TexturaStreaming criarTexturaStreaming(const TexturaCache &textura, GLuint texExistente);
+void definirNivelResidente(TexturaStreaming &ts, int nivel);
+size_t bytesResidentes(const TexturaStreaming &ts);
+size_t bytesResidentesTexturas();
+size_t requisicoesPendentesTexturas();
+template <typename Funcao> void executarEmParalelo(int inicio, int fim, Funcao funcao, int tamanhoLote = 0);
+
 // Dimensões da janela (pode ser alterado em tempo de execução)
 const GLuint WIDTH = 800, HEIGHT = 600;
 
@@ -79,17 +294,119 @@ void main()
     color = texture(skybox, TexCoords);
 })";
 
+// Caixa envolvente desenhada nas consultas de oclusão (com a escrita de cor e de profundidade desligadas)
+const GLchar* caixaVertexShaderSource = R"(
+#version 400
+layout (location = 0) in vec3 position;
+
+uniform mat4 mvp;
+
+void main()
+{
+    gl_Position = mvp * vec4(position, 1.0);
+})";
+
+const GLchar* caixaFragmentShaderSource = R"(
+#version 400
+out vec4 color;
+
+void main()
+{
+    color = vec4(1.0);
+})";
+
+// Curva tesselada na GPU: cada patch são 4 pontos de controle (um segmento) e vira uma linha com
+// um número de trechos proporcional ao tamanho do segmento na tela
+const GLchar* curvaVertexShaderSource = R"(
+#version 400
+layout (location = 0) in vec3 position;
+
+void main()
+{
+    gl_Position = vec4(position, 1.0);
+})";
+
+const GLchar* curvaTessControlShaderSource = R"(
+#version 400
+layout (vertices = 4) out;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec2 tamanhoTela;
+uniform float pixelsPorTrecho;
+
+// Posição do ponto na tela em pixels; pontos atrás da câmera ficam com w pequeno e vão para longe,
+// o que só aumenta o nível (nunca deixa um segmento que cruza a câmera com poucos trechos)
+vec2 naTela(vec4 p)
+{
+    vec4 clip = projection * view * p;
+    return clip.xy / max(clip.w, 0.01) * 0.5 * tamanhoTela;
+}
+
+void main()
+{
+    gl_out[gl_InvocationID].gl_Position = gl_in[gl_InvocationID].gl_Position;
+    if (gl_InvocationID == 0)
+    {
+        vec2 s0 = naTela(gl_in[0].gl_Position);
+        vec2 s1 = naTela(gl_in[1].gl_Position);
+        vec2 s2 = naTela(gl_in[2].gl_Position);
+        vec2 s3 = naTela(gl_in[3].gl_Position);
+        // A curva vai de P1 a P2; as tangentes vêm de P0 e P3, então metade desses lados entra na estimativa
+        float pixels = length(s2 - s1) + 0.5 * (length(s1 - s0) + length(s3 - s2));
+        gl_TessLevelOuter[0] = 1.0;
+        gl_TessLevelOuter[1] = clamp(pixels / pixelsPorTrecho, 1.0, 64.0);
+    }
+})";
+
+const GLchar* curvaTessEvalShaderSource = R"(
+#version 400
+layout (isolines, equal_spacing) in;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+void main()
+{
+    float t = gl_TessCoord.x;
+    vec3 p0 = gl_in[0].gl_Position.xyz;
+    vec3 p1 = gl_in[1].gl_Position.xyz;
+    vec3 p2 = gl_in[2].gl_Position.xyz;
+    vec3 p3 = gl_in[3].gl_Position.xyz;
+    // Mesma base de initializeCatmullRomMatrix
+    vec3 a = -0.5 * p0 + 1.5 * p1 - 1.5 * p2 + 0.5 * p3;
+    vec3 b = p0 - 2.5 * p1 + 2.0 * p2 - 0.5 * p3;
+    vec3 c = -0.5 * p0 + 0.5 * p2;
+    vec3 ponto = ((a * t + b) * t + c) * t + p1;
+    gl_Position = projection * view * vec4(ponto, 1.0);
+})";
+
+const GLchar* curvaFragmentShaderSource = R"(
+#version 400
+uniform vec3 fixedColor;
+
+out vec4 color;
+
+void main()
+{
+    color = vec4(fixedColor, 1.0);
+})";
+
 const GLchar* vertexShaderSource = R"(
 #version 400
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 color;
 layout (location = 2) in vec2 texc;
 layout (location = 3) in vec3 normal;
+layout (location = 4) in vec3 instanciaPosicao; // seguidores de curva: posição e orientação (quatérnio) de cada instância
+layout (location = 5) in vec4 instanciaOrientacao;
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 uniform vec3 fixedColor;
+uniform bool instanciado;
+uniform float escalaInstancia;
 
 out vec2 texCoord;
 out vec3 vNormal;
@@ -97,8 +414,19 @@ out vec4 fragPos;
 out vec4 vColor;
 void main()
 {
-   	gl_Position = projection * view * model * vec4(position.x, position.y, position.z, 1.0);
-	fragPos = model * vec4(position.x, position.y, position.z, 1.0);
+	vec4 posicaoMundo;
+	if (instanciado) {
+		// Mesma ordem de atualizarTransformacoes: escala, orientação, translação
+		vec3 p = position * escalaInstancia;
+		vec3 q = instanciaOrientacao.xyz;
+		p += 2.0 * cross(q, cross(q, p) + instanciaOrientacao.w * p);
+		posicaoMundo = vec4(p + instanciaPosicao, 1.0);
+	}
+	else {
+		posicaoMundo = model * vec4(position.x, position.y, position.z, 1.0);
+	}
+   	gl_Position = projection * view * posicaoMundo;
+	fragPos = posicaoMundo;
 	texCoord = vec2(texc.s, 1 - texc.t);
 	vNormal = normal;
 	vColor = vec4(color,1.0);
@@ -203,6 +531,8 @@ struct Material {
 	std::string textureFile;
 };
 
+struct BVHMalha;
+
 struct Object
 {
 	GLuint VAO; //Índice do buffer de geometria
@@ -214,23 +544,593 @@ struct Object
 	bool rotateX=false, rotateY=false, rotateZ=false;
     string nomeDoMaterial;
     std::string NomeObj;
-    float AnguloRotacao;
+    glm::quat orientacao = glm::angleAxis(glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)); // +z do modelo para +x do mundo
 	Material material;
 	int TextureimgWidth, TextureimgHeight;
+	glm::vec3 centroLocal = glm::vec3(0.0f); // esfera envolvente da malha, antes da matriz model
+	float raioLocal = 1.0f;
+	bool visivel = true; // resultado do culling por frustum do frame atual
+	GLuint VBO = 0; // buffer dos vértices completos (usado para saber quando o refinamento termina)
+	GLuint VAOProvisorio = 0; // malha simplificada desenhada enquanto o VBO completo ainda está sendo enviado
+	GLuint VBOProvisorio = 0; // vértices da malha simplificada (apagado junto com o VAOProvisorio)
+	int nVerticesProvisorio = 0;
+	int folhaArvore = -1; // nó do objeto na árvore da cena (-1 = ainda não inserido)
+	std::shared_ptr<const BVHMalha> bvhMalha; // triângulos da malha para a seleção por raio (compartilhado entre objetos com o mesmo OBJ)
+	std::shared_ptr<const std::vector<glm::vec3>> oclusor; // posições da malha (3 vértices por triângulo) para o culling por oclusão
+	bool consultaDeOclusao = true; // testa a caixa do objeto com consultas de oclusão na GPU (consultaOclusao no arquivo de configuração)
+	GLuint consulta = 0; // consulta da caixa do objeto (criada na primeira vez que ele é consultado)
+	bool consultaValida = false; // a última consulta foi emitida com o objeto no frustum e ainda decide o desenho condicional
+	bool visivelNaConsulta = true; // último resultado lido da consulta
+	long proximaConsulta = 0; // frame das consultas a partir do qual um objeto visível volta a ser consultado
+};
+
+// Caixa alinhada aos eixos (vazia enquanto minimo > maximo)
+struct CaixaEnvolvente
+{
+    glm::vec3 minimo = glm::vec3(1e30f), maximo = glm::vec3(-1e30f);
+};
+
+// BVH estática num vetor, em pré-ordem: o filho esquerdo de um nó interno é o nó seguinte e o direito é `primeiro`.
+// Numa folha (quantidade > 0), `primeiro` indexa itens, que guarda os índices das caixas usadas na construção
+struct NoBVH
+{
+    CaixaEnvolvente caixa;
+    int primeiro = 0;
+    int quantidade = 0;
+};
+
+struct BVH
+{
+    std::vector<NoBVH> nos;
+    std::vector<int> itens;
+};
+
+void construirBVH(BVH &bvh, const std::vector<CaixaEnvolvente> &caixas);
+void reajustarBVH(BVH &bvh, const std::vector<CaixaEnvolvente> &caixas);
+
+// Quatro triângulos lado a lado (SoA) para o teste de raio com SSE2; vagas sobrando têm arestas nulas e nunca acertam
+struct PacoteTriangulos
+{
+    alignas(16) float v0[3][4];
+    alignas(16) float aresta1[3][4];
+    alignas(16) float aresta2[3][4];
+    int indices[4]; // triângulo na malha (primeiro vértice / 3), -1 nas vagas
+};
+
+// BVH dos triângulos de uma malha, construída por SAH na leitura do OBJ. Cada folha é um pacote
+// (no nó folha, `primeiro` indexa pacotes e não itens)
+struct BVHMalha
+{
+    BVH bvh;
+    std::vector<PacoteTriangulos> pacotes;
+    int triangulos = 0;
+    float msConstrucao = 0.0f;
+};
+
+std::shared_ptr<const BVHMalha> construirBVHMalha(const std::vector<GLfloat> &vBuffer);
+int raioNaMalha(const BVHMalha &malha, glm::vec3 origem, glm::vec3 direcao, float &distancia);
+
+// C(t) = a t³ + b t² + c t + d num segmento (colunas de G * M)
+struct CoeficientesSegmento
+{
+    glm::vec3 a, b, c, d;
 };
 
 struct Curve
 {
     std::vector<glm::vec3> controlPoints; // Pontos de controle da curva
-    std::vector<glm::vec3> curvePoints;   // Pontos da curva
+    std::vector<glm::vec3> curvePoints;   // Pontos da curva: capacidadePorSegmento pontos reservados para cada segmento
     glm::mat4 M;                          // Matriz dos coeficientes da curva
+    std::vector<CoeficientesSegmento> coeficientes; // G * M de cada segmento, calculado uma vez
+    float toleranciaPlanicidade = 0.01f;  // maior distância (no mundo) entre a curva e a linha desenhada; 0 = numPoints fixos por segmento
+
+    // Cada segmento tem uma faixa fixa em curvePoints (e no VBO da linha), desenhada com glMultiDrawArrays:
+    // editar um ponto de controle reescreve só as faixas dos segmentos afetados
+    int capacidadePorSegmento = 0;
+    int profundidadeMaxima = 0;           // subdivisões da tesselação adaptativa que cabem na faixa
+    std::vector<GLint> inicioDosTrechos;
+    std::vector<GLsizei> pontosDosTrechos;
+
+    // Comprimento de arco: AMOSTRAS_ARCO + 1 distâncias por segmento (uniformes em t, contadas do início do segmento)
+    // e uma árvore de Fenwick com o comprimento de cada segmento, para editar um segmento sem refazer as somas
+    std::vector<float> distanciasArco;
+    std::vector<double> arvoreComprimentos; // Fenwick, índices 1..segmentos
+    float comprimento = 0.0f;
+
+    // Referenciais que minimizam a rotação (transporte paralelo) nas mesmas amostras de distanciasArco, como
+    // quatérnios: o eixo z do modelo vai na tangente e o y na normal transportada
+    std::vector<glm::quat> orientacoesArco;
+    bool referenciaisFechados = false; // a torção da curva fechada foi distribuída (só dá para refazer tudo)
+
+    // Caixa exata de cada segmento (extremos da cúbica em cada eixo) e a BVH sobre elas, para as consultas de proximidade
+    std::vector<CaixaEnvolvente> caixasSegmentos;
+    BVH bvh;
 };
 
+const int AMOSTRAS_ARCO = 8;
+
 void initializeCatmullRomMatrix(glm::mat4x4 &matrix);
 void generateCatmullRomCurvePoints(Curve &curve, int numPoints);
+int segmentosDaCurva(const Curve &curve);
+void calcularCoeficientesCurva(Curve &curve);
+void tesselarSegmento(const CoeficientesSegmento &coef, int numPoints, glm::vec3 *saida);
+void tesselarCurva(const Curve &curve, int numPoints, std::vector<glm::vec3> &saida);
+void tesselarCurvaAdaptativa(Curve &curve);
+void tesselarTrechoAdaptativo(Curve &curve, int segmento);
+void subdividirSegmento(const CoeficientesSegmento &coef, float t0, glm::vec3 p0, float t1, glm::vec3 p1, float tolerancia, int profundidade, int profundidadeMaxima, std::vector<glm::vec3> &saida);
+int executarBenchmarkCurva();
+glm::vec3 avaliarCurva(const Curve &curve, float u);
+glm::vec3 derivadaCurva(const Curve &curve, float u);
+glm::quat orientacaoNaCurva(const Curve &curve, float u);
+void construirTabelaComprimento(Curve &curve);
+void construirReferenciaisCurva(Curve &curve, int primeiroSegmento = 0);
+void medirSegmento(Curve &curve, int segmento);
+void atualizarComprimentoSegmento(Curve &curve, int segmento);
+float comprimentoEntre(const Curve &curve, float u0, float u1);
+float parametroPorDistancia(const Curve &curve, float distancia, int iteracoesNewton = 3);
 void displayCurve(const Curve &curve);
-GLuint generateControlPointsBuffer(vector<glm::vec3> controlPoints);
+
+// Resultado das consultas na curva: parâmetro, ponto e distância (até o ponto consultado, ou ao longo do raio)
+struct PontoNaCurva
+{
+    int curva = -1; // índice no IndiceDeCurvas (nas consultas de uma curva só fica 0)
+    float u = 0.0f;
+    glm::vec3 ponto = glm::vec3(0.0f);
+    float distancia = 1e30f;
+};
+
+// Várias curvas com uma BVH sobre as caixas delas; cada folha desce na BVH dos segmentos da curva
+struct IndiceDeCurvas
+{
+    std::vector<const Curve *> curvas;
+    std::vector<CaixaEnvolvente> caixas;
+    BVH bvh;
+};
+
+CaixaEnvolvente caixaDoSegmento(const CoeficientesSegmento &coef);
+void construirBVHCurva(Curve &curve);
+PontoNaCurva pontoMaisProximoNaCurva(const Curve &curve, glm::vec3 ponto, float distanciaMaxima = 1e30f);
+bool raioNaCurva(const Curve &curve, glm::vec3 origem, glm::vec3 direcao, float raioTubo, PontoNaCurva &resultado);
+void construirIndiceDeCurvas(IndiceDeCurvas &indice, const std::vector<const Curve *> &curvas);
+PontoNaCurva pontoMaisProximoNasCurvas(const IndiceDeCurvas &indice, glm::vec3 ponto);
+bool raioNasCurvas(const IndiceDeCurvas &indice, glm::vec3 origem, glm::vec3 direcao, float raioTubo, PontoNaCurva &resultado);
+int executarBenchmarkConsultasCurva();
+GLuint generateControlPointsBuffer(vector<glm::vec3> controlPoints, GLuint *VBOGerado = nullptr);
+
+// Pontos de controle na GPU desenhados como GL_PATCHES: o EBO repete os pontos vizinhos, 4 índices por segmento
+struct CurvaGPU
+{
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    int nIndices = 0;
+};
+
+int setupShaderCurva();
+CurvaGPU criarCurvaGPU(const Curve &curve);
+void destruirCurvaGPU(CurvaGPU &curva);
+
+// Buffers da OpenGL que precisam acompanhar as edições dos pontos de controle
+struct BuffersDaCurva
+{
+    GLuint VBOLinha = 0;     // curvePoints (desenho na CPU)
+    GLuint VBOControle = 0;  // pontos de controle (VAOControl)
+    CurvaGPU *gpu = nullptr; // pontos de controle da tesselação na GPU
+};
+
+void moverPontoDeControle(Curve &curve, BuffersDaCurva &buffers, int indice, glm::vec3 posicao);
+
+enum ModoLaco
+{
+    LACO_REPETIR = 0,   // volta para o início da curva
+    LACO_IDA_E_VOLTA = 1,
+    LACO_PARAR = 2      // fica parado no fim
+};
+
+// Seguidores de uma mesma curva e com a mesma malha, em SoA. A distância de cada um é função do tempo
+// (deslocamento + velocidade * tempo, dobrada conforme o modo), então não há estado acumulado entre frames
+struct GrupoDeSeguidores
+{
+    int curva = 0; // índice em SistemaDeSeguidores::curvas
+    std::vector<float> deslocamento;
+    std::vector<float> velocidade; // unidades do mundo por segundo (negativa anda para trás)
+    std::vector<int32_t> modo;
+    std::vector<float> distancia, sentido; // saída do kernel: distância na curva e +1/-1 conforme o sentido do movimento
+
+    // Malha instanciada (o buffer de instâncias recebe posição + orientação direto dos workers)
+    GLuint VBOMalha = 0, texID = 0;
+    int nVertices = 0;
+    float escala = 1.0f;
+    Material material;
+    GLuint VAO = 0, VBOInstancias = 0;
+};
+
+// Um elemento do buffer de instâncias (atributos 4 e 5 do vertex shader)
+struct InstanciaSeguidor
+{
+    glm::vec3 posicao;
+    glm::vec4 orientacao; // x, y, z, w do quatérnio
+};
+
+struct SistemaDeSeguidores
+{
+    std::vector<Curve *> curvas;
+    std::vector<GrupoDeSeguidores> grupos;
+    float msUltimaAtualizacao = 0.0f;
+};
+
+int criarGrupoDeSeguidores(SistemaDeSeguidores &sistema, int curva, const Object &modelo);
+void adicionarSeguidor(GrupoDeSeguidores &grupo, float deslocamento, float velocidade, ModoLaco modo);
+void calcularDistanciasSeguidores(GrupoDeSeguidores &grupo, float comprimento, float tempo);
+void atualizarSeguidores(GrupoDeSeguidores &grupo, const Curve &curve, float tempo, InstanciaSeguidor *instancias);
+void desenharSeguidores(SistemaDeSeguidores &sistema, GLuint shaderID, float tempo);
+void destruirSeguidores(SistemaDeSeguidores &sistema);
+int executarBenchmarkSeguidores();
 void loadSceneConfiguration(const std::string& configFilePath, std::vector<Object>& objs, glm::vec3& cameraPos, glm::vec3& cameraFront, glm::vec3& cameraUp, float& rotacaoYaw, float& rotaocaoPitch, glm::vec3& lightPos);
+void enviarTexturasRequisitadas(std::vector<Object> &objs);
+void atualizarTransformacoes(std::vector<Object> &objs, float angulo);
+int cullingPorFrustum(std::vector<Object> &objs, const glm::mat4 &viewProjection);
+int executarBenchmarkJobs();
+// Ferramentas comuns aos --bench-*
+int iniciarJobsDoBenchmark();
+unsigned avancarSemente(unsigned &semente);
+float aleatorioBenchmark(unsigned &semente);
+template <typename Funcao> double medirMilissegundos(Funcao funcao);
+
+// Árvore de caixas dinâmica sobre os objetos da cena. As folhas guardam caixas gordas (a caixa do objeto aumentada
+// pela margem): enquanto o objeto continua dentro dela, mover não mexe na árvore; quando sai, a folha é reinserida.
+// Os nós internos são rebalanceados com rotações, como numa árvore AVL
+struct NoArvoreDinamica
+{
+    CaixaEnvolvente caixa;
+    int pai = -1; // nos nós livres, o próximo da lista livre
+    int filho1 = -1, filho2 = -1;
+    int altura = -1; // 0 nas folhas, -1 nos nós livres
+    int objeto = -1;
+};
+
+struct ArvoreDinamica
+{
+    std::vector<NoArvoreDinamica> nos;
+    int raiz = -1;
+    int livre = -1;
+    float margem = 1.0f;  // unidades do mundo somadas à caixa de cada folha
+    int reinsercoes = 0;  // folhas que saíram da caixa gorda desde a última impressão (tecla T)
+};
+
+CaixaEnvolvente caixaDoObjeto(const Object &obj);
+void extrairPlanosFrustum(const glm::mat4 &viewProjection, glm::vec4 planos[6]);
+int inserirNaArvore(ArvoreDinamica &arvore, const CaixaEnvolvente &caixa, int objeto);
+void removerDaArvore(ArvoreDinamica &arvore, int folha);
+bool moverNaArvore(ArvoreDinamica &arvore, int folha, const CaixaEnvolvente &caixa);
+int alturaDaArvore(const ArvoreDinamica &arvore);
+template <typename Funcao> void consultarCaixaNaArvore(const ArvoreDinamica &arvore, const CaixaEnvolvente &caixa, Funcao funcao);
+template <typename Funcao> void consultarRaioNaArvore(const ArvoreDinamica &arvore, glm::vec3 origem, glm::vec3 direcao, float distanciaMaxima, Funcao funcao);
+template <typename Funcao> void consultarFrustumNaArvore(const ArvoreDinamica &arvore, const glm::vec4 planos[6], Funcao funcao);
+void atualizarArvoreCena(ArvoreDinamica &arvore, std::vector<Object> &objs);
+int cullingNaArvore(std::vector<Object> &objs, const ArvoreDinamica &arvore, const glm::mat4 &viewProjection);
+int executarBenchmarkCena();
+
+// Seleção por raio: árvore da cena até as caixas dos objetos, depois a BVH da malha no espaço do modelo
+struct ResultadoSelecao
+{
+    int objeto = -1;
+    int triangulo = -1;
+    float distancia = 1e30f;
+    int objetosTestados = 0; // objetos cuja malha foi percorrida
+    float microssegundos = 0.0f;
+};
+
+ResultadoSelecao selecionarPorRaio(const std::vector<Object> &objs, const ArvoreDinamica &arvore, glm::vec3 origem, glm::vec3 direcao);
+void raioDoCursor(double x, double y, int largura, int altura, const glm::mat4 &viewProjection, glm::vec3 &origem, glm::vec3 &direcao);
+int executarBenchmarkSelecao();
+
+// Colisões: sweep and prune incremental nos 3 eixos sobre as caixas das esferas envolventes (fase ampla) e teste das
+// esferas nos pares que sobram (fase estreita)
+struct ExtremoSAP
+{
+    float valor;
+    int corpo;
+    bool minimo; // início (true) ou fim da caixa do corpo neste eixo
+};
+
+struct ContatoColisao
+{
+    int a, b;          // índices em objs, a < b
+    glm::vec3 normal;  // de a para b
+    float penetracao;
+    bool comecou;      // true quando as esferas passam a se tocar, false quando se separam
+};
+
+struct SistemaDeColisao
+{
+    std::vector<ExtremoSAP> eixos[3]; // ordenados pelo valor; entre frames só mudam um pouco, então a ordenação por inserção é quase linear
+    std::vector<CaixaEnvolvente> caixas;
+    std::vector<glm::vec4> esferas;                 // centro e raio no mundo
+    std::unordered_map<uint64_t, bool> pares;       // pares da fase ampla -> se as esferas estão em contato
+    std::function<void(const ContatoColisao &)> aoContato;
+    size_t trocas = 0;                              // trocas da ordenação no último frame
+    float msUltimoFrame = 0.0f;
+};
+
+void atualizarColisoes(SistemaDeColisao &sistema, const std::vector<Object> &objs);
+int executarBenchmarkColisao();
+
+// Culling por oclusão em software: os maiores objetos na tela são rasterizados num buffer de profundidade pequeno, e
+// a caixa de cada objeto visível é testada contra a pirâmide Hi-Z desse buffer
+struct TrianguloOclusor
+{
+    float x[3], y[3], z[3]; // pixels e profundidade (0 = near, 1 = far), em sentido anti-horário
+    int xMinimo, xMaximo, yMinimo, yMaximo;
+};
+
+struct BufferOclusao
+{
+    static constexpr int LARGURA = 256, ALTURA = 128;
+    static constexpr int BLOCO = 64;  // lado dos blocos rasterizados em paralelo
+    static constexpr int NIVEIS = 8;  // 256x128 até 2x1
+    std::vector<float> maximo[NIVEIS]; // profundidade mais distante de cada texel (o nível 0 é o próprio buffer)
+    std::vector<float> minimo[NIVEIS]; // profundidade mais próxima (a partir do nível 1; no nível 0 é o mesmo buffer)
+    std::vector<TrianguloOclusor> triangulos;
+    std::vector<int> triangulosDoBloco[(LARGURA / BLOCO) * (ALTURA / BLOCO)];
+    std::vector<int> oclusores;        // objetos desenhados no último frame
+    int ocultos = 0;
+    float msUltimoFrame = 0.0f;
+};
+
+std::shared_ptr<const std::vector<glm::vec3>> construirOclusor(const std::vector<GLfloat> &vBuffer);
+int cullingPorOclusao(BufferOclusao &buffer, std::vector<Object> &objs, const glm::mat4 &viewProjection);
+int executarBenchmarkOclusao();
+
+// Consultas de oclusão na GPU: a caixa de cada objeto é desenhada numa consulta e o objeto é desenhado no frame
+// seguinte dentro de um glBeginConditionalRender, sem a CPU esperar o resultado
+#ifndef GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+#define GL_ANY_SAMPLES_PASSED_CONSERVATIVE 0x8F6A
+#endif
+struct ConsultasDeOclusao
+{
+    GLenum alvo = GL_ANY_SAMPLES_PASSED; // GL_ANY_SAMPLES_PASSED_CONSERVATIVE a partir da OpenGL 4.3
+    GLuint programa = 0;
+    GLint locMVP = -1;
+    GLuint VAOCubo = 0; // cubo de -1 a 1 com 36 vértices (o mesmo do skybox)
+    long frame = 0;
+    int emitidasUltimoFrame = 0;
+    int puladosUltimoFrame = 0;
+    int puladosFrameAtual = 0;
+    long emitidas = 0; // desde a última vez que a tecla T imprimiu
+    long pulados = 0;
+};
+
+void iniciarConsultasDeOclusao(ConsultasDeOclusao &consultas, GLuint VAOCubo);
+bool iniciarDesenhoCondicional(ConsultasDeOclusao &consultas, Object &obj);
+void emitirConsultasDeOclusao(ConsultasDeOclusao &consultas, std::vector<Object> &objs, const glm::mat4 &viewProjection, glm::vec3 posCamera);
+void encerrarConsultasDeOclusao(ConsultasDeOclusao &consultas, std::vector<Object> &objs);
+
+// Culling por oclusão usado depois do frustum: os dois resolvem o mesmo problema, então só um fica ligado
+enum ModoOclusao
+{
+    OCLUSAO_DESLIGADA,
+    OCLUSAO_SOFTWARE, // buffer de profundidade e pirâmide Hi-Z na CPU
+    OCLUSAO_CONSULTAS // consultas de oclusão e desenho condicional na GPU
+};
+
+// Resultado da leitura de um OBJ/MTL (feita no pool, sem tocar na OpenGL nem nas globais de material)
+struct MalhaOBJ
+{
+    std::string caminho;
+    bool valida = false;
+    std::vector<GLfloat> vBuffer; // x, y, z, r, g, b, s, t, nx, ny, nz por vértice
+    int nVertices = 0;
+    std::string nomeMaterial;
+    Material material = Material();
+    glm::vec3 centro = glm::vec3(0.0f);
+    float raio = 0.0f;
+    RequisicaoTextura textura; // preparação da textura do material, iniciada assim que o MTL é lido
+    float msCPU = 0.0f;
+    std::vector<GLfloat> vBufferProvisorio; // versão simplificada (só para malhas grandes, ver limiarMalhaProgressiva)
+    std::shared_ptr<const BVHMalha> bvh;    // triângulos para a seleção por raio
+    std::shared_ptr<const std::vector<glm::vec3>> oclusor; // triângulos desenhados no buffer de oclusão
+};
+
+// Buffers de uma malha já enviados; em malhas progressivas o VBO completo começa só alocado
+struct BuffersMalha
+{
+    GLuint VBO = 0;
+    GLuint VBOProvisorio = 0;
+    int nVerticesProvisorio = 0;
+};
+
+// Nível de uma textura em streaming enviado em fatias de linhas ao longo de vários frames,
+// ou (vbo != 0) os vértices de uma malha progressiva enviados em fatias de bytes
+struct TarefaUpload
+{
+    GLuint texID = 0;
+    int nivel = 0;
+    int linhasEnviadas = 0;
+    GLuint vbo = 0;
+    std::shared_future<MalhaOBJ> malha; // mantém os vértices na CPU até o fim do envio
+    size_t bytesEnviados = 0;
+    std::function<void()> aoConcluir; // chamada depois que a última fatia foi enviada
+};
+
+// Uploads com orçamento por frame: os pixels passam por um anel de PBOs (GL_PIXEL_UNPACK_BUFFER) com
+// um segmento por frame em voo, e cada segmento só é reescrito depois que a fence dele sinaliza
+struct AgendadorUploads
+{
+    static const int SEGMENTOS = 3;
+    GLuint pbo = 0;
+    size_t tamanhoSegmento = 0;
+    int segmentoAtual = 0;
+    GLsync fences[SEGMENTOS] = {};
+    std::deque<TarefaUpload> fila;
+    size_t orcamentoBytes = 1024 * 1024; // por frame
+    float orcamentoMicrossegundos = 2000.0f; // por frame (tempo de CPU gasto copiando e chamando a OpenGL)
+
+    // Estatísticas (tecla T)
+    float msUltimoFrame = 0.0f, msMaximo = 0.0f;
+    size_t bytesUltimoFrame = 0;
+    long framesEsperandoGPU = 0;
+};
+
+void iniciarAgendadorUploads(AgendadorUploads &agendador);
+void encerrarAgendadorUploads(AgendadorUploads &agendador);
+void agendarUploadNivel(AgendadorUploads &agendador, TexturaStreaming &ts, int nivel);
+void agendarUploadMalha(AgendadorUploads &agendador, GLuint vbo, std::shared_future<MalhaOBJ> malha, std::function<void()> aoConcluir);
+bool uploadPendente(const AgendadorUploads &agendador, GLuint vbo);
+void processarUploads(AgendadorUploads &agendador);
+
+MalhaOBJ lerArquivoOBJ(const std::string &filePATH, bool requisitarTexturaDoMaterial);
+GLuint enviarMalhaParaVBO(const MalhaOBJ &malha);
+std::vector<GLfloat> simplificarPorAgrupamento(const std::vector<GLfloat> &vBuffer, glm::vec3 minimo, glm::vec3 maximo, int resolucao);
+BuffersMalha enviarMalha(const MalhaOBJ &malha);
+void usarMalhaProgressiva(Object &obj, const BuffersMalha &buffers, int nVerticesProvisorio, std::shared_future<MalhaOBJ> malha, bool iniciarRefinamento);
+std::shared_future<MalhaOBJ> requisitarMalha(std::unordered_map<std::string, std::shared_future<MalhaOBJ>> &requisitadas, const std::string &filePATH);
+void carregarObjetosDeclarados(const std::vector<Object> &declarados, std::vector<Object> &objs);
+RequisicaoTextura criarRequisicaoTextura(const std::string &filePath);
+template <typename Funcao> auto agendarCarregamento(Funcao funcao) -> std::shared_future<decltype(funcao())>;
+template <typename T> bool futuroPronto(const std::shared_future<T> &futuro);
+
+// Fila circular sem locks para exatamente uma thread produtora e uma consumidora (capacidade = N - 1)
+template <typename T, size_t N>
+struct FilaSPSC
+{
+    T itens[N];
+    std::atomic<size_t> cabeca{0}; // próximo item a retirar (só a consumidora escreve)
+    std::atomic<size_t> cauda{0};  // próxima posição livre (só a produtora escreve)
+};
+
+template <typename T, size_t N> bool inserirNaFila(FilaSPSC<T, N> &fila, T &item);
+template <typename T, size_t N> bool retirarDaFila(FilaSPSC<T, N> &fila, T &item);
+
+// Objeto lido e enviado pela thread de carregamento; só pode ser usado depois que a fence sinalizar
+struct ObjetoCarregado
+{
+    Object objeto;
+    GLuint VBO = 0;
+    GLuint VBOProvisorio = 0;
+    std::shared_future<MalhaOBJ> malha; // vértices completos, para o refinamento (só no primeiro objeto com a malha)
+    int nVerticesProvisorio = 0;
+    bool iniciarRefinamento = false;    // primeiro objeto com esta malha: agenda o envio do VBO completo
+    bool temTexturaStreaming = false;
+    TexturaStreaming texturaStreaming; // registrada em texturasStreaming pela thread principal
+    std::shared_future<TexturaPreparada> texturaCompleta; // saiu com a textura provisória: a completa entra em trocasDeTexturas
+    GLsync fence = 0;
+};
+
+// Thread com um contexto OpenGL próprio (janela invisível compartilhando os objetos com a janela principal)
+struct CarregadorAssincrono
+{
+    GLFWwindow *contexto = nullptr;
+    std::thread thread;
+    FilaSPSC<Object, 64> pedidos;          // thread principal -> carregador
+    FilaSPSC<ObjetoCarregado, 64> prontos; // carregador -> thread principal
+    std::deque<ObjetoCarregado> aguardandoFence; // já retirados da fila, na ordem de chegada (só a thread principal usa)
+    std::atomic<bool> encerrar{false};
+    std::atomic<int> pendentes{0};
+    int adicionados = 0; // objetos já publicados na cena (só a thread principal usa)
+};
+
+void iniciarCarregadorAssincrono(CarregadorAssincrono &carregador, GLFWwindow *janelaPrincipal);
+void encerrarCarregadorAssincrono(CarregadorAssincrono &carregador);
+void threadDoCarregador(CarregadorAssincrono *carregador);
+void carregarObjetoAssincrono(CarregadorAssincrono &carregador, const Object &obj);
+void receberObjetosCarregados(CarregadorAssincrono &carregador, std::vector<Object> &objs);
+void atualizarStreamingTexturas(const std::vector<Object> &objs, glm::vec3 posCamera, float alturaTelaPixels);
+
+// Parte de um objeto que a simulação controla (VAO, texturas e o resto do Object ficam com a thread de render)
+struct TransformacaoObjeto
+{
+    glm::vec3 posicao = glm::vec3(0.0f);
+    glm::quat orientacao = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    float tamanhoEscala = 1.0f;
+    bool rotateX = false, rotateY = false, rotateZ = false;
+};
+
+// Retrato imutável do estado da simulação depois de um tick
+struct RetratoSimulacao
+{
+    uint64_t tick = 0;
+    double tempo = 0.0; // em segundos, no relógio da glfwGetTime
+    std::vector<TransformacaoObjeto> objetos; // mesma ordem de objs
+    glm::vec3 posCamera = glm::vec3(0.0f);
+    float yaw = 0.0f, pitch = 0.0f, fov = 45.0f;
+    double distanciaCurva = 0.0; // quanto o primeiro objeto já andou na curva, em unidades do mundo
+};
+
+// Troca tripla: o escritor sempre tem um buffer livre e o leitor sempre fica com o mais recente, sem locks.
+// meio guarda o índice do buffer do meio e o bit NOVO diz se o escritor publicou algo que o leitor ainda não pegou
+template <typename T>
+struct TrocaTripla
+{
+    static const int NOVO = 4;
+    T buffers[3];
+    std::atomic<int> meio{1};
+    int escrita = 0; // só o escritor usa
+    int leitura = 2; // só o leitor usa
+};
+
+template <typename T> void publicarTroca(TrocaTripla<T> &troca);
+template <typename T> bool pegarTroca(TrocaTripla<T> &troca);
+
+enum TipoEvento
+{
+    EVENTO_TECLA,
+    EVENTO_MOUSE,
+    EVENTO_SCROLL,
+    EVENTO_NOVO_OBJETO,
+    EVENTO_SELECIONAR
+};
+
+struct EventoEntrada
+{
+    TipoEvento tipo;
+    int tecla = 0, acao = 0;
+    double x = 0.0, y = 0.0;
+    TransformacaoObjeto objeto; // EVENTO_NOVO_OBJETO: estado inicial do objeto que entrou em objs
+    int indice = -1;            // EVENTO_SELECIONAR: objeto escolhido com o mouse
+};
+
+// Eventos dos callbacks da GLFW (thread principal) para a simulação
+struct FilaEntrada
+{
+    std::mutex mutex;
+    std::vector<EventoEntrada> eventos;
+};
+
+// Simulação em passo fixo: câmera, objetos e o objeto que segue a curva. Roda na própria thread e
+// publica um RetratoSimulacao por tick; a thread de render interpola entre os dois últimos retratos
+struct Simulacao
+{
+    std::thread thread;
+    std::atomic<bool> encerrar{false};
+    FilaEntrada entrada;
+    TrocaTripla<RetratoSimulacao> retratos;
+    double passo = 1.0 / 60.0;
+
+    // Estado (só a thread da simulação mexe)
+    uint64_t tick = 0;
+    double tempo = 0.0;
+    std::vector<TransformacaoObjeto> objetos;
+    bool teclas[GLFW_KEY_LAST + 1] = {};
+    glm::vec3 posCamera = glm::vec3(0.0f);
+    float yaw = 0.0f, pitch = 0.0f, fov = 45.0f;
+    int indiceObjetoSelecionado = 0;
+    double distanciaCurva = 0.0;
+    std::vector<EventoEntrada> eventosDoTick;
+
+    // Lado do render
+    RetratoSimulacao anterior, atual;
+    size_t objetosEnviados = 0;
+    int ticksRecebidos = 0;
+};
+
+void iniciarSimulacao(Simulacao &simulacao, const std::vector<Object> &objs, bool emThread);
+void encerrarSimulacao(Simulacao &simulacao);
+void threadDaSimulacao(Simulacao *simulacao);
+void avancarSimulacao(Simulacao &simulacao, double agora);
+void passoDaSimulacao(Simulacao &simulacao);
+void tratarTeclaNaSimulacao(Simulacao &simulacao, int key, int action);
+void enviarEventoEntrada(Simulacao &simulacao, const EventoEntrada &evento);
+void enviarObjetosNovosParaSimulacao(Simulacao &simulacao, const std::vector<Object> &objs);
+float aplicarRetratoSimulacao(Simulacao &simulacao, std::vector<Object> &objs, double agora);
 
 std::unordered_map<std::string, Material> materiais;
 std::string nomeMaterial;
@@ -244,33 +1144,137 @@ float rotacaoYaw = -90.0, rotaocaoPitch = 0.0; //rotação em x e y
 float deltaTime = 0.0f; // Tempo entre o frame atual e o anterior
 float lastFrame = 0.0f; // Tempo do último frame
 float fov = 45.0f;
-int indiceObjetoSelecionado = 0;
 vec3 lightPos = glm::vec3(0.0f);
 
-int indexCatmull = 0;
-float lastTime = 0.0;
-float FPS = 60.0;
-float angleObj = 0.0;
+float FPS = 60.0; // ticks por segundo da simulação
+// Curva tesselada na GPU a partir dos pontos de controle (false = linha com os curvePoints gerados na CPU)
+bool curvaNaGPU = true;
+float pixelsPorTrechoCurva = 6.0f; // tamanho na tela de cada trecho reto da curva tesselada na GPU
+float velocidadeCurva = 10.0f; // velocidade do primeiro objeto na curva, em unidades do mundo por segundo
+
+// Simulação numa thread separada do render (false = os ticks rodam no começo de cada frame, na thread principal)
+bool simulacaoEmThread = true;
+Simulacao simulacao;
 
 std::vector<Object> objs;
 Curve curvaCatmull;
+std::mutex mutexCurva; // a simulação lê a curva enquanto a thread principal edita os pontos de controle
+int pontoDeControleSelecionado = 0;
+SistemaDeSeguidores seguidores; // tecla F: seguidores instanciados nas curvas (a curva 0 é curvaCatmull)
+std::vector<std::pair<int, glm::vec3>> edicoesPendentesCurva; // (ponto, deslocamento) das teclas I, J, K, L; aplicadas no game loop
+
+// Texturas em BC1/BC3 com cache .dds ao lado da imagem original (false = caminho antigo, RGB/RGBA sem compressão)
+bool usarTexturasComprimidas = true;
+std::atomic<size_t> bytesTexturasGPU{0}; // Estimativa da memória de textura enviada à GPU (a thread de carregamento também envia)
+FiltroMipmap filtroMipmaps = FILTRO_KAISER;
+
+// Streaming de mips: as texturas começam só com os mips pequenos e sobem de nível conforme o tamanho na tela
+bool streamingTexturas = true;
+size_t orcamentoTexturas = 32u * 1024 * 1024; // bytes residentes permitidos para as texturas em streaming
+int tamanhoInicialStreaming = 64;             // mips até este tamanho são enviados no carregamento
+int niveisPorFrameStreaming = 2;              // quantos níveis no máximo são enviados por frame
+std::vector<TexturaStreaming> texturasStreaming;
+long frameAtual = 0;
+AgendadorUploads agendadorUploads; // os níveis pedidos pelo streaming são enviados por aqui, em fatias
+
+// Malhas progressivas: OBJs grandes aparecem primeiro simplificados (agrupamento de vértices numa grade) e o VBO
+// completo é enviado em lotes pelo agendador de uploads; quando termina, a malha completa substitui a simplificada
+bool malhasProgressivas = true;
+int limiarMalhaProgressiva = 20000; // triângulos
+int resolucaoMalhaProvisoria = 32;  // células da grade no maior eixo da malha
+
+// Decodifica as faces do skybox e as texturas dos objetos no sistema de jobs (false = uma a uma na thread principal)
+bool carregamentoParalelo = true;
+SistemaDeJobs sistemaDeJobs;
+thread_local SistemaDeJobs *sistemaDoWorker = nullptr; // sistema e índice da deque da thread atual, se ela for um worker
+thread_local int indiceWorkerAtual = -1;
+int objetosVisiveis = 0;
+// Culling pela árvore de caixas da cena (false = testa todos os objetos em paralelo)
+bool cullingComArvore = true;
+ArvoreDinamica arvoreCena;
+// Detecção de colisão entre os objetos da cena (contatos contados e mostrados com T)
+bool deteccaoDeColisao = true;
+SistemaDeColisao colisoes;
+size_t contatosIniciados = 0, contatosEncerrados = 0; // desde a última consulta com T
+// Culling por oclusão depois do culling por frustum
+ModoOclusao modoOclusao = OCLUSAO_SOFTWARE;
+// Oclusão em software
+int maximoOclusores = 8;            // objetos rasterizados por frame (os maiores na tela)
+float tamanhoMinimoOclusor = 0.1f;  // raio na tela, em fração da altura, para um objeto ser oclusor
+int limiteTriangulosOclusor = 50000; // malhas maiores não são rasterizadas no buffer de oclusão
+BufferOclusao bufferOclusao;
+// Consultas de oclusão na GPU (cada objeto pode desligar com consultaDeOclusao)
+int intervaloConsultasVisiveis = 8; // objetos visíveis só voltam a ser consultados depois de tantos frames
+ConsultasDeOclusao consultasOclusao;
+std::unordered_map<std::string, RequisicaoTextura> texturasRequisitadas;
+std::unordered_map<std::string, std::shared_future<MalhaOBJ>> malhasRequisitadas; // OBJs sendo lidos no pool (objetos com o mesmo arquivo compartilham a leitura)
+
+// Texturas provisórias: JPEGs são decodificados primeiro com 1/8 da resolução (só o DC de cada bloco) para a cena
+// aparecer logo; a versão completa é preparada no pool e trocada no lugar da provisória quando fica pronta
+bool texturasProvisorias = true;
+std::vector<TrocaDeTextura> trocasDeTexturas;
+std::chrono::high_resolution_clock::time_point momentoCriacaoJanela;
+
+// Carregamento assíncrono dos objetos da cena: uma thread com contexto compartilhado lê os OBJs e envia VBOs e texturas,
+// e cada objeto entra na cena assim que fica pronto (a janela já abre com o skybox e a curva)
+bool carregamentoAssincrono = true;
+CarregadorAssincrono carregador;
+
+// Tempo de cada fase da inicialização (impresso antes do game loop)
+std::vector<std::pair<std::string, float>> temposFases;
+std::chrono::high_resolution_clock::time_point inicioFase = std::chrono::high_resolution_clock::now();
 
 // Função MAIN
-int main()
+int main(int argc, char **argv)
 {
+    if (argc > 1 && std::string(argv[1]) == "--bench-jobs")
+    {
+        return executarBenchmarkJobs();
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-curva")
+    {
+        return executarBenchmarkCurva();
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-seguidores")
+    {
+        return executarBenchmarkSeguidores();
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-consultas-curva")
+    {
+        return executarBenchmarkConsultasCurva();
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-cena")
+    {
+        return executarBenchmarkCena();
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-selecao")
+    {
+        return executarBenchmarkSelecao();
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-colisao")
+    {
+        return executarBenchmarkColisao();
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-oclusao")
+    {
+        return executarBenchmarkOclusao();
+    }
+
 	// Inicialização da GLFW
 	glfwInit();
+    inicioFase = std::chrono::high_resolution_clock::now();
 
 	// Criação da janela GLFW
 	GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, "Prova GB - Rodrigo Korte Mentz", nullptr, nullptr);
+    momentoCriacaoJanela = std::chrono::high_resolution_clock::now();
 	glfwMakeContextCurrent(window);
 
 	// Fazendo o registro da função de callback para a janela GLFW
 	glfwSetKeyCallback(window, key_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetScrollCallback(window, scroll_callback);
-    updateCameraPos(window);
 
 	// GLAD: carrega todos os ponteiros d funções da OpenGL
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
@@ -289,6 +1293,19 @@ int main()
 	glfwGetFramebufferSize(window, &width, &height);
 	glViewport(0, 0, width, height);
 
+    // A thread principal também trabalha nos laços paralelos, então sobra um núcleo a menos para os workers
+    iniciarSistemaDeJobs(sistemaDeJobs, std::max(1, (int)std::thread::hardware_concurrency() - 1));
+    if (usarTexturasComprimidas)
+    {
+        suportaCompressaoS3TC(); // consulta as extensões aqui, antes das threads de carregamento precisarem da resposta
+    }
+    if (carregamentoAssincrono)
+    {
+        iniciarCarregadorAssincrono(carregador, window); // cria o contexto compartilhado aqui: a GLFW só cria janelas na thread principal
+    }
+    iniciarAgendadorUploads(agendadorUploads);
+    marcarFaseInicializacao("janela + GLAD");
+
 	// Compilando e buildando o programa de shader
 	GLuint shaderID = setupShader();
 
@@ -302,6 +1319,7 @@ int main()
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    if (modoOclusao == OCLUSAO_CONSULTAS) iniciarConsultasDeOclusao(consultasOclusao, skyboxVAO);
     vector<std::string> faces
     {
         "../assets/skybox/posx.jpg",
@@ -311,17 +1329,36 @@ int main()
         "../assets/skybox/posz.jpg",
         "../assets/skybox/negz.jpg"
     };
+    marcarFaseInicializacao("shaders + VAO do skybox");
     GLuint cubemapTexture = loadCubemap(faces);
+    marcarFaseInicializacao("skybox (decodificacao + upload)");
 
     std::vector<glm::vec3> controlPoints = loadPontosDaCurvaDoArquivo("../assets/pontosDaCurva.txt");
     curvaCatmull.controlPoints = controlPoints;
     
-    int numCurvePoints = 100; // Quantidade de pontos por segmento na curva
+    int numCurvePoints = 100; // Quantidade de pontos por segmento na curva (só quando toleranciaPlanicidade = 0)
     generateCatmullRomCurvePoints(curvaCatmull, numCurvePoints);
-    GLuint VAOControl = generateControlPointsBuffer(curvaCatmull.controlPoints);
-    GLuint VAOCatmullCurve = generateControlPointsBuffer(curvaCatmull.curvePoints);
+    cout << "Curva: " << std::accumulate(curvaCatmull.pontosDosTrechos.begin(), curvaCatmull.pontosDosTrechos.end(), 0) << " pontos com tolerancia "
+         << curvaCatmull.toleranciaPlanicidade << " (" << segmentosDaCurva(curvaCatmull) * (numCurvePoints + 1) << " com " << numCurvePoints << " por segmento)" << endl;
+    seguidores.curvas.push_back(&curvaCatmull);
+    BuffersDaCurva buffersCurva;
+    GLuint VAOControl = generateControlPointsBuffer(curvaCatmull.controlPoints, &buffersCurva.VBOControle);
+    GLuint VAOCatmullCurve = generateControlPointsBuffer(curvaCatmull.curvePoints, &buffersCurva.VBOLinha);
+    GLuint shaderCurvaID = 0;
+    CurvaGPU curvaGPU;
+    if (curvaNaGPU && GLAD_GL_VERSION_4_0)
+    {
+        shaderCurvaID = setupShaderCurva();
+        curvaGPU = criarCurvaGPU(curvaCatmull);
+    }
+    if (!shaderCurvaID) curvaNaGPU = false;
+    if (curvaNaGPU) buffersCurva.gpu = &curvaGPU;
+    marcarFaseInicializacao("curva");
 
     loadSceneConfiguration("../assets/configuracoesCena.txt", objs, cameraPos, cameraFront, cameraUp, rotacaoYaw, rotaocaoPitch, lightPos);
+    imprimirFasesInicializacao();
+    iniciarSimulacao(simulacao, objs, simulacaoEmThread);
+    colisoes.aoContato = [](const ContatoColisao &contato) { (contato.comecou ? contatosIniciados : contatosEncerrados)++; };
 
     float q = 10.0;
     lightPos = vec3(0.6, 1.2, -0.5);
@@ -363,6 +1400,7 @@ int main()
 	//Ativando o primeiro buffer de textura da OpenGL
 	glActiveTexture(GL_TEXTURE0);
 	glEnable(GL_DEPTH_TEST);
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS); // filtra entre as faces do skybox nos mips menores
 
 
 	// Loop da aplicação - "game loop"
@@ -373,8 +1411,18 @@ int main()
         lastFrame = currentFrame;
         
 		glfwPollEvents();
-        updateCameraPos(window);
-        // CAMERA
+        for (const std::pair<int, glm::vec3> &edicao : edicoesPendentesCurva)
+        {
+            moverPontoDeControle(curvaCatmull, buffersCurva, edicao.first, curvaCatmull.controlPoints[edicao.first] + edicao.second);
+        }
+        edicoesPendentesCurva.clear();
+        // ----------------------------------------------------
+        // SIMULAÇÃO: objetos novos entram na simulação e o frame usa o estado interpolado entre os dois últimos ticks
+        if (carregamentoAssincrono) receberObjetosCarregados(carregador, objs);
+        enviarObjetosNovosParaSimulacao(simulacao, objs);
+        if (!simulacaoEmThread) avancarSimulacao(simulacao, glfwGetTime());
+        float tempoSimulacao = aplicarRetratoSimulacao(simulacao, objs, glfwGetTime());
+        // CAMERA
         glm::vec3 front;
         front.x = cos(glm::radians(rotaocaoPitch)) * cos(glm::radians(rotacaoYaw));
         front.y = sin(glm::radians(rotaocaoPitch));
@@ -422,9 +1470,25 @@ int main()
         glUniformMatrix4fv(glGetUniformLocation(shaderID, "model"), 1, GL_FALSE, glm::value_ptr(identityModel));
 
         glUniform1i(glGetUniformLocation(shaderID, "isCurveOrControlPoint"), 1);
-        glBindVertexArray(VAOCatmullCurve);
-        glUniform3f(glGetUniformLocation(shaderID, "fixedColor"), 1.0f, 1.0f, 1.0f);
-        glDrawArrays(GL_LINE_STRIP, 0, curvaCatmull.curvePoints.size());
+        if (curvaNaGPU)
+        {
+            glUseProgram(shaderCurvaID);
+            glUniformMatrix4fv(glGetUniformLocation(shaderCurvaID, "view"), 1, GL_FALSE, glm::value_ptr(view));
+            glUniformMatrix4fv(glGetUniformLocation(shaderCurvaID, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+            glUniform2f(glGetUniformLocation(shaderCurvaID, "tamanhoTela"), (float)width, (float)height);
+            glUniform1f(glGetUniformLocation(shaderCurvaID, "pixelsPorTrecho"), pixelsPorTrechoCurva);
+            glUniform3f(glGetUniformLocation(shaderCurvaID, "fixedColor"), 1.0f, 1.0f, 1.0f);
+            glBindVertexArray(curvaGPU.VAO);
+            glPatchParameteri(GL_PATCH_VERTICES, 4);
+            glDrawElements(GL_PATCHES, curvaGPU.nIndices, GL_UNSIGNED_INT, 0);
+            glUseProgram(shaderID);
+        }
+        else
+        {
+            glBindVertexArray(VAOCatmullCurve);
+            glUniform3f(glGetUniformLocation(shaderID, "fixedColor"), 1.0f, 1.0f, 1.0f);
+            glMultiDrawArrays(GL_LINE_STRIP, curvaCatmull.inicioDosTrechos.data(), curvaCatmull.pontosDosTrechos.data(), (GLsizei)curvaCatmull.pontosDosTrechos.size());
+        }
 
         // Descomentar para ver o desenho dos pontos na cena
         // glBindVertexArray(VAOControl);
@@ -435,26 +1499,18 @@ int main()
 
         glUniform1i(glGetUniformLocation(shaderID, "isCurveOrControlPoint"), 0);
         // ----------------------------------------------------
-        // MOVER O OBJETO NA CURVA
-
-        // Calcula a posição do objeto na curva de Catmull
-        float now = glfwGetTime();
-        float dt = now - lastTime;
-        if (dt >= 1 / FPS)
-        {
-            indexCatmull = (indexCatmull + 1) % curvaCatmull.curvePoints.size(); // incrementando ciclicamente o indice do Frame
-            lastTime = now;
-            glm::vec3 nextPos = curvaCatmull.curvePoints[indexCatmull];
-            glm::vec3 currentPos = glm::vec3(objs[0].posX, objs[0].posY, objs[0].posZ);
-            glm::vec3 dir = glm::normalize(nextPos - currentPos);
-
-            objs[0].posX = nextPos.x;
-            objs[0].posY = nextPos.y;
-            objs[0].posZ = nextPos.z;
-
-            angleObj = atan2(dir.x, dir.y) + glm::radians(-90.0f);
-            objs[0].AnguloRotacao = angleObj;
-        }
+        // TRANSFORMAÇÕES E CULLING (em paralelo no sistema de jobs)
+        atualizarTransformacoes(objs, tempoSimulacao);
+        atualizarArvoreCena(arvoreCena, objs);
+        objetosVisiveis = cullingComArvore ? cullingNaArvore(objs, arvoreCena, projection * view) : cullingPorFrustum(objs, projection * view);
+        if (modoOclusao == OCLUSAO_SOFTWARE) objetosVisiveis -= cullingPorOclusao(bufferOclusao, objs, projection * view);
+        if (deteccaoDeColisao) atualizarColisoes(colisoes, objs);
+        // ----------------------------------------------------
+        // TROCA DAS TEXTURAS PROVISÓRIAS PELAS COMPLETAS
+        processarTrocasDeTexturas();
+        // STREAMING DAS TEXTURAS
+        atualizarStreamingTexturas(objs, cameraPos, (float)height);
+        processarUploads(agendadorUploads);
         // ----------------------------------------------------
         // DESENHO DOS OBJS
         glUseProgram(shaderID); // Ativa o shader dos seus objetos
@@ -465,28 +1521,8 @@ int main()
         glUniform1f(glGetUniformLocation(shaderID, "q"), q);
         glUniform3f(glGetUniformLocation(shaderID, "lightPos"), lightPos.x,lightPos.y,lightPos.z);
 
-        float angle = (GLfloat)glfwGetTime();
-        float defaultrotator = glm::radians(90.0f);
 		for (Object& obj : objs) {
-			obj.model = glm::mat4(1.0f);
-            obj.model = glm::translate(obj.model, glm::vec3(obj.posX, obj.posY, obj.posZ));
-            obj.model = glm::rotate(obj.model, defaultrotator, glm::vec3(0.0f, 1.0f, 0.0f));
-            obj.model = glm::rotate(obj.model, obj.AnguloRotacao, glm::vec3(1.0f, 0.0f, 0.0f));
-
-			if (obj.rotateX)
-			{
-				obj.model = glm::rotate(obj.model, angle, glm::vec3(1.0f, 0.0f, 0.0f));
-			}
-			else if (obj.rotateY)
-			{
-				obj.model = glm::rotate(obj.model, angle, glm::vec3(0.0f, 1.0f, 0.0f));
-			}
-			else if (obj.rotateZ)
-			{
-				obj.model = glm::rotate(obj.model, angle, glm::vec3(0.0f, 0.0f, 1.0f));
-			}
-            
-			obj.model = glm::scale(obj.model, glm::vec3(obj.tamanhoEscala));
+			if (!obj.visivel) continue;
 
 			glUniformMatrix4fv(glGetUniformLocation(shaderID, "model"), 1, GL_FALSE, value_ptr(obj.model));
 
@@ -494,23 +1530,52 @@ int main()
             glUniform1f(glGetUniformLocation(shaderID, "kd"), obj.material.kd.r);
             glUniform1f(glGetUniformLocation(shaderID, "ks"), obj.material.ks.r);
 
-			glBindVertexArray(obj.VAO); // Conectando ao buffer de geometria
+			bool condicional = iniciarDesenhoCondicional(consultasOclusao, obj); // só desenha se a caixa passou na consulta anterior
+			glBindVertexArray(obj.VAOProvisorio ? obj.VAOProvisorio : obj.VAO); // Conectando ao buffer de geometria
 			glBindTexture(GL_TEXTURE_2D, obj.texID); //conectando com o buffer de textura que será usado no draw
-			glDrawArrays(GL_TRIANGLES, 0, obj.nVertices);
+			glDrawArrays(GL_TRIANGLES, 0, obj.VAOProvisorio ? obj.nVerticesProvisorio : obj.nVertices);
+			if (condicional) glEndConditionalRender();
 		}
+        desenharSeguidores(seguidores, shaderID, tempoSimulacao);
+        if (modoOclusao == OCLUSAO_CONSULTAS) emitirConsultasDeOclusao(consultasOclusao, objs, projection * view, cameraPos);
 
 		glBindVertexArray(0); // Desconectando o buffer de geometria
 
 		// Troca os buffers da tela
 		glfwSwapBuffers(window);
+
+        static bool primeiroFrame = true;
+        if (primeiroFrame)
+        {
+            primeiroFrame = false;
+            cout << "Primeiro frame completo " << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - momentoCriacaoJanela).count()
+                 << " ms depois do glfwCreateWindow (" << trocasDeTexturas.size() << " texturas ainda provisorias)" << endl;
+        }
 	}
-	// Pede pra OpenGL desalocar os buffers
+	// Pede pra OpenGL desalocar os buffers (objetos com o mesmo OBJ compartilham os VBOs)
+	std::vector<GLuint> VBOsObjetos;
 	for (Object& obj : objs) {
 		glDeleteVertexArrays(1, &obj.VAO);
+		glDeleteVertexArrays(1, &obj.VAOProvisorio);
+		if (obj.VBO) VBOsObjetos.push_back(obj.VBO);
+		if (obj.VBOProvisorio) VBOsObjetos.push_back(obj.VBOProvisorio);
 	}
+	std::sort(VBOsObjetos.begin(), VBOsObjetos.end());
+	VBOsObjetos.erase(std::unique(VBOsObjetos.begin(), VBOsObjetos.end()), VBOsObjetos.end());
+	glDeleteBuffers((GLsizei)VBOsObjetos.size(), VBOsObjetos.data());
 
     glDeleteVertexArrays(1, &VAOControl);
     glDeleteVertexArrays(1, &VAOCatmullCurve);
+    glDeleteBuffers(1, &buffersCurva.VBOControle);
+    glDeleteBuffers(1, &buffersCurva.VBOLinha);
+    destruirCurvaGPU(curvaGPU);
+    destruirSeguidores(seguidores);
+    if (shaderCurvaID) glDeleteProgram(shaderCurvaID);
+    encerrarConsultasDeOclusao(consultasOclusao, objs);
+    encerrarSimulacao(simulacao);
+    if (carregamentoAssincrono) encerrarCarregadorAssincrono(carregador);
+    encerrarAgendadorUploads(agendadorUploads);
+    encerrarSistemaDeJobs(sistemaDeJobs);
 	// Finaliza a execução da GLFW, limpando os recursos alocados por ela
 	glfwTerminate();
 	return 0;
@@ -536,99 +1601,110 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
             cout << "rotaocaoPitch: " << rotaocaoPitch << endl;
         }
 
-        if (key == GLFW_KEY_1 && action == GLFW_PRESS)
-    {
-        indiceObjetoSelecionado = 0;
-        cout << "Objeto 1 selecionado" << endl;
-    }
-    if (key == GLFW_KEY_2 && action == GLFW_PRESS)
-    {
-        if (objs.size() > 1) {
-            indiceObjetoSelecionado = 1;
-            cout << "Objeto 2 selecionado" << endl;
-        } else {
-            cout << "Objeto 2 não existe" << endl;
-        }
-    }
-    if (key == GLFW_KEY_3 && action == GLFW_PRESS)
-    {
-        if (objs.size() > 2) {
-            indiceObjetoSelecionado = 2;
-            cout << "Objeto 3 selecionado" << endl;
-        } else {
-            cout << "Objeto 3 não existe" << endl;
+        if (key == GLFW_KEY_T && action == GLFW_PRESS)
+        {
+            cout << "Texturas em streaming: " << texturasStreaming.size() << endl;
+            cout << "Bytes residentes: " << bytesResidentesTexturas() / 1024 << " KB de " << orcamentoTexturas / 1024 << " KB" << endl;
+            cout << "Requisicoes pendentes: " << requisicoesPendentesTexturas() << endl;
+            cout << "Uploads na fila: " << agendadorUploads.fila.size() << ", ultimo frame " << agendadorUploads.bytesUltimoFrame / 1024 << " KB em "
+                 << agendadorUploads.msUltimoFrame << " ms (maximo " << agendadorUploads.msMaximo << " ms, orcamento " << agendadorUploads.orcamentoBytes / 1024 << " KB / "
+                 << agendadorUploads.orcamentoMicrossegundos / 1000.0f << " ms), frames esperando a GPU: " << agendadorUploads.framesEsperandoGPU << endl;
+            agendadorUploads.msMaximo = 0.0f;
+            size_t totalSeguidores = 0;
+            for (const GrupoDeSeguidores &grupo : seguidores.grupos) totalSeguidores += grupo.deslocamento.size();
+            cout << "Seguidores de curva: " << totalSeguidores << " em " << seguidores.grupos.size() << " grupo(s), " << seguidores.msUltimaAtualizacao << " ms no ultimo frame" << endl;
+            cout << "Objetos visiveis: " << objetosVisiveis << " de " << objs.size() << ", workers: " << sistemaDeJobs.workers.size()
+                 << ", roubos de jobs: " << sistemaDeJobs.roubos << endl;
+            cout << "Arvore da cena: " << arvoreCena.nos.size() << " nos, altura " << alturaDaArvore(arvoreCena) << ", " << arvoreCena.reinsercoes << " reinsercoes desde a ultima consulta" << endl;
+            arvoreCena.reinsercoes = 0;
+            cout << "Oclusao: " << bufferOclusao.oclusores.size() << " oclusores, " << bufferOclusao.triangulos.size() << " triangulos, " << bufferOclusao.ocultos
+                 << " objetos ocultos, " << bufferOclusao.msUltimoFrame << " ms" << endl;
+            cout << "Consultas de oclusao: " << consultasOclusao.emitidasUltimoFrame << " emitidas e " << consultasOclusao.puladosUltimoFrame
+                 << " desenhos pulados no ultimo frame (" << consultasOclusao.emitidas << " e " << consultasOclusao.pulados << " desde a ultima consulta)" << endl;
+            consultasOclusao.emitidas = 0;
+            consultasOclusao.pulados = 0;
+            cout << "Carregador: " << carregador.adicionados << " objetos adicionados, " << carregador.pendentes << " ainda carregando" << endl;
+            cout << "Colisoes: " << colisoes.pares.size() << " pares na fase ampla, " << colisoes.trocas << " trocas no ultimo frame, " << colisoes.msUltimoFrame << " ms, "
+                 << contatosIniciados << " contatos iniciados e " << contatosEncerrados << " encerrados desde a ultima consulta" << endl;
+            contatosIniciados = 0;
+            contatosEncerrados = 0;
+            PontoNaCurva mira;
+            if (raioNaCurva(curvaCatmull, cameraPos, cameraFront, 0.5f, mira))
+            {
+                cout << "Centro da tela sobre a curva: u = " << mira.u << ", a " << mira.distancia << " unidades" << endl;
+            }
+            for (const TexturaStreaming &ts : texturasStreaming)
+            {
+                cout << "  textura " << ts.texID << ": nivel " << ts.nivelResidente << " (desejado " << ts.nivelDesejado << ", minimo " << ts.nivelMinimo << ")" << endl;
+            }
         }
-    }
-
-    if (key == GLFW_KEY_X && action == GLFW_PRESS)
-    {
-        objs[indiceObjetoSelecionado].rotateX = true;
-        objs[indiceObjetoSelecionado].rotateY = false;
-        objs[indiceObjetoSelecionado].rotateZ = false;
-    }
-
-    if (key == GLFW_KEY_Y && action == GLFW_PRESS)
-    {
-        objs[indiceObjetoSelecionado].rotateX = false;
-        objs[indiceObjetoSelecionado].rotateY = true;
-        objs[indiceObjetoSelecionado].rotateZ = false;
-    }
-
-    if (key == GLFW_KEY_Z && action == GLFW_PRESS)
-    {
-        objs[indiceObjetoSelecionado].rotateX = false;
-        objs[indiceObjetoSelecionado].rotateY = false;
-        objs[indiceObjetoSelecionado].rotateZ = true;
-    }
-
-    if (key == GLFW_KEY_UP && action == GLFW_PRESS)
-    {
-        objs[indiceObjetoSelecionado].posY += 0.1f;
-    }
 
-    if (key == GLFW_KEY_DOWN && action == GLFW_PRESS)
-    {
-        objs[indiceObjetoSelecionado].posY -= 0.1f;
-    }
-
-    if (key == GLFW_KEY_LEFT && action == GLFW_PRESS)
-    {
-        objs[indiceObjetoSelecionado].posX -= 0.1f;
-    }
-
-    if (key == GLFW_KEY_RIGHT && action == GLFW_PRESS)
-    {
-        objs[indiceObjetoSelecionado].posX += 0.1f;
-    }
+        if (key == GLFW_KEY_M && action == GLFW_PRESS && carregamentoAssincrono)
+        {
+            // Adiciona uma lua na frente da câmera; o frame não espera a leitura do OBJ nem da textura
+            Object lua;
+            lua.NomeObj = "Moon.obj";
+            lua.posX = cameraPos.x + cameraFront.x * 10.0f;
+            lua.posY = cameraPos.y + cameraFront.y * 10.0f;
+            lua.posZ = cameraPos.z + cameraFront.z * 10.0f;
+            lua.tamanhoEscala = 0.04f;
+            lua.rotateY = true;
+            carregarObjetoAssincrono(carregador, lua);
+        }
 
-    if (key == GLFW_KEY_KP_ADD && action == GLFW_PRESS) // Tecla + do teclado numérico
-    {
-        objs[indiceObjetoSelecionado].posZ += 0.1f;
-    }
-    
-    if (key == GLFW_KEY_KP_SUBTRACT && action == GLFW_PRESS) // Tecla - do teclado numérico
-    {
-        objs[indiceObjetoSelecionado].posZ -= 0.1f;
-    }
+        if (key == GLFW_KEY_F && action == GLFW_PRESS && !objs.empty())
+        {
+            // Mais 10 mil cópias do primeiro objeto na curva, com velocidades e modos variados
+            if (uploadPendente(agendadorUploads, objs[0].VBO))
+            {
+                cout << "A malha do primeiro objeto ainda esta sendo enviada" << endl;
+            }
+            else
+            {
+                if (seguidores.grupos.empty()) criarGrupoDeSeguidores(seguidores, 0, objs[0]);
+                GrupoDeSeguidores &grupo = seguidores.grupos[0];
+                for (int i = 0; i < 10000; i++)
+                {
+                    size_t n = grupo.deslocamento.size();
+                    adicionarSeguidor(grupo, (float)((n * 7919) % 100000) * 0.01f, 4.0f + (float)(n % 13), (ModoLaco)(n % 3));
+                }
+                cout << grupo.deslocamento.size() << " seguidores na curva" << endl;
+            }
+        }
 
-    if (key == GLFW_KEY_U && action == GLFW_PRESS)
-    {
-        objs[indiceObjetoSelecionado].tamanhoEscala += 0.1f;
-    }
+        // Edição da curva: P escolhe o ponto de controle, I/K e J/L movem em y e em x
+        if (key == GLFW_KEY_P && action == GLFW_PRESS && !curvaCatmull.controlPoints.empty())
+        {
+            pontoDeControleSelecionado = (pontoDeControleSelecionado + 1) % curvaCatmull.controlPoints.size();
+            glm::vec3 ponto = curvaCatmull.controlPoints[pontoDeControleSelecionado];
+            cout << "Ponto de controle " << pontoDeControleSelecionado << " selecionado (" << ponto.x << ", " << ponto.y << ", " << ponto.z << ")" << endl;
+        }
+        if ((key == GLFW_KEY_I || key == GLFW_KEY_K || key == GLFW_KEY_J || key == GLFW_KEY_L) && action != GLFW_RELEASE && !curvaCatmull.controlPoints.empty())
+        {
+            glm::vec3 deslocamento(key == GLFW_KEY_L ? 0.5f : key == GLFW_KEY_J ? -0.5f : 0.0f, key == GLFW_KEY_I ? 0.5f : key == GLFW_KEY_K ? -0.5f : 0.0f, 0.0f);
+            edicoesPendentesCurva.push_back({pontoDeControleSelecionado, deslocamento});
+        }
 
-    if (key == GLFW_KEY_H && action == GLFW_PRESS)
-    {
-        if (objs[indiceObjetoSelecionado].tamanhoEscala < 0.1f)
+        if (key == GLFW_KEY_V && action == GLFW_PRESS)
         {
-            objs[indiceObjetoSelecionado].tamanhoEscala = 0.1f;
-        } else {
-            objs[indiceObjetoSelecionado].tamanhoEscala -= 0.1f;
+            // Alterna entre olhar com o mouse e o cursor livre para clicar nos objetos
+            bool preso = glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_DISABLED;
+            glfwSetInputMode(window, GLFW_CURSOR, preso ? GLFW_CURSOR_NORMAL : GLFW_CURSOR_DISABLED);
+            firstMouse = true;
         }
-    }
+
+        // O resto (seleção, operações nos objetos e W/A/S/D) é tratado pela simulação
+        EventoEntrada evento;
+        evento.tipo = EVENTO_TECLA;
+        evento.tecla = key;
+        evento.acao = action;
+        enviarEventoEntrada(simulacao, evento);
 }
 
 void mouse_callback(GLFWwindow *window, double xpos, double ypos)
 {
+    if (glfwGetInputMode(window, GLFW_CURSOR) != GLFW_CURSOR_DISABLED) return; // cursor livre (tecla V): a câmera não gira
+
     if (firstMouse)
     {
         lastX = xpos;
@@ -645,55 +1721,47 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos)
     xoffset *= sensitivity;
     yoffset *= sensitivity;
 
-    rotacaoYaw += xoffset;
-    rotaocaoPitch += yoffset;
-
-    if (rotaocaoPitch > 89.0f)
-    {
-        rotaocaoPitch = 89.0f;
-    }
-
-    if (rotaocaoPitch < -89.0f)
-    {
-        rotaocaoPitch = -89.0f;
-    }
+    EventoEntrada evento;
+    evento.tipo = EVENTO_MOUSE;
+    evento.x = xoffset;
+    evento.y = yoffset;
+    enviarEventoEntrada(simulacao, evento);
 }
 
-void updateCameraPos(GLFWwindow *window)
+// Clique esquerdo seleciona o objeto sob o cursor (ou no centro da tela, com o cursor preso para olhar com o mouse)
+void mouse_button_callback(GLFWwindow *window, int button, int action, int /*mods*/)
 {
-    float cameraSpeed = 0.05f;
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-    {
-        cameraPos += cameraSpeed * cameraFront;
-    }
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-    {
-        cameraPos -= cameraSpeed * cameraFront;
-    }
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-    {
-        cameraPos -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
-    }
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS) return;
+    int largura = WIDTH, altura = HEIGHT;
+    glfwGetWindowSize(window, &largura, &altura);
+    double x = largura / 2.0, y = altura / 2.0;
+    if (glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_NORMAL) glfwGetCursorPos(window, &x, &y);
+
+    // Mesmas matrizes do frame (ver o game loop)
+    glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+    glm::mat4 projection = glm::perspective(fov, (GLfloat)WIDTH / (GLfloat)HEIGHT, 0.1f, 100.0f);
+    glm::vec3 origem, direcao;
+    raioDoCursor(x, y, largura, altura, projection * view, origem, direcao);
+    ResultadoSelecao selecao = selecionarPorRaio(objs, arvoreCena, origem, direcao);
+    if (selecao.objeto < 0)
     {
-        cameraPos += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+        cout << "Nenhum objeto sob o cursor (" << selecao.microssegundos << " us)" << endl;
+        return;
     }
+    cout << "Objeto " << selecao.objeto + 1 << " (" << objs[selecao.objeto].NomeObj << ") selecionado: triangulo " << selecao.triangulo << " a "
+         << selecao.distancia << " unidades, " << selecao.objetosTestados << " malha(s) percorrida(s) em " << selecao.microssegundos << " us" << endl;
+    EventoEntrada evento;
+    evento.tipo = EVENTO_SELECIONAR;
+    evento.indice = selecao.objeto;
+    enviarEventoEntrada(simulacao, evento);
 }
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
-    if(fov >= 1.0f && fov <= 45.0f)
-    {
-        fov -= yoffset * 0.1f;
-    }
-    if(fov <= 1.0f)
-    {
-        fov = 1.0f;
-    }
-    if(fov >= 45.0f)
-    {
-        fov = 45.0f;
-    }
+    EventoEntrada evento;
+    evento.tipo = EVENTO_SCROLL;
+    evento.y = yoffset;
+    enviarEventoEntrada(simulacao, evento);
 }
 
 int setupShader()
@@ -763,431 +1831,5849 @@ int setupSkyboxShader() {
     return shaderProgram;
 }
 
-GLuint loadTexture(string filePath, int &width, int &height)
-{
-	GLuint texID; // id da textura a ser carregada
+int setupShaderCaixa() {
+    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &caixaVertexShaderSource, NULL);
+    glCompileShader(vertexShader);
+
+    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, &caixaFragmentShaderSource, NULL);
+    glCompileShader(fragmentShader);
+
+    GLuint shaderProgram = glCreateProgram();
+    glAttachShader(shaderProgram, vertexShader);
+    glAttachShader(shaderProgram, fragmentShader);
+    glLinkProgram(shaderProgram);
 
-	// Gera o identificador da textura na memória
-	glGenTextures(1, &texID);
-	glBindTexture(GL_TEXTURE_2D, texID);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
 
-	// Ajuste dos parâmetros de wrapping e filtering
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    return shaderProgram;
+}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+GLuint loadTexture(string filePath, int &width, int &height)
+{
+	return enviarTextura(prepararTextura(filePath, usarTexturasComprimidas && suportaCompressaoS3TC(), true), width, height);
+}
 
-	// Carregamento da imagem usando a função stbi_load da biblioteca stb_image
-	int nrChannels;
+// Parte de CPU do carregamento: cache .dds, decodificação, mipmaps e compressão. Não usa a OpenGL, pode rodar no pool
+TexturaPreparada prepararTextura(const std::string &filePath, bool comprimir, bool repetirBordas)
+{
+	auto inicio = std::chrono::high_resolution_clock::now();
+	TexturaPreparada preparada;
+	preparada.caminho = filePath;
 
-	unsigned char *data = stbi_load(filePath.c_str(), &width, &height, &nrChannels, 0);
+	// Um cache por formato: BC1/BC3 em .dds, RGBA8 sem compressão em .rgba.dds (ambos com todos os mips)
+	std::string caminhoCache = filePath + (comprimir ? ".dds" : ".rgba.dds");
+	preparada.usouCache = cacheDeTexturaValido(filePath, comprimir) && carregarCacheDDS(caminhoCache, preparada.textura);
 
-	if (data)
+	if (!preparada.usouCache)
 	{
-		if (nrChannels == 3) // jpg, bmp
-		{
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		}
-		else // assume que é 4 canais png
+		preparada.textura.niveis.clear();
+		ImagemDecodificada imagem = decodificarImagem(filePath, 4);
+		if (imagem.dados)
 		{
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+			// Só usa alpha (BC3/RGBA8) se a imagem tiver alguma transparência de fato
+			bool comAlpha = false;
+			const unsigned char *data = imagem.dados.get();
+			for (size_t i = 3; imagem.canaisArquivo == 4 && i < (size_t)imagem.largura * imagem.altura * 4; i += 4)
+			{
+				if (data[i] != 255) { comAlpha = true; break; }
+			}
+			std::vector<NivelMip> mips = gerarCadeiaMipmapRGBA(data, imagem.largura, imagem.altura, repetirBordas);
+
+			if (comprimir)
+			{
+				preparada.textura.formato = comAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+				preparada.textura.niveis.resize(mips.size());
+				for (size_t i = 0; i < mips.size(); i++)
+				{
+					preparada.textura.niveis[i] = comprimirNivelBC(mips[i], comAlpha);
+				}
+			}
+			else
+			{
+				preparada.textura.formato = comAlpha ? GL_RGBA8 : GL_RGB8;
+				preparada.textura.niveis = std::move(mips);
+			}
+			salvarCacheDDS(caminhoCache, preparada.textura);
 		}
-		glGenerateMipmap(GL_TEXTURE_2D);
 	}
-	else
+
+	preparada.msCPU = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - inicio).count();
+	return preparada;
+}
+
+bool cacheDeTexturaValido(const std::string &filePath, bool comprimir)
+{
+	std::string caminhoCache = filePath + (comprimir ? ".dds" : ".rgba.dds");
+	std::error_code ec;
+	if (!std::filesystem::exists(caminhoCache, ec) ||
+		(std::filesystem::exists(filePath, ec) && std::filesystem::last_write_time(caminhoCache, ec) < std::filesystem::last_write_time(filePath, ec)))
 	{
-		std::cout << "Failed to load texture " << filePath << std::endl;
+		return false;
 	}
 
-	stbi_image_free(data);
+	// Cache de outra versão ou gerado com outro filtro conta como ausente (e é regravado)
+	std::ifstream arq(caminhoCache, std::ios::binary);
+	char magico[4];
+	uint32_t cabecalho[31];
+	return arq.read(magico, 4) && memcmp(magico, "DDS ", 4) == 0 && arq.read((char *)cabecalho, sizeof(cabecalho)) && cabecalhoDDSAtual(cabecalho);
+}
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+// Versão 1/8 da textura para mostrar enquanto a completa é preparada (niveis vazio se não for um JPEG baseline)
+TexturaPreparada prepararTexturaProvisoria(const std::string &filePath, bool repetirBordas)
+{
+	auto inicio = std::chrono::high_resolution_clock::now();
+	TexturaPreparada preparada;
+	preparada.caminho = filePath;
 
-	return texID;
+	ImagemDecodificada imagem = decodificarJPEGReduzido(filePath);
+	if (imagem.dados)
+	{
+		preparada.textura.formato = GL_RGB8;
+		preparada.textura.niveis = gerarCadeiaMipmapRGBA(imagem.dados.get(), imagem.largura, imagem.altura, repetirBordas);
+	}
+	preparada.msCPU = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - inicio).count();
+	return preparada;
 }
 
-int loadSimpleOBJ(string filePATH, int &nVertices, string &nomeMtl)
- {
-    std::string nomeArquivoMtl;
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec2> texCoords;
-    std::vector<glm::vec3> normals;
-    std::vector<GLfloat> vBuffer;
-    glm::vec3 color = glm::vec3(1.0, 1.0, 1.0);
-    GLuint texturaId = 0;
 
-    std::ifstream arqEntrada(filePATH.c_str());
-    if (!arqEntrada.is_open()) 
+// Parte de GPU do carregamento: só pode ser chamada na thread com o contexto da OpenGL
+GLuint enviarTextura(const TexturaPreparada &preparada, int &width, int &height)
+{
+	if (preparada.textura.niveis.empty())
 	{
-        std::cerr << "Erro ao tentar ler o arquivo " << filePATH << std::endl;
-        return -1;
-    }
+		std::cout << "Failed to load texture " << preparada.caminho << std::endl;
+		return 0;
+	}
 
-    std::string line;
-    while (std::getline(arqEntrada, line)) 
-	{
-        std::istringstream ssline(line);
-        std::string word;
-        ssline >> word;
+	auto inicio = std::chrono::high_resolution_clock::now();
+	size_t bytesAntes = bytesTexturasGPU;
 
-        if (word == "mtllib") 
-		{
-            ssline >> nomeArquivoMtl;
-        } 
-        if (word == "v") 
-		{
-            glm::vec3 vertice;
-            ssline >> vertice.x >> vertice.y >> vertice.z;
-            vertices.push_back(vertice);
-        } 
-        else if (word == "vt") 
-		{
-            glm::vec2 vt;
-            ssline >> vt.s >> vt.t;
-            texCoords.push_back(vt);
-        } 
-        else if (word == "vn") 
-		{
-            glm::vec3 normal;
-            ssline >> normal.x >> normal.y >> normal.z;
-            normals.push_back(normal);
-        } 
-        else if (word == "f")
-		 {
-            while (ssline >> word) 
-			{
-                int vi = 0, ti = 0, ni = 0;
-                std::istringstream ss(word);
-                std::string index;
+	width = preparada.textura.niveis[0].largura;
+	height = preparada.textura.niveis[0].altura;
+	GLuint texID = streamingTexturas ? registrarTexturaStreaming(preparada.textura) : uploadTextura2D(preparada.textura);
 
-                if (std::getline(ss, index, '/')) vi = !index.empty() ? std::stoi(index) - 1 : 0;
-                if (std::getline(ss, index, '/')) ti = !index.empty() ? std::stoi(index) - 1 : 0;
-                if (std::getline(ss, index)) ni = !index.empty() ? std::stoi(index) - 1 : 0;
+	float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - inicio).count();
+	cout << "Textura " << preparada.caminho << ": CPU " << preparada.msCPU << " ms + upload " << ms << " ms, " << (bytesTexturasGPU - bytesAntes) / 1024 << " KB na GPU ("
+		 << nomeFormato(preparada.textura.formato) << ", " << preparada.textura.niveis.size() << " mips" << (preparada.usouCache ? ", cache" : ", gerado")
+		 << (streamingTexturas ? ", streaming" : "") << ")" << endl;
+	return texID;
+}
 
-                vBuffer.push_back(vertices[vi].x);
-                vBuffer.push_back(vertices[vi].y);
-                vBuffer.push_back(vertices[vi].z);
-                vBuffer.push_back(color.r);
-                vBuffer.push_back(color.g);
-                vBuffer.push_back(color.b);
+// Começa a preparar a textura no pool; o upload acontece em enviarTexturasRequisitadas
+void requisitarTextura(const std::string &filePath)
+{
+    // Objetos que usam a mesma imagem (ex.: as duas luas) compartilham a mesma decodificação
+    if (texturasRequisitadas.count(filePath)) return;
+    texturasRequisitadas[filePath] = criarRequisicaoTextura(filePath);
+}
 
-                if (ti >= 0 && ti < texCoords.size()) {
-                    vBuffer.push_back(texCoords[ti].x);
-                    vBuffer.push_back(texCoords[ti].y);
-                } else {
-                    vBuffer.push_back(0.0f);
-                    vBuffer.push_back(0.0f);
-                }
-                
-                // Adicionando normais (nx, ny, nz)
-                if (ni >= 0 && ni < normals.size()) {
-                    vBuffer.push_back(normals[ni].x);
-                    vBuffer.push_back(normals[ni].y);
-                    vBuffer.push_back(normals[ni].z);
-                } else {
-                    vBuffer.push_back(0.0f);
-                    vBuffer.push_back(0.0f);
-                    vBuffer.push_back(0.0f);
-                }
-            }
-        }
+// Pode ser chamada de qualquer thread (as tarefas de leitura dos OBJs pedem a textura do material por aqui)
+RequisicaoTextura criarRequisicaoTextura(const std::string &filePath)
+{
+    bool comprimir = usarTexturasComprimidas && suportaCompressaoS3TC();
+    RequisicaoTextura requisicao;
+    if (carregamentoParalelo && texturasProvisorias && !cacheDeTexturaValido(filePath, comprimir))
+    {
+        requisicao.provisoria = agendarCarregamento([filePath]() {
+            return prepararTexturaProvisoria(filePath, true);
+        });
     }
+    requisicao.completa = agendarCarregamento([filePath, comprimir]() {
+        return prepararTextura(filePath, comprimir, true);
+    });
+    return requisicao;
+}
 
-    arqEntrada.close();
+// No pool quando o carregamento é paralelo; senão a tarefa roda na thread que pedir o resultado
+template <typename Funcao>
+auto agendarCarregamento(Funcao funcao) -> std::shared_future<decltype(funcao())>
+{
+    if (carregamentoParalelo)
+    {
+        return enviarJobComResultado(sistemaDeJobs, funcao).share();
+    }
+    return std::async(std::launch::deferred, funcao).share();
+}
 
-    if (!nomeArquivoMtl.empty()) {
-        std::string diretorioObj = filePATH.substr(0, filePATH.find_last_of("/\\") + 1);
-        std::string caminhoMTL = diretorioObj + nomeArquivoMtl;
-        std::ifstream arqMTL(caminhoMTL.c_str());
-        if (arqMTL.is_open()) {
-            std::string mtlLine;
-            while (std::getline(arqMTL, mtlLine)) {
-                std::istringstream ssmtl(mtlLine);
-                std::string mtlWord;
-                ssmtl >> mtlWord;
+// Tarefas adiadas (sem pool) contam como prontas: elas rodam no get()
+template <typename T>
+bool futuroPronto(const std::shared_future<T> &futuro)
+{
+    return futuro.wait_for(std::chrono::seconds(0)) != std::future_status::timeout;
+}
 
-                if (mtlWord == "newmtl") {
-                    ssmtl >> nomeMaterial;
-                    materiais[nomeMaterial] = Material();
-                    cout << "Nome material: " << nomeMaterial << endl;
-                }
+void enviarTexturasRequisitadas(std::vector<Object> &objs)
+{
+    // Espera só o que vai ser enviado agora: a provisória, se existir, senão a textura completa
+    for (auto &requisicao : texturasRequisitadas)
+    {
+        if (requisicao.second.provisoria.valid()) requisicao.second.provisoria.wait();
+        else requisicao.second.completa.wait();
+    }
+    marcarFaseInicializacao("espera das texturas no pool");
 
-                if (mtlWord == "Ka") {
-                    ssmtl >> materiais[nomeMaterial].ka.r >> materiais[nomeMaterial].ka.g >> materiais[nomeMaterial].ka.b;
-                }
+    // Cada imagem é enviada uma vez só; objetos com a mesma textura reaproveitam o id
+    std::unordered_map<std::string, Object> enviadas;
+    for (Object &obj : objs)
+    {
+        std::string caminho = "../assets/Modelos3D/" + obj.material.textureFile;
+        auto requisicao = texturasRequisitadas.find(caminho);
+        if (obj.texID != 0 || requisicao == texturasRequisitadas.end()) continue;
 
-                if (mtlWord == "Kd") {
-                    ssmtl >> materiais[nomeMaterial].kd.r >> materiais[nomeMaterial].kd.g >> materiais[nomeMaterial].kd.b;
-                }
+        auto enviada = enviadas.find(caminho);
+        if (enviada == enviadas.end())
+        {
+            const RequisicaoTextura &r = requisicao->second;
+            if (r.provisoria.valid() && !r.provisoria.get().textura.niveis.empty())
+            {
+                obj.texID = uploadTextura2D(r.provisoria.get().textura);
+                obj.TextureimgWidth = r.provisoria.get().textura.niveis[0].largura;
+                obj.TextureimgHeight = r.provisoria.get().textura.niveis[0].altura;
+                trocasDeTexturas.push_back({obj.texID, GL_TEXTURE_2D, {r.completa}});
+                cout << "Textura provisoria " << caminho << ": " << obj.TextureimgWidth << "x" << obj.TextureimgHeight << " em " << r.provisoria.get().msCPU << " ms" << endl;
+            }
+            else
+            {
+                obj.texID = enviarTextura(r.completa.get(), obj.TextureimgWidth, obj.TextureimgHeight);
+            }
+            enviadas[caminho] = obj;
+        }
+        else
+        {
+            obj.texID = enviada->second.texID;
+            obj.TextureimgWidth = enviada->second.TextureimgWidth;
+            obj.TextureimgHeight = enviada->second.TextureimgHeight;
+        }
+    }
+    texturasRequisitadas.clear(); // libera os pixels já enviados (as trocas pendentes guardam a sua cópia)
+    marcarFaseInicializacao("upload das texturas");
+}
 
-                if (mtlWord == "Ks") {
-                    ssmtl >> materiais[nomeMaterial].ks.r >> materiais[nomeMaterial].ks.g >> materiais[nomeMaterial].ks.b;
-                }
+// Troca no máximo uma textura provisória por frame, quando todas as partes da versão completa estão prontas.
+// A completa é enviada no mesmo nome de textura, então quem já usa o id passa a ver a nova versão no próximo draw
+void processarTrocasDeTexturas()
+{
+    for (size_t i = 0; i < trocasDeTexturas.size(); i++)
+    {
+        TrocaDeTextura &troca = trocasDeTexturas[i];
+        bool pronta = true;
+        for (const auto &parte : troca.partes)
+        {
+            pronta = pronta && parte.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }
+        if (!pronta) continue;
 
-                if (mtlWord == "map_Kd") {
-                    ssmtl >> materiais[nomeMaterial].textureFile;
-                    cout << "Nome arquivo textura: " << materiais[nomeMaterial].textureFile << endl;
-                }
+        if (troca.alvo == GL_TEXTURE_CUBE_MAP)
+        {
+            std::vector<TexturaPreparada> faces;
+            for (const auto &parte : troca.partes) faces.push_back(parte.get());
+            enviarFacesCubemap(troca.texID, faces);
+        }
+        else
+        {
+            const TexturaPreparada &completa = troca.partes[0].get();
+            if (!completa.textura.niveis.empty())
+            {
+                if (streamingTexturas) registrarTexturaStreaming(completa.textura, troca.texID);
+                else uploadTextura2D(completa.textura, troca.texID);
             }
-            arqMTL.close();
         }
-    }   
-
-    std::cout << "Gerando o buffer de geometria..." << std::endl;
-    GLuint VBO, VAO;
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vBuffer.size() * sizeof(GLfloat), vBuffer.data(), GL_STATIC_DRAW);
-    
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+        cout << "Textura " << troca.partes[0].get().caminho << " trocada pela versao completa" << endl;
+        trocasDeTexturas.erase(trocasDeTexturas.begin() + i);
+        break;
+    }
+}
 
-	GLsizei stride = 11 * sizeof(GLfloat);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);                    // posição
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(3 * sizeof(GLfloat))); // cor
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(6 * sizeof(GLfloat))); // texcoord
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(8 * sizeof(GLfloat))); // normal
+void iniciarSistemaDeJobs(SistemaDeJobs &sistema, int nWorkers)
+{
+    sistema.encerrar = false;
+    sistema.roubos = 0;
+    sistema.deques.clear();
+    for (int i = 0; i <= nWorkers; i++) sistema.deques.push_back(std::make_unique<DequeDeJobs>());
+    for (int i = 0; i < nWorkers; i++)
+    {
+        sistema.workers.emplace_back([&sistema, i]() {
+            sistemaDoWorker = &sistema;
+            indiceWorkerAtual = i;
+            while (true)
+            {
+                Job job;
+                if (pegarJob(sistema, job))
+                {
+                    executarJob(sistema, job);
+                    continue;
+                }
+                if (sistema.encerrar) return;
+                std::unique_lock<std::mutex> lock(sistema.mutexSono);
+                sistema.temJob.wait_for(lock, std::chrono::milliseconds(2), [&sistema]() { return sistema.encerrar || sistema.jobsNaFila > 0; });
+            }
+        });
+    }
+}
 
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glEnableVertexAttribArray(2);
-	glEnableVertexAttribArray(3);
+// Os workers só saem com as deques vazias
+void encerrarSistemaDeJobs(SistemaDeJobs &sistema)
+{
+    {
+        std::lock_guard<std::mutex> lock(sistema.mutexSono);
+        sistema.encerrar = true;
+    }
+    sistema.temJob.notify_all();
+    for (std::thread &worker : sistema.workers) worker.join();
+    sistema.workers.clear();
+}
 
-    
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+void enviarJob(SistemaDeJobs &sistema, std::function<void()> funcao, ContadorJobs *contador)
+{
+    if (contador) contador->restantes++;
+    inserirJob(sistema, {std::move(funcao), contador});
+}
 
-	nVertices = vBuffer.size() / 11;  // x, y, z, r, g, b, s, t, nx, ny, nz (valores atualmente armazenados por vértice)
-    nomeMtl = nomeMaterial;
-	cout << "nVertices: " << nVertices << endl;
-    return VAO;
+// O job só entra numa deque quando todos os jobs contados em dependencia terminarem
+void enviarJobDepoisDe(SistemaDeJobs &sistema, ContadorJobs &dependencia, std::function<void()> funcao, ContadorJobs *contador)
+{
+    if (contador) contador->restantes++;
+    {
+        std::lock_guard<std::mutex> lock(dependencia.mutex);
+        if (dependencia.restantes > 0)
+        {
+            dependencia.continuacoes.push_back({std::move(funcao), contador});
+            return;
+        }
+    }
+    inserirJob(sistema, {std::move(funcao), contador});
 }
 
-GLuint loadCubemap(vector<std::string> faces)
+void inserirJob(SistemaDeJobs &sistema, Job job)
 {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    // Um worker empilha na própria deque; as outras threads usam a última
+    int indice = sistemaDoWorker == &sistema ? indiceWorkerAtual : (int)sistema.deques.size() - 1;
+    {
+        std::lock_guard<std::mutex> lock(sistema.deques[indice]->mutex);
+        sistema.deques[indice]->jobs.push_back(std::move(job));
+    }
+    sistema.jobsNaFila++;
+    sistema.temJob.notify_one();
+}
 
-    int width, height, nrChannels;
-    for (GLuint i = 0; i < faces.size(); i++)
+bool pegarJob(SistemaDeJobs &sistema, Job &job)
+{
+    int n = (int)sistema.deques.size();
+    int proprio = sistemaDoWorker == &sistema ? indiceWorkerAtual : n - 1;
     {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
+        DequeDeJobs &deque = *sistema.deques[proprio];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        if (!deque.jobs.empty())
         {
-            GLenum format;
-            if (nrChannels == 3) format = GL_RGB;
-            else if (nrChannels == 4) format = GL_RGBA;
-            else format = GL_RGB; // Default to RGB
-
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
+            job = std::move(deque.jobs.back());
+            deque.jobs.pop_back();
+            sistema.jobsNaFila--;
+            return true;
         }
-        else
+    }
+    // Rouba o job mais antigo de outra deque, começando pela vizinha para espalhar os roubos
+    for (int k = 1; k < n; k++)
+    {
+        DequeDeJobs &vitima = *sistema.deques[(proprio + k) % n];
+        std::lock_guard<std::mutex> lock(vitima.mutex);
+        if (!vitima.jobs.empty())
         {
-            std::cout << "Erro ao tentar ler o cubemap do arquivo: " << faces[i] << std::endl;
-            stbi_image_free(data);
+            job = std::move(vitima.jobs.front());
+            vitima.jobs.pop_front();
+            sistema.jobsNaFila--;
+            sistema.roubos++;
+            return true;
         }
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE); // GL_TEXTURE_WRAP_R é para texturas 3D/cubemaps
+    return false;
+}
 
-    return textureID;
+void executarJob(SistemaDeJobs &sistema, Job &job)
+{
+    job.funcao();
+    if (!job.contador) return;
+
+    // O decremento acontece com o mutex preso: quem espera o contador trava o mutex antes de destruí-lo
+    std::vector<Job> continuacoes;
+    {
+        std::lock_guard<std::mutex> lock(job.contador->mutex);
+        if (--job.contador->restantes == 0) continuacoes.swap(job.contador->continuacoes);
+    }
+    for (Job &continuacao : continuacoes) inserirJob(sistema, std::move(continuacao));
 }
 
-void initializeCatmullRomMatrix(glm::mat4 &matrix)
+// Quem espera ajuda: executa jobs (de qualquer deque) até o contador zerar
+void esperarContador(SistemaDeJobs &sistema, ContadorJobs &contador)
 {
-    // matrix[0] = glm::vec4(-1.0f, 3.0f, -3.0f, 1.0f);
-    // matrix[1] = glm::vec4(2.0f, -5.0f, 4.0f, -1.0f);
-    // matrix[2] = glm::vec4(-1.0f, 0.0f, 1.0f, 0.0f);
-    // matrix[3] = glm::vec4(0.0f, 2.0f, 0.0f, 0.0f);
+    while (contador.restantes > 0)
+    {
+        Job job;
+        if (pegarJob(sistema, job)) executarJob(sistema, job);
+        else std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> lock(contador.mutex);
+}
 
-    matrix[0] = glm::vec4(-0.5f, 1.5f, -1.5f, 0.5f); // Primeira linha
-    matrix[1] = glm::vec4(1.0f, -2.5f, 2.0f, -0.5f); // Segunda linha
-    matrix[2] = glm::vec4(-0.5f, 0.0f, 0.5f, 0.0f);  // Terceira linha
-    matrix[3] = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);   // Quarta linha
+// Envia a função como job e devolve um future com o resultado
+template <typename Funcao>
+auto enviarJobComResultado(SistemaDeJobs &sistema, Funcao funcao) -> std::future<decltype(funcao())>
+{
+    auto tarefa = std::make_shared<std::packaged_task<decltype(funcao())()>>(std::move(funcao));
+    std::future<decltype(funcao())> resultado = tarefa->get_future();
+    if (sistema.workers.empty()) (*tarefa)(); // ninguém executaria o job enquanto quem chamou espera o future
+    else enviarJob(sistema, [tarefa]() { (*tarefa)(); });
+    return resultado;
 }
 
-void generateCatmullRomCurvePoints(Curve &curve, int numPoints)
+bool mapearArquivo(const std::string &filePath, ArquivoMapeado &arquivo)
+{
+#ifdef _WIN32
+    arquivo.arquivo = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (arquivo.arquivo == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER tamanho;
+    GetFileSizeEx(arquivo.arquivo, &tamanho);
+    arquivo.tamanho = (size_t)tamanho.QuadPart;
+    arquivo.mapeamento = CreateFileMappingA(arquivo.arquivo, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (arquivo.mapeamento) arquivo.dados = (const unsigned char *)MapViewOfFile(arquivo.mapeamento, FILE_MAP_READ, 0, 0, 0);
+#else
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        arquivo.tamanho = (size_t)info.st_size;
+        void *mapa = mmap(nullptr, arquivo.tamanho, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapa != MAP_FAILED) arquivo.dados = (const unsigned char *)mapa;
+    }
+    close(fd); // o mapeamento continua válido depois de fechar o descritor
+#endif
+    if (!arquivo.dados)
+    {
+        desmapearArquivo(arquivo);
+        return false;
+    }
+    return true;
+}
+
+void desmapearArquivo(ArquivoMapeado &arquivo)
 {
-    curve.curvePoints.clear(); // Limpa quaisquer pontos antigos da curva
+#ifdef _WIN32
+    if (arquivo.dados) UnmapViewOfFile(arquivo.dados);
+    if (arquivo.mapeamento) CloseHandle(arquivo.mapeamento);
+    if (arquivo.arquivo != INVALID_HANDLE_VALUE) CloseHandle(arquivo.arquivo);
+    arquivo.mapeamento = nullptr;
+    arquivo.arquivo = INVALID_HANDLE_VALUE;
+#else
+    if (arquivo.dados) munmap((void *)arquivo.dados, arquivo.tamanho);
+#endif
+    arquivo.dados = nullptr;
+    arquivo.tamanho = 0;
+}
 
-    initializeCatmullRomMatrix(curve.M);
+// Decodifica a imagem direto do arquivo mapeado (canaisDesejados = 0 mantém os canais do arquivo)
+ImagemDecodificada decodificarImagem(const std::string &filePath, int canaisDesejados)
+{
+    ImagemDecodificada imagem;
+    ArquivoMapeado arquivo;
+    if (!mapearArquivo(filePath, arquivo))
+    {
+        return imagem;
+    }
 
-    float piece = 1.0 / (float)numPoints;
-    float t;
-    for (int i = 0; i < curve.controlPoints.size() - 3; i++)
+    unsigned char *data = stbi_load_from_memory(arquivo.dados, (int)arquivo.tamanho, &imagem.largura, &imagem.altura, &imagem.canaisArquivo, canaisDesejados);
+    desmapearArquivo(arquivo);
+    if (data)
     {
-        for (int j = 0; j <= numPoints; j++)
-        {
-            t = j * piece;
+        imagem.dados.reset(data, stbi_image_free);
+        imagem.canais = canaisDesejados != 0 ? canaisDesejados : imagem.canaisArquivo;
+    }
+    return imagem;
+}
 
-            glm::vec4 T(t * t * t, t * t, t, 1);
+// Tabela Huffman de um JPEG baseline (códigos canônicos) com busca rápida de 9 bits
+struct TabelaHuffmanJPEG
+{
+    unsigned char simbolos[256];
+    int codigoMaximo[18];        // maior código de cada tamanho (-1 se não houver códigos desse tamanho)
+    int deslocamento[17];        // simbolos[deslocamento[n] + codigo] para códigos de n bits
+    unsigned short rapida[512];  // (tamanho << 8) | símbolo para códigos de até 9 bits, 0 = usar a busca lenta
+};
 
-            glm::vec3 P0 = curve.controlPoints[i];
-            glm::vec3 P1 = curve.controlPoints[i + 1];
-            glm::vec3 P2 = curve.controlPoints[i + 2];
-            glm::vec3 P3 = curve.controlPoints[i + 3];
+// Leitor de bits do fluxo entrópico (remove os bytes 0x00 após 0xFF e para nos marcadores)
+struct LeitorBitsJPEG
+{
+    const unsigned char *p, *fim;
+    uint32_t buffer = 0; // bits alinhados à esquerda
+    int nBits = 0;
+    bool marcador = false;
+};
 
-            glm::mat4x3 G(P0, P1, P2, P3);
+void montarTabelaHuffmanJPEG(TabelaHuffmanJPEG &tabela, const unsigned char *contagens, const unsigned char *simbolos)
+{
+    memset(tabela.rapida, 0, sizeof(tabela.rapida));
+    int codigo = 0, k = 0;
+    for (int tamanho = 1; tamanho <= 16; tamanho++)
+    {
+        tabela.deslocamento[tamanho] = k - codigo;
+        for (int i = 0; i < contagens[tamanho - 1]; i++, k++, codigo++)
+        {
+            tabela.simbolos[k] = simbolos[k];
+            if (tamanho <= 9)
+            {
+                int inicio = codigo << (9 - tamanho);
+                for (int j = 0; j < (1 << (9 - tamanho)); j++)
+                {
+                    tabela.rapida[inicio + j] = (unsigned short)((tamanho << 8) | simbolos[k]);
+                }
+            }
+        }
+        tabela.codigoMaximo[tamanho] = contagens[tamanho - 1] ? codigo - 1 : -1;
+        codigo <<= 1;
+    }
+    tabela.codigoMaximo[17] = 0x7FFFFFFF;
+}
 
-            glm::vec3 point = G * curve.M * T;
-            curve.curvePoints.push_back(point);
+void preencherBitsJPEG(LeitorBitsJPEG &leitor)
+{
+    while (leitor.nBits <= 24)
+    {
+        unsigned int byte = 0; // depois de um marcador o fluxo é completado com zeros
+        if (!leitor.marcador && leitor.p < leitor.fim)
+        {
+            byte = *leitor.p;
+            if (byte == 0xFF)
+            {
+                unsigned char proximo = leitor.p + 1 < leitor.fim ? leitor.p[1] : 0xD9;
+                if (proximo == 0x00) leitor.p += 2;
+                else { leitor.marcador = true; byte = 0; }
+            }
+            else
+            {
+                leitor.p++;
+            }
         }
+        leitor.buffer |= byte << (24 - leitor.nBits);
+        leitor.nBits += 8;
     }
 }
 
-GLuint generateControlPointsBuffer(vector<glm::vec3> controlPoints)
+int lerBitsJPEG(LeitorBitsJPEG &leitor, int n)
 {
-    GLuint VBO, VAO;
+    if (n == 0) return 0;
+    preencherBitsJPEG(leitor);
+    int valor = (int)(leitor.buffer >> (32 - n));
+    leitor.buffer <<= n;
+    leitor.nBits -= n;
+    return valor;
+}
 
-    // Geração do identificador do VBO
-    glGenBuffers(1, &VBO);
+int decodificarHuffmanJPEG(LeitorBitsJPEG &leitor, const TabelaHuffmanJPEG &tabela)
+{
+    preencherBitsJPEG(leitor);
+    unsigned short entrada = tabela.rapida[leitor.buffer >> 23];
+    if (entrada)
+    {
+        leitor.buffer <<= entrada >> 8;
+        leitor.nBits -= entrada >> 8;
+        return entrada & 0xFF;
+    }
+    int codigo = 0;
+    for (int tamanho = 1; tamanho <= 16; tamanho++)
+    {
+        codigo = (codigo << 1) | (int)(leitor.buffer >> 31);
+        leitor.buffer <<= 1;
+        leitor.nBits--;
+        if (codigo <= tabela.codigoMaximo[tamanho]) return tabela.simbolos[tabela.deslocamento[tamanho] + codigo];
+    }
+    return -1; // código inválido
+}
 
-    // Faz a conexão (vincula) do buffer como um buffer de array
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+// Valor com sinal de n bits (codificação de magnitude do JPEG)
+int estenderSinalJPEG(int valor, int n)
+{
+    return (n > 0 && valor < (1 << (n - 1))) ? valor - (1 << n) + 1 : valor;
+}
 
-    // Envia os dados do array de floats para o buffer da OpenGl
-    glBufferData(GL_ARRAY_BUFFER, controlPoints.size() * sizeof(GLfloat) * 3, controlPoints.data(), GL_STATIC_DRAW);
+// Decodifica só o DC de cada bloco 8x8: o DC é a média do bloco, então a imagem sai com 1/8 do tamanho sem nenhuma IDCT.
+// Suporta JPEG baseline (SOF0/SOF1) com 1 ou 3 componentes e qualquer subamostragem; progressivo retorna false
+bool decodificarJPEGReduzidoMemoria(const unsigned char *dados, size_t tamanho, ImagemDecodificada &imagem)
+{
+    struct ComponenteJPEG
+    {
+        int id, h, v, tabelaQuant, tabelaDC, tabelaAC;
+        int blocosX, blocosY, predicao;
+        std::vector<unsigned char> plano; // um valor (média do bloco) por bloco
+    };
+    int quantDC[4] = {1, 1, 1, 1};
+    TabelaHuffmanJPEG tabelas[2][4]; // [0 = DC, 1 = AC][id]
+    bool tabelaDefinida[2][4] = {}; // uma varredura que usa tabela sem DHT fica para a stb_image
+    std::vector<ComponenteJPEG> componentes;
+    int largura = 0, altura = 0, intervaloReinicio = 0;
 
-    // Geração do identificador do VAO (Vertex Array Object)
-    glGenVertexArrays(1, &VAO);
+    const unsigned char *p = dados, *fim = dados + tamanho;
+    if (tamanho < 4 || p[0] != 0xFF || p[1] != 0xD8) return false;
+    p += 2;
 
-    // Vincula (bind) o VAO primeiro, e em seguida  conecta e seta o(s) buffer(s) de vértices
-    // e os ponteiros para os atributos
-    glBindVertexArray(VAO);
+    while (p + 4 <= fim)
+    {
+        if (p[0] != 0xFF) return false;
+        int marcador = p[1];
+        if (marcador == 0xFF) { p++; continue; }
+        int tamanhoSegmento = (p[2] << 8) | p[3];
+        const unsigned char *seg = p + 4, *fimSeg = p + 2 + tamanhoSegmento;
+        if (fimSeg > fim) return false;
+
+        if (marcador == 0xC0 || marcador == 0xC1) // SOF baseline / sequencial estendido
+        {
+            if (seg[0] != 8) return false;
+            altura = (seg[1] << 8) | seg[2];
+            largura = (seg[3] << 8) | seg[4];
+            int nComponentes = seg[5];
+            if (nComponentes != 1 && nComponentes != 3) return false;
+            if (seg + 6 + nComponentes * 3 > fimSeg) return false;
+            for (int i = 0; i < nComponentes; i++)
+            {
+                ComponenteJPEG c = {};
+                c.id = seg[6 + i * 3];
+                c.h = seg[7 + i * 3] >> 4;
+                c.v = seg[7 + i * 3] & 15;
+                c.tabelaQuant = seg[8 + i * 3] & 3;
+                if (c.h < 1 || c.v < 1) return false;
+                componentes.push_back(c);
+            }
+        }
+        else if ((marcador >= 0xC2 && marcador <= 0xCF) && marcador != 0xC4 && marcador != 0xC8 && marcador != 0xCC)
+        {
+            return false; // progressivo, sem perdas ou aritmético: fica para a stb_image
+        }
+        else if (marcador == 0xDB) // DQT: só o primeiro coeficiente (DC) de cada tabela interessa
+        {
+            const unsigned char *q = seg;
+            while (q < fimSeg)
+            {
+                int precisao = q[0] >> 4, id = q[0] & 3;
+                if (q + 1 + 64 * (precisao ? 2 : 1) > fimSeg) return false; // tabela truncada
+                quantDC[id] = precisao ? ((q[1] << 8) | q[2]) : q[1];
+                q += 1 + 64 * (precisao ? 2 : 1);
+            }
+        }
+        else if (marcador == 0xC4) // DHT
+        {
+            const unsigned char *h = seg;
+            while (h + 17 <= fimSeg)
+            {
+                int classe = h[0] >> 4, id = h[0] & 3;
+                int total = 0;
+                for (int i = 0; i < 16; i++) total += h[1 + i];
+                if (classe > 1 || total > 256 || h + 17 + total > fimSeg) return false;
+                montarTabelaHuffmanJPEG(tabelas[classe][id], h + 1, h + 17);
+                tabelaDefinida[classe][id] = true;
+                h += 17 + total;
+            }
+        }
+        else if (marcador == 0xDD) // DRI
+        {
+            intervaloReinicio = (seg[0] << 8) | seg[1];
+        }
+        else if (marcador == 0xDA) // SOS: só uma varredura com todos os componentes (caso comum do baseline)
+        {
+            int nVarredura = seg[0];
+            if (componentes.empty() || nVarredura != (int)componentes.size() || seg + 1 + nVarredura * 2 > fimSeg) return false;
+            for (int i = 0; i < nVarredura; i++)
+            {
+                int tabelaDC = seg[2 + i * 2] >> 4, tabelaAC = seg[2 + i * 2] & 15;
+                if (tabelaDC > 3 || tabelaAC > 3 || !tabelaDefinida[0][tabelaDC] || !tabelaDefinida[1][tabelaAC]) return false;
+                for (ComponenteJPEG &c : componentes)
+                {
+                    if (c.id == seg[1 + i * 2])
+                    {
+                        c.tabelaDC = tabelaDC;
+                        c.tabelaAC = tabelaAC;
+                    }
+                }
+            }
+            p = fimSeg;
+            break;
+        }
+        p = fimSeg;
+    }
+    if (componentes.empty() || largura == 0 || altura == 0 || p >= fim) return false;
 
-    // Atributo posição (x, y, z)
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid *)0);
-    glEnableVertexAttribArray(0);
+    int hMax = 1, vMax = 1;
+    for (const ComponenteJPEG &c : componentes) { hMax = std::max(hMax, c.h); vMax = std::max(vMax, c.v); }
+    if (componentes.size() == 1) componentes[0].h = componentes[0].v = hMax = vMax = 1; // não intercalado: um bloco por MCU
+    int mcusX = (largura + 8 * hMax - 1) / (8 * hMax), mcusY = (altura + 8 * vMax - 1) / (8 * vMax);
+    for (ComponenteJPEG &c : componentes)
+    {
+        c.blocosX = mcusX * c.h;
+        c.blocosY = mcusY * c.v;
+        c.plano.resize((size_t)c.blocosX * c.blocosY);
+    }
 
-    // Observe que isso é permitido, a chamada para glVertexAttribPointer registrou o VBO como o objeto de buffer de vértice
-    // atualmente vinculado - para que depois possamos desvincular com segurança
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    LeitorBitsJPEG leitor;
+    leitor.p = p;
+    leitor.fim = fim;
+    int mcusAteReinicio = intervaloReinicio;
+    for (int my = 0; my < mcusY; my++)
+    {
+        for (int mx = 0; mx < mcusX; mx++)
+        {
+            if (intervaloReinicio && mcusAteReinicio-- == 0)
+            {
+                // Marcador RSTn: descarta os bits restantes e zera a predição do DC
+                while (leitor.p + 1 < leitor.fim && !(leitor.p[0] == 0xFF && leitor.p[1] >= 0xD0 && leitor.p[1] <= 0xD7)) leitor.p++;
+                leitor.p += 2;
+                leitor.buffer = 0;
+                leitor.nBits = 0;
+                leitor.marcador = false;
+                for (ComponenteJPEG &c : componentes) c.predicao = 0;
+                mcusAteReinicio = intervaloReinicio - 1;
+            }
 
-    // Desvincula o VAO (é uma boa prática desvincular qualquer buffer ou array para evitar bugs medonhos)
-    glBindVertexArray(0);
+            for (ComponenteJPEG &c : componentes)
+            {
+                const TabelaHuffmanJPEG &tabelaDC = tabelas[0][c.tabelaDC], &tabelaAC = tabelas[1][c.tabelaAC];
+                for (int by = 0; by < c.v; by++)
+                {
+                    for (int bx = 0; bx < c.h; bx++)
+                    {
+                        int categoria = decodificarHuffmanJPEG(leitor, tabelaDC);
+                        if (categoria < 0 || categoria > 11) return false;
+                        c.predicao += estenderSinalJPEG(lerBitsJPEG(leitor, categoria), categoria);
+
+                        // Os ACs precisam ser lidos para avançar no fluxo, mas não são usados
+                        for (int k = 1; k < 64;)
+                        {
+                            int rs = decodificarHuffmanJPEG(leitor, tabelaAC);
+                            if (rs < 0) return false;
+                            int zeros = rs >> 4, bits = rs & 15;
+                            if (bits == 0)
+                            {
+                                if (zeros != 15) break; // fim de bloco
+                                k += 16;
+                                continue;
+                            }
+                            lerBitsJPEG(leitor, bits);
+                            k += zeros + 1;
+                        }
+
+                        // Média do bloco = DC / 8 + 128 (desfaz o deslocamento de nível)
+                        int media = c.predicao * quantDC[c.tabelaQuant] / 8 + 128;
+                        c.plano[(size_t)(my * c.v + by) * c.blocosX + mx * c.h + bx] = (unsigned char)std::min(255, std::max(0, media));
+                    }
+                }
+            }
+        }
+    }
 
-    return VAO;
+    imagem.largura = (largura + 7) / 8;
+    imagem.altura = (altura + 7) / 8;
+    imagem.canais = 4;
+    imagem.canaisArquivo = (int)componentes.size();
+    unsigned char *rgba = (unsigned char *)malloc((size_t)imagem.largura * imagem.altura * 4);
+    for (int y = 0; y < imagem.altura; y++)
+    {
+        for (int x = 0; x < imagem.largura; x++)
+        {
+            int valores[3];
+            for (size_t i = 0; i < componentes.size(); i++)
+            {
+                const ComponenteJPEG &c = componentes[i];
+                valores[i] = c.plano[(size_t)(y * c.v / vMax) * c.blocosX + x * c.h / hMax];
+            }
+            unsigned char *pixel = &rgba[((size_t)y * imagem.largura + x) * 4];
+            if (componentes.size() == 1)
+            {
+                pixel[0] = pixel[1] = pixel[2] = (unsigned char)valores[0];
+            }
+            else
+            {
+                // YCbCr (JFIF) para RGB
+                float Y = (float)valores[0], cb = valores[1] - 128.0f, cr = valores[2] - 128.0f;
+                pixel[0] = (unsigned char)std::min(255.0f, std::max(0.0f, Y + 1.402f * cr + 0.5f));
+                pixel[1] = (unsigned char)std::min(255.0f, std::max(0.0f, Y - 0.344136f * cb - 0.714136f * cr + 0.5f));
+                pixel[2] = (unsigned char)std::min(255.0f, std::max(0.0f, Y + 1.772f * cb + 0.5f));
+            }
+            pixel[3] = 255;
+        }
+    }
+    imagem.dados.reset(rgba, free);
+    return true;
 }
 
-std::vector<glm::vec3> loadPontosDaCurvaDoArquivo(const std::string& filePath)
+ImagemDecodificada decodificarJPEGReduzido(const std::string &filePath)
 {
-    std::vector<glm::vec3> controlPoints;
-    std::ifstream file(filePath);
-    if (!file.is_open()) {
-        std::cerr << "Erro ao tentar ler o arquivo dos pontos de controle: " << filePath << std::endl;
-        return controlPoints;
+    ImagemDecodificada imagem;
+    ArquivoMapeado arquivo;
+    if (!mapearArquivo(filePath, arquivo))
+    {
+        return imagem;
+    }
+    if (!decodificarJPEGReduzidoMemoria(arquivo.dados, arquivo.tamanho, imagem))
+    {
+        imagem = ImagemDecodificada();
     }
+    desmapearArquivo(arquivo);
+    return imagem;
+}
 
-    std::string line;
-    while (std::getline(file, line)) {
-        if (line.empty() || line[0] == '#') {
-            continue;
-        }
+void marcarFaseInicializacao(const std::string &nome)
+{
+    auto agora = std::chrono::high_resolution_clock::now();
+    temposFases.push_back({nome, std::chrono::duration<float, std::milli>(agora - inicioFase).count()});
+    inicioFase = agora;
+}
 
-        std::stringstream ss(line);
-        float x, y, z;
-        if (ss >> x >> y >> z) {
-            controlPoints.push_back(glm::vec3(x, y, z));
-        } else {
-            std::cerr << "Erro ao parsear linha no arquivo de pontos de controle: " << line << std::endl;
-        }
+void imprimirFasesInicializacao()
+{
+    float total = 0.0f;
+    cout << "Inicializacao (" << (carregamentoParalelo ? "paralela" : "sequencial") << "):" << endl;
+    for (const auto &fase : temposFases)
+    {
+        cout << "  " << fase.first << ": " << fase.second << " ms" << endl;
+        total += fase.second;
     }
-    file.close();
-    return controlPoints;
+    cout << "  total: " << total << " ms" << endl;
 }
-void loadSceneConfiguration(const std::string& configFilePath, std::vector<Object>& objs, glm::vec3& cameraPos, glm::vec3& cameraFront, glm::vec3& cameraUp, float& rotacaoYaw, float& rotaocaoPitch, glm::vec3& lightPos)
+
+// Executa funcao(i) para i em [inicio, fim): a thread que chama e os workers do sistema de jobs pegam lotes de um
+// contador atômico. Quem chama só espera pelos lotes já pegos, nunca por jobs que ainda estão na fila atrás de outros
+template <typename Funcao>
+void executarEmParalelo(int inicio, int fim, Funcao funcao, int tamanhoLote)
 {
-    std::ifstream configFile(configFilePath);
-    if (!configFile.is_open()) {
-        std::cerr << "ERRO: Nao foi possivel abrir o arquivo de configuracao: " << configFilePath << std::endl;
+    int total = fim - inicio;
+    if (tamanhoLote <= 0)
+    {
+        tamanhoLote = std::max(1, total / (4 * ((int)sistemaDeJobs.workers.size() + 1)));
+    }
+    int lotes = (total + tamanhoLote - 1) / tamanhoLote;
+    int ajudantes = std::min((int)sistemaDeJobs.workers.size(), lotes - 1);
+    if (ajudantes <= 0)
+    {
+        for (int i = inicio; i < fim; i++) funcao(i);
         return;
     }
 
-    std::string line;
-    bool inObjectBlock = false;
-    bool inCameraBlock = false;
-    bool inLightBlock = false;
-    Object currentObject;
-    while (std::getline(configFile, line)) {
-        std::stringstream ss(line);
-        std::string tag;
-        ss >> tag;
+    struct Estado
+    {
+        std::atomic<int> proximo, concluidos{0};
+    };
+    auto estado = std::make_shared<Estado>();
+    estado->proximo = inicio;
+    Funcao *f = &funcao; // só é usado por quem pegar um lote, e nenhum lote sobra depois que esta função retorna
+    auto trabalhar = [estado, f, fim, tamanhoLote]() {
+        while (true)
+        {
+            int a = estado->proximo.fetch_add(tamanhoLote);
+            if (a >= fim) return;
+            int b = std::min(fim, a + tamanhoLote);
+            for (int i = a; i < b; i++) (*f)(i);
+            estado->concluidos += b - a;
+        }
+    };
+    for (int i = 0; i < ajudantes; i++) enviarJob(sistemaDeJobs, trabalhar);
+    trabalhar();
+    while (estado->concluidos < total) std::this_thread::yield();
+}
 
-        if (tag == "<OBJECT>") {
-            inObjectBlock = true;
-            inCameraBlock = false;
-            currentObject = Object();
-            currentObject.posX = 0.0f; currentObject.posY = 0.0f; currentObject.posZ = 0.0f;
-            currentObject.rotateX = false; currentObject.rotateY = false; currentObject.rotateZ = false;
-            currentObject.tamanhoEscala = 1.0f;
-            currentObject.model = glm::mat4(1.0f);
-            
-        } else if (tag == "<CAMERA>") {
-            inObjectBlock = false;
-            inCameraBlock = true;
-        } else if (tag == "<LIGHT>") {
-            inObjectBlock = false;
-            inCameraBlock = false;
-            inLightBlock = true;
-        } else if (tag == "</OBJECT>") {
-            if (inObjectBlock) {
-                if (!currentObject.NomeObj.empty()) {
-                    currentObject.VAO = loadSimpleOBJ("../assets/Modelos3D/" + currentObject.NomeObj, currentObject.nVertices, currentObject.nomeDoMaterial);
-                    currentObject.material = materiais[currentObject.nomeDoMaterial];
-                    currentObject.texID = loadTexture("../assets/Modelos3D/" + currentObject.material.textureFile, currentObject.TextureimgWidth, currentObject.TextureimgHeight);
-                    currentObject.model = glm::mat4(1.0f);
-                    currentObject.model = glm::translate(currentObject.model, glm::vec3(currentObject.posX, currentObject.posY, currentObject.posZ));
-                    currentObject.tamanhoEscala = currentObject.tamanhoEscala;
-                    currentObject.model = glm::scale(currentObject.model, glm::vec3(currentObject.tamanhoEscala));
-
-                    objs.push_back(currentObject);
-                } else {
-                    std::cerr << "AVISO: <OBJECT> sem nome especificado." << std::endl;
+bool suportaCompressaoS3TC()
+{
+    static int suportado = -1; // consulta a lista de extensões só uma vez
+    if (suportado < 0)
+    {
+        suportado = 0;
+        GLint nExtensoes = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &nExtensoes);
+        for (GLint i = 0; i < nExtensoes; i++)
+        {
+            const char *ext = (const char *)glGetStringi(GL_EXTENSIONS, i);
+            if (ext && strcmp(ext, "GL_EXT_texture_compression_s3tc") == 0)
+            {
+                suportado = 1;
+                break;
+            }
+        }
+        if (!suportado) cout << "GL_EXT_texture_compression_s3tc indisponivel, texturas nao serao comprimidas" << endl;
+    }
+    return suportado == 1;
+}
+
+const float *tabelaSRGBParaLinear()
+{
+    static const std::vector<float> tabela = []() {
+        std::vector<float> t(256);
+        for (int i = 0; i < 256; i++)
+        {
+            float c = i / 255.0f;
+            t[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return t;
+    }();
+    return tabela.data();
+}
+
+unsigned char linearParaSRGB(float valor)
+{
+    // Tabela de 4096 entradas no lugar de pow() por pixel
+    static const std::vector<unsigned char> tabela = []() {
+        std::vector<unsigned char> t(4096);
+        for (int i = 0; i < 4096; i++)
+        {
+            float l = i / 4095.0f;
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            t[i] = (unsigned char)std::lround(c * 255.0f);
+        }
+        return t;
+    }();
+    int indice = (int)(std::min(1.0f, std::max(0.0f, valor)) * 4095.0f + 0.5f);
+    return tabela[indice];
+}
+
+std::vector<PesosFiltro> calcularPesosFiltro(int tamanhoOrigem, int tamanhoDestino, FiltroMipmap filtro)
+{
+    // Função de Bessel modificada I0 para a janela de Kaiser
+    auto besselI0 = [](float x) {
+        float soma = 1.0f, termo = 1.0f;
+        for (int k = 1; k < 16; k++)
+        {
+            termo *= (x / (2.0f * k)) * (x / (2.0f * k));
+            soma += termo;
+        }
+        return soma;
+    };
+    const float alpha = 4.0f;
+    const float raio = filtro == FILTRO_KAISER ? 1.5f : 0.5f; // em pixels de destino
+
+    std::vector<PesosFiltro> resultado(tamanhoDestino);
+    float escala = (float)tamanhoOrigem / tamanhoDestino;
+    for (int x = 0; x < tamanhoDestino; x++)
+    {
+        float centro = (x + 0.5f) * escala;
+        int primeiro = (int)std::floor(centro - raio * escala);
+        int ultimo = (int)std::ceil(centro + raio * escala);
+        PesosFiltro &pf = resultado[x];
+        pf.primeiro = primeiro;
+
+        float soma = 0.0f;
+        for (int i = primeiro; i < ultimo; i++)
+        {
+            float peso;
+            if (filtro == FILTRO_KAISER)
+            {
+                float d = (i + 0.5f - centro) / escala;
+                float t = d / raio;
+                float sinc = std::fabs(d) < 1e-5f ? 1.0f : std::sin(3.14159265f * d) / (3.14159265f * d);
+                peso = std::fabs(t) >= 1.0f ? 0.0f : sinc * besselI0(alpha * std::sqrt(1.0f - t * t)) / besselI0(alpha);
+            }
+            else
+            {
+                // Quanto do pixel [i, i+1] cai dentro da área do pixel de destino
+                peso = std::max(0.0f, std::min((float)i + 1.0f, centro + escala * 0.5f) - std::max((float)i, centro - escala * 0.5f));
+            }
+            pf.pesos.push_back(peso);
+            soma += peso;
+        }
+        for (float &peso : pf.pesos) peso /= soma;
+    }
+    return resultado;
+}
+
+// Soma origem * peso em destino (4 floats RGBA)
+inline void acumularPixel(float *destino, const float *origem, float peso)
+{
+#ifdef MIPMAP_SSE2
+    _mm_storeu_ps(destino, _mm_add_ps(_mm_loadu_ps(destino), _mm_mul_ps(_mm_loadu_ps(origem), _mm_set1_ps(peso))));
+#else
+    for (int c = 0; c < 4; c++) destino[c] += origem[c] * peso;
+#endif
+}
+
+std::vector<NivelMip> gerarCadeiaMipmapRGBA(const unsigned char *rgba, int width, int height, bool repetirBordas)
+{
+    std::vector<NivelMip> niveis;
+    niveis.push_back({width, height, std::vector<unsigned char>(rgba, rgba + (size_t)width * height * 4)});
+
+    // A filtragem é feita em espaço linear (as cores da imagem estão em sRGB); o alpha já é linear
+    const float *paraLinear = tabelaSRGBParaLinear();
+    std::vector<float> atual((size_t)width * height * 4);
+    executarEmParalelo(0, height, [&](int y) {
+        for (size_t i = (size_t)y * width * 4; i < (size_t)(y + 1) * width * 4; i += 4)
+        {
+            atual[i] = paraLinear[rgba[i]];
+            atual[i + 1] = paraLinear[rgba[i + 1]];
+            atual[i + 2] = paraLinear[rgba[i + 2]];
+            atual[i + 3] = rgba[i + 3] / 255.0f;
+        }
+    });
+
+    // Índice fora da imagem: repete a textura (GL_REPEAT) ou prende na borda (faces do cubemap)
+    auto ajustarIndice = [repetirBordas](int i, int tamanho) {
+        if (repetirBordas) return ((i % tamanho) + tamanho) % tamanho;
+        return std::min(std::max(i, 0), tamanho - 1);
+    };
+
+    // Cada nível sai do anterior com um filtro separável: primeiro nas linhas, depois nas colunas
+    int w = width, h = height;
+    while (w > 1 || h > 1)
+    {
+        int nw = std::max(1, w / 2), nh = std::max(1, h / 2);
+        std::vector<PesosFiltro> pesosX = calcularPesosFiltro(w, nw, filtroMipmaps);
+        std::vector<PesosFiltro> pesosY = calcularPesosFiltro(h, nh, filtroMipmaps);
+
+        std::vector<float> horizontal((size_t)nw * h * 4, 0.0f);
+        executarEmParalelo(0, h, [&](int y) {
+            const float *linha = &atual[(size_t)y * w * 4];
+            float *destino = &horizontal[(size_t)y * nw * 4];
+            for (int x = 0; x < nw; x++)
+            {
+                const PesosFiltro &pf = pesosX[x];
+                for (size_t k = 0; k < pf.pesos.size(); k++)
+                {
+                    acumularPixel(&destino[x * 4], &linha[ajustarIndice(pf.primeiro + (int)k, w) * 4], pf.pesos[k]);
                 }
             }
-            inObjectBlock = false;
-        } else if (tag == "</CAMERA>") {
-            inCameraBlock = false;
-        } else if (tag == "</LIGHT>") {
-            inLightBlock = false;
-        } else if (inObjectBlock) {
-            if (tag == "nomeObj") {
-                ss >> currentObject.NomeObj;
-            } else if (tag == "rotacaoX") {
-                ss >> currentObject.rotateX;
-            } else if (tag == "rotacaoY") {
-                ss >> currentObject.rotateY;
-            } else if (tag == "rotacaoZ") {
-                ss >> currentObject.rotateZ;
-            }else if (tag == "trans") {
-                ss >> currentObject.posX >> currentObject.posY >> currentObject.posZ;
-            } else if (tag == "escala") {
-                ss >> currentObject.tamanhoEscala;
+        });
+
+        std::vector<float> proximo((size_t)nw * nh * 4, 0.0f);
+        NivelMip nivel = {nw, nh, std::vector<unsigned char>((size_t)nw * nh * 4)};
+        executarEmParalelo(0, nh, [&](int y) {
+            float *destino = &proximo[(size_t)y * nw * 4];
+            const PesosFiltro &pf = pesosY[y];
+            for (size_t k = 0; k < pf.pesos.size(); k++)
+            {
+                const float *linha = &horizontal[(size_t)ajustarIndice(pf.primeiro + (int)k, h) * nw * 4];
+                for (int x = 0; x < nw; x++)
+                {
+                    acumularPixel(&destino[x * 4], &linha[x * 4], pf.pesos[k]);
+                }
             }
-        } else if (inCameraBlock) {
-            if (tag == "pos") {
-                ss >> cameraPos.x >> cameraPos.y >> cameraPos.z;
-            } else if (tag == "front") {
-                ss >> cameraFront.x >> cameraFront.y >> cameraFront.z;
-            } else if (tag == "up") {
-                ss >> cameraUp.x >> cameraUp.y >> cameraUp.z;
-            } else if (tag == "yaw") {
-                ss >> rotacaoYaw;
-            } else if (tag == "pitch") {
-                ss >> rotaocaoPitch;
+            // Volta para sRGB em 8 bits
+            unsigned char *saida = &nivel.dados[(size_t)y * nw * 4];
+            for (int i = 0; i < nw * 4; i += 4)
+            {
+                saida[i] = linearParaSRGB(destino[i]);
+                saida[i + 1] = linearParaSRGB(destino[i + 1]);
+                saida[i + 2] = linearParaSRGB(destino[i + 2]);
+                saida[i + 3] = (unsigned char)std::lround(std::min(1.0f, std::max(0.0f, destino[i + 3])) * 255.0f);
             }
-        } else if (inLightBlock) { // Lendo propriedades da luz
-            if (tag == "pos") {
-                ss >> lightPos.x >> lightPos.y >> lightPos.z;
+        });
+
+        niveis.push_back(std::move(nivel));
+        atual.swap(proximo);
+        w = nw;
+        h = nh;
+    }
+    return niveis;
+}
+
+
+// Parte de cor dos blocos BC1/BC3: endpoints no eixo principal dos 16 pixels e 2 bits de índice por pixel
+void comprimirCorBloco(const unsigned char *bloco, unsigned char *saida)
+{
+    float media[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            media[c] += bloco[i * 4 + c] / 16.0f;
+
+    float cov[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++)
+    {
+        float r = bloco[i * 4] - media[0], g = bloco[i * 4 + 1] - media[1], b = bloco[i * 4 + 2] - media[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+
+    // Iteração de potência para achar o eixo de maior variação das cores
+    float eixo[3] = {1.0f, 1.0f, 1.0f};
+    for (int it = 0; it < 4; it++)
+    {
+        float x = cov[0] * eixo[0] + cov[1] * eixo[1] + cov[2] * eixo[2];
+        float y = cov[1] * eixo[0] + cov[3] * eixo[1] + cov[4] * eixo[2];
+        float z = cov[2] * eixo[0] + cov[4] * eixo[1] + cov[5] * eixo[2];
+        float maior = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+        if (maior < 1e-6f) break;
+        eixo[0] = x / maior; eixo[1] = y / maior; eixo[2] = z / maior;
+    }
+    float norma = std::sqrt(eixo[0] * eixo[0] + eixo[1] * eixo[1] + eixo[2] * eixo[2]);
+    for (int c = 0; c < 3; c++) eixo[c] /= norma;
+
+    float minProj = 1e9f, maxProj = -1e9f;
+    for (int i = 0; i < 16; i++)
+    {
+        float proj = (bloco[i * 4] - media[0]) * eixo[0] + (bloco[i * 4 + 1] - media[1]) * eixo[1] + (bloco[i * 4 + 2] - media[2]) * eixo[2];
+        minProj = std::min(minProj, proj);
+        maxProj = std::max(maxProj, proj);
+    }
+    // Recuo de 1/16 nos extremos reduz o erro médio da paleta
+    float recuo = (maxProj - minProj) / 16.0f;
+    minProj += recuo;
+    maxProj -= recuo;
+
+    unsigned short endpoint[2];
+    float extremos[2] = {maxProj, minProj};
+    for (int e = 0; e < 2; e++)
+    {
+        int r = (int)std::lround(std::min(255.0f, std::max(0.0f, media[0] + eixo[0] * extremos[e])));
+        int g = (int)std::lround(std::min(255.0f, std::max(0.0f, media[1] + eixo[1] * extremos[e])));
+        int b = (int)std::lround(std::min(255.0f, std::max(0.0f, media[2] + eixo[2] * extremos[e])));
+        endpoint[e] = (unsigned short)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+    }
+    // endpoint0 > endpoint1 garante o modo de 4 cores
+    if (endpoint[0] < endpoint[1]) std::swap(endpoint[0], endpoint[1]);
+
+    unsigned int indices = 0;
+    if (endpoint[0] != endpoint[1])
+    {
+        int paleta[4][3];
+        for (int e = 0; e < 2; e++)
+        {
+            int r = (endpoint[e] >> 11) & 31, g = (endpoint[e] >> 5) & 63, b = endpoint[e] & 31;
+            paleta[e][0] = (r << 3) | (r >> 2);
+            paleta[e][1] = (g << 2) | (g >> 4);
+            paleta[e][2] = (b << 3) | (b >> 2);
+        }
+        for (int c = 0; c < 3; c++)
+        {
+            paleta[2][c] = (2 * paleta[0][c] + paleta[1][c]) / 3;
+            paleta[3][c] = (paleta[0][c] + 2 * paleta[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++)
+        {
+            int melhor = 0, menorErro = 1 << 30;
+            for (int k = 0; k < 4; k++)
+            {
+                int dr = bloco[i * 4] - paleta[k][0], dg = bloco[i * 4 + 1] - paleta[k][1], db = bloco[i * 4 + 2] - paleta[k][2];
+                int erro = dr * dr + dg * dg + db * db;
+                if (erro < menorErro) { menorErro = erro; melhor = k; }
             }
+            indices |= (unsigned int)melhor << (2 * i);
         }
     }
 
-    configFile.close();
-}
\ No newline at end of file
+    saida[0] = endpoint[0] & 0xFF; saida[1] = endpoint[0] >> 8;
+    saida[2] = endpoint[1] & 0xFF; saida[3] = endpoint[1] >> 8;
+    for (int b = 0; b < 4; b++) saida[4 + b] = (indices >> (8 * b)) & 0xFF;
+}
+
+void comprimirBlocoBC1(const unsigned char *bloco, unsigned char *saida)
+{
+    comprimirCorBloco(bloco, saida);
+}
+
+void comprimirBlocoBC3(const unsigned char *bloco, unsigned char *saida)
+{
+    // Bloco de alpha: dois extremos de 8 bits + 3 bits de índice por pixel (modo de 8 valores)
+    int alphaMax = 0, alphaMin = 255;
+    for (int i = 0; i < 16; i++)
+    {
+        alphaMax = std::max(alphaMax, (int)bloco[i * 4 + 3]);
+        alphaMin = std::min(alphaMin, (int)bloco[i * 4 + 3]);
+    }
+
+    uint64_t indices = 0;
+    if (alphaMax > alphaMin)
+    {
+        int paleta[8] = {alphaMax, alphaMin};
+        for (int k = 1; k < 7; k++) paleta[k + 1] = ((7 - k) * alphaMax + k * alphaMin) / 7;
+        for (int i = 0; i < 16; i++)
+        {
+            int melhor = 0, menorErro = 1 << 30;
+            for (int k = 0; k < 8; k++)
+            {
+                int erro = std::abs(bloco[i * 4 + 3] - paleta[k]);
+                if (erro < menorErro) { menorErro = erro; melhor = k; }
+            }
+            indices |= (uint64_t)melhor << (3 * i);
+        }
+    }
+    saida[0] = (unsigned char)alphaMax;
+    saida[1] = (unsigned char)alphaMin;
+    for (int b = 0; b < 6; b++) saida[2 + b] = (indices >> (8 * b)) & 0xFF;
+
+    comprimirCorBloco(bloco, saida + 8);
+}
+
+NivelMip comprimirNivelBC(const NivelMip &nivel, bool comAlpha)
+{
+    int blocosX = (nivel.largura + 3) / 4, blocosY = (nivel.altura + 3) / 4;
+    int bytesBloco = comAlpha ? 16 : 8;
+    NivelMip saida = {nivel.largura, nivel.altura, std::vector<unsigned char>((size_t)blocosX * blocosY * bytesBloco)};
+
+    // Cada thread comprime linhas inteiras de blocos
+    executarEmParalelo(0, blocosY, [&](int by) {
+        unsigned char bloco[64];
+        for (int bx = 0; bx < blocosX; bx++)
+        {
+            // Bordas de imagens que não são múltiplas de 4 repetem o último pixel
+            for (int py = 0; py < 4; py++)
+                for (int px = 0; px < 4; px++)
+                {
+                    int x = std::min(bx * 4 + px, nivel.largura - 1), y = std::min(by * 4 + py, nivel.altura - 1);
+                    memcpy(&bloco[(py * 4 + px) * 4], &nivel.dados[((size_t)y * nivel.largura + x) * 4], 4);
+                }
+            unsigned char *destino = &saida.dados[((size_t)by * blocosX + bx) * bytesBloco];
+            if (comAlpha) comprimirBlocoBC3(bloco, destino);
+            else comprimirBlocoBC1(bloco, destino);
+        }
+    });
+    return saida;
+}
+
+// Cabeçalho DDS: "DDS " + 31 palavras de 32 bits (DDS_HEADER com o DDS_PIXELFORMAT embutido)
+const uint32_t DDS_FOURCC_DXT1 = 0x31545844, DDS_FOURCC_DXT5 = 0x35545844;
+// Guardados em dwReserved1 (palavras 7 e 8): caches de outra versão do gerador ou de outro filtro são ignorados.
+// Subir VERSAO_CACHE_DDS sempre que mudar o que é gravado (mipmaps, compressão)
+const uint32_t VERSAO_CACHE_DDS = 2;
+
+bool cabecalhoDDSAtual(const uint32_t cabecalho[31])
+{
+    return cabecalho[7] == VERSAO_CACHE_DDS && cabecalho[8] == (uint32_t)filtroMipmaps + 1;
+}
+
+bool salvarCacheDDS(const std::string &filePath, const TexturaCache &textura)
+{
+    std::ofstream arq(filePath, std::ios::binary);
+    if (!arq.is_open())
+    {
+        std::cerr << "Erro ao tentar gravar o cache de textura " << filePath << std::endl;
+        return false;
+    }
+
+    uint32_t cabecalho[31] = {0};
+    cabecalho[0] = 124;
+    cabecalho[1] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000; // CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT
+    cabecalho[2] = textura.niveis[0].altura;
+    cabecalho[3] = textura.niveis[0].largura;
+    cabecalho[6] = (uint32_t)textura.niveis.size();
+    cabecalho[7] = VERSAO_CACHE_DDS;
+    cabecalho[8] = (uint32_t)filtroMipmaps + 1;
+    cabecalho[18] = 32; // tamanho do pixel format
+    if (formatoComprimido(textura.formato))
+    {
+        cabecalho[1] |= 0x80000; // LINEARSIZE
+        cabecalho[4] = (uint32_t)textura.niveis[0].dados.size();
+        cabecalho[19] = 0x4; // DDPF_FOURCC
+        cabecalho[20] = textura.formato == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? DDS_FOURCC_DXT1 : DDS_FOURCC_DXT5;
+    }
+    else
+    {
+        // RGBA de 32 bits; sem DDPF_ALPHAPIXELS quando a textura é opaca (GL_RGB8)
+        cabecalho[1] |= 0x8; // PITCH
+        cabecalho[4] = textura.niveis[0].largura * 4;
+        cabecalho[19] = 0x40 | (textura.formato == GL_RGBA8 ? 0x1 : 0x0);
+        cabecalho[21] = 32;
+        cabecalho[22] = 0x000000FF;
+        cabecalho[23] = 0x0000FF00;
+        cabecalho[24] = 0x00FF0000;
+        cabecalho[25] = 0xFF000000;
+    }
+    cabecalho[26] = 0x1000 | 0x400000 | 0x8; // TEXTURE | MIPMAP | COMPLEX
+
+    arq.write("DDS ", 4);
+    arq.write((const char *)cabecalho, sizeof(cabecalho));
+    for (const NivelMip &nivel : textura.niveis)
+    {
+        arq.write((const char *)nivel.dados.data(), nivel.dados.size());
+    }
+    return arq.good();
+}
+
+bool carregarCacheDDS(const std::string &filePath, TexturaCache &textura)
+{
+    std::ifstream arq(filePath, std::ios::binary);
+    char magico[4];
+    uint32_t cabecalho[31];
+    if (!arq.read(magico, 4) || memcmp(magico, "DDS ", 4) != 0 || !arq.read((char *)cabecalho, sizeof(cabecalho)) || !cabecalhoDDSAtual(cabecalho))
+    {
+        return false;
+    }
+
+    int bytesBloco;
+    if ((cabecalho[19] & 0x4) && cabecalho[20] == DDS_FOURCC_DXT1) { textura.formato = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; bytesBloco = 8; }
+    else if ((cabecalho[19] & 0x4) && cabecalho[20] == DDS_FOURCC_DXT5) { textura.formato = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; bytesBloco = 16; }
+    else if ((cabecalho[19] & 0x40) && cabecalho[21] == 32) { textura.formato = (cabecalho[19] & 0x1) ? GL_RGBA8 : GL_RGB8; bytesBloco = 0; }
+    else return false;
+
+    // Um arquivo truncado ou com cabeçalho estragado conta como cache ausente: as dimensões e a quantidade de
+    // níveis têm que ser plausíveis e os níveis têm que ocupar exatamente o resto do arquivo
+    if (cabecalho[3] == 0 || cabecalho[2] == 0 || cabecalho[3] > 16384 || cabecalho[2] > 16384) return false;
+    int largura = cabecalho[3], altura = cabecalho[2];
+    int nNiveis = std::max<int>(1, cabecalho[6]);
+    int maximoNiveis = 1;
+    while ((std::max(largura, altura) >> maximoNiveis) > 0) maximoNiveis++;
+    if (nNiveis > maximoNiveis) return false;
+
+    auto tamanhoDoNivel = [bytesBloco](int w, int h) {
+        return bytesBloco ? (size_t)((w + 3) / 4) * ((h + 3) / 4) * bytesBloco : (size_t)w * h * 4;
+    };
+    size_t esperado = 0;
+    for (int i = 0, w = largura, h = altura; i < nNiveis; i++, w = std::max(1, w / 2), h = std::max(1, h / 2)) esperado += tamanhoDoNivel(w, h);
+    std::streamoff inicioDados = arq.tellg();
+    arq.seekg(0, std::ios::end);
+    std::streamoff tamanhoArquivo = arq.tellg();
+    if (inicioDados < 0 || tamanhoArquivo < 0 || (size_t)(tamanhoArquivo - inicioDados) != esperado) return false;
+    arq.seekg(inicioDados);
+
+    textura.niveis.clear();
+    for (int i = 0; i < nNiveis; i++)
+    {
+        NivelMip nivel = {largura, altura, std::vector<unsigned char>(tamanhoDoNivel(largura, altura))};
+        if (!arq.read((char *)nivel.dados.data(), nivel.dados.size()))
+        {
+            textura.niveis.clear();
+            return false;
+        }
+        textura.niveis.push_back(std::move(nivel));
+        largura = std::max(1, largura / 2);
+        altura = std::max(1, altura / 2);
+    }
+    return true;
+}
+
+bool formatoComprimido(GLenum formato)
+{
+    return formato == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || formato == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+const char *nomeFormato(GLenum formato)
+{
+    switch (formato)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "BC1";
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "BC3";
+    case GL_RGB8: return "RGB8";
+    default: return "RGBA8";
+    }
+}
+
+// Envia todos os níveis para o alvo da textura vinculada (GL_TEXTURE_2D ou uma face do cubemap)
+void enviarNiveisMip(GLenum alvo, const TexturaCache &textura)
+{
+    for (size_t i = 0; i < textura.niveis.size(); i++)
+    {
+        alocarNivelMip(alvo, textura, i);
+        enviarNivelMip(alvo, textura, i);
+    }
+}
+
+// Reserva a memória do nível sem enviar os pixels
+void alocarNivelMip(GLenum alvo, const TexturaCache &textura, int nivel)
+{
+    const NivelMip &mip = textura.niveis[nivel];
+    if (formatoComprimido(textura.formato))
+    {
+        glCompressedTexImage2D(alvo, nivel, textura.formato, mip.largura, mip.altura, 0, mip.dados.size(), nullptr);
+    }
+    else
+    {
+        glTexImage2D(alvo, nivel, textura.formato, mip.largura, mip.altura, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+}
+
+void enviarNivelMip(GLenum alvo, const TexturaCache &textura, int nivel)
+{
+    const NivelMip &mip = textura.niveis[nivel];
+    if (formatoComprimido(textura.formato))
+    {
+        glCompressedTexSubImage2D(alvo, nivel, 0, 0, mip.largura, mip.altura, textura.formato, mip.dados.size(), mip.dados.data());
+    }
+    else
+    {
+        glTexSubImage2D(alvo, nivel, 0, 0, mip.largura, mip.altura, GL_RGBA, GL_UNSIGNED_BYTE, mip.dados.data());
+    }
+    bytesTexturasGPU += mip.dados.size(); // RGB8 também conta 4 bytes por pixel, como os drivers costumam alocar
+}
+
+GLuint uploadTextura2D(const TexturaCache &textura, GLuint texExistente)
+{
+    GLuint texID = texExistente;
+    if (!texID) glGenTextures(1, &texID);
+    glBindTexture(GL_TEXTURE_2D, texID);
+
+    // Filtragem trilinear: os mips gerados na CPU são usados na minificação
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)textura.niveis.size() - 1);
+
+    enviarNiveisMip(GL_TEXTURE_2D, textura);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texID;
+}
+
+GLuint registrarTexturaStreaming(const TexturaCache &textura, GLuint texExistente)
+{
+    texturasStreaming.push_back(criarTexturaStreaming(textura, texExistente));
+    return texturasStreaming.back().texID;
+}
+
+// Parte OpenGL do registro (pode rodar no contexto da thread de carregamento; quem chama adiciona em texturasStreaming)
+TexturaStreaming criarTexturaStreaming(const TexturaCache &textura, GLuint texExistente)
+{
+    TexturaStreaming ts;
+    ts.textura = textura;
+    ts.nivelMinimo = (int)textura.niveis.size() - 1;
+    while (ts.nivelMinimo > 0 && std::max(textura.niveis[ts.nivelMinimo - 1].largura, textura.niveis[ts.nivelMinimo - 1].altura) <= tamanhoInicialStreaming)
+    {
+        ts.nivelMinimo--;
+    }
+    ts.nivelResidente = ts.nivelMinimo;
+    ts.nivelDesejado = ts.nivelMinimo;
+    ts.ultimoUso = frameAtual;
+
+    ts.texID = texExistente;
+    if (!ts.texID) glGenTextures(1, &ts.texID);
+    glBindTexture(GL_TEXTURE_2D, ts.texID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)textura.niveis.size() - 1);
+
+    // Todos os níveis são alocados agora; subir ou descer de nível depois nunca realoca a textura
+    for (int i = 0; i < (int)textura.niveis.size(); i++)
+    {
+        alocarNivelMip(GL_TEXTURE_2D, textura, i);
+        if (i >= ts.nivelResidente) enviarNivelMip(GL_TEXTURE_2D, textura, i);
+    }
+    definirNivelResidente(ts, ts.nivelResidente);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return ts;
+}
+
+// A textura precisa estar vinculada em GL_TEXTURE_2D
+void definirNivelResidente(TexturaStreaming &ts, int nivel)
+{
+    ts.nivelResidente = nivel;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, nivel);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, (float)nivel);
+}
+
+// Inclui o nível que ainda está sendo enviado, para o orçamento já contar com ele
+size_t bytesResidentes(const TexturaStreaming &ts)
+{
+    size_t bytes = 0;
+    for (int i = ts.nivelResidente; i < (int)ts.textura.niveis.size(); i++) bytes += ts.textura.niveis[i].dados.size();
+    if (ts.nivelEmEnvio >= 0) bytes += ts.textura.niveis[ts.nivelEmEnvio].dados.size();
+    return bytes;
+}
+
+size_t bytesResidentesTexturas()
+{
+    size_t total = 0;
+    for (const TexturaStreaming &ts : texturasStreaming) total += bytesResidentes(ts);
+    return total;
+}
+
+// Quantos níveis ainda faltam enviar para atingir o nível desejado de cada textura
+size_t requisicoesPendentesTexturas()
+{
+    size_t pendentes = 0;
+    for (const TexturaStreaming &ts : texturasStreaming) pendentes += std::max(0, ts.nivelResidente - ts.nivelDesejado);
+    return pendentes;
+}
+
+void atualizarStreamingTexturas(const std::vector<Object> &objs, glm::vec3 posCamera, float alturaTelaPixels)
+{
+    if (texturasStreaming.empty()) return;
+    frameAtual++;
+
+    // Nível desejado = log2(tamanho da textura / pixels que o objeto ocupa na tela), o menor entre os objetos que a usam
+    for (TexturaStreaming &ts : texturasStreaming) ts.nivelDesejado = ts.nivelMinimo;
+    float tanMeioFov = std::fabs(std::tan(fov / 2.0f)); // mesmo valor passado para glm::perspective
+    for (const Object &obj : objs)
+    {
+        auto ts = std::find_if(texturasStreaming.begin(), texturasStreaming.end(), [&obj](const TexturaStreaming &t) { return t.texID == obj.texID; });
+        if (ts == texturasStreaming.end()) continue;
+
+        glm::vec3 centro = glm::vec3(obj.model * glm::vec4(obj.centroLocal, 1.0f));
+        float raio = obj.raioLocal * obj.tamanhoEscala;
+        float distancia = glm::length(centro - posCamera);
+        int nivel = 0;
+        if (distancia > raio)
+        {
+            float pixels = std::max(1.0f, raio / (distancia * tanMeioFov) * alturaTelaPixels);
+            float tamanhoTextura = (float)std::max(ts->textura.niveis[0].largura, ts->textura.niveis[0].altura);
+            nivel = std::max(0, (int)std::floor(std::log2(tamanhoTextura / pixels)));
+        }
+        ts->nivelDesejado = std::min(ts->nivelDesejado, nivel);
+        ts->ultimoUso = frameAtual;
+    }
+
+    // Atende algumas requisições por frame, sempre um nível de cada vez (do mais grosso para o mais fino)
+    for (int enviados = 0; enviados < niveisPorFrameStreaming; enviados++)
+    {
+        TexturaStreaming *alvo = nullptr;
+        for (TexturaStreaming &ts : texturasStreaming)
+        {
+            if (ts.nivelResidente > ts.nivelDesejado && ts.nivelEmEnvio < 0 && (!alvo || ts.nivelResidente - ts.nivelDesejado > alvo->nivelResidente - alvo->nivelDesejado))
+            {
+                alvo = &ts;
+            }
+        }
+        if (!alvo) break;
+
+        // Libera espaço no orçamento: primeiro quem tem mais detalhe do que precisa, depois a menos usada recentemente (LRU).
+        // Uma textura usada neste frame que não tem nível sobrando nunca é vítima: senão duas texturas necessárias
+        // trocariam de lugar a cada frame, reenviando os mesmos mips
+        size_t bytesNivel = alvo->textura.niveis[alvo->nivelResidente - 1].dados.size();
+        size_t residentes = bytesResidentesTexturas();
+        while (residentes + bytesNivel > orcamentoTexturas)
+        {
+            TexturaStreaming *vitima = nullptr;
+            for (TexturaStreaming &ts : texturasStreaming)
+            {
+                if (&ts == alvo || ts.nivelResidente >= ts.nivelMinimo || ts.nivelEmEnvio >= 0) continue;
+                bool sobrando = ts.nivelResidente < ts.nivelDesejado;
+                if (!sobrando && ts.ultimoUso >= frameAtual) continue;
+                if (!vitima || (sobrando && vitima->nivelResidente >= vitima->nivelDesejado) ||
+                    (sobrando == (vitima->nivelResidente < vitima->nivelDesejado) && ts.ultimoUso < vitima->ultimoUso))
+                {
+                    vitima = &ts;
+                }
+            }
+            if (!vitima) break;
+
+            residentes -= vitima->textura.niveis[vitima->nivelResidente].dados.size();
+            glBindTexture(GL_TEXTURE_2D, vitima->texID);
+            definirNivelResidente(*vitima, vitima->nivelResidente + 1);
+        }
+        if (residentes + bytesNivel > orcamentoTexturas) break; // orçamento cheio, a requisição fica pendente
+
+        // O nível já está alocado; ele só passa a ser amostrado (BASE_LEVEL) quando a última fatia for enviada
+        agendarUploadNivel(agendadorUploads, *alvo, alvo->nivelResidente - 1);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void iniciarAgendadorUploads(AgendadorUploads &agendador)
+{
+    // Um segmento comporta o orçamento de um frame (mais uma linha de 16K pixels, que é sempre enviada inteira)
+    agendador.tamanhoSegmento = agendador.orcamentoBytes + 16384 * 4;
+    glGenBuffers(1, &agendador.pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, agendador.pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, agendador.tamanhoSegmento * AgendadorUploads::SEGMENTOS, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void encerrarAgendadorUploads(AgendadorUploads &agendador)
+{
+    for (GLsync &fence : agendador.fences)
+    {
+        if (fence) glDeleteSync(fence);
+        fence = 0;
+    }
+    glDeleteBuffers(1, &agendador.pbo);
+    agendador.pbo = 0;
+    agendador.fila.clear();
+}
+
+void agendarUploadNivel(AgendadorUploads &agendador, TexturaStreaming &ts, int nivel)
+{
+    ts.nivelEmEnvio = nivel;
+    GLuint texID = ts.texID;
+    TarefaUpload tarefa;
+    tarefa.texID = texID;
+    tarefa.nivel = nivel;
+    tarefa.aoConcluir = [texID, nivel]() {
+        for (TexturaStreaming &t : texturasStreaming)
+        {
+            if (t.texID != texID || t.nivelEmEnvio != nivel) continue;
+            t.nivelEmEnvio = -1;
+            glBindTexture(GL_TEXTURE_2D, t.texID);
+            definirNivelResidente(t, std::min(t.nivelResidente, nivel));
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+    };
+    agendador.fila.push_back(std::move(tarefa));
+}
+
+void agendarUploadMalha(AgendadorUploads &agendador, GLuint vbo, std::shared_future<MalhaOBJ> malha, std::function<void()> aoConcluir)
+{
+    TarefaUpload tarefa;
+    tarefa.vbo = vbo;
+    tarefa.malha = malha;
+    tarefa.aoConcluir = aoConcluir;
+    agendador.fila.push_back(std::move(tarefa));
+}
+
+bool uploadPendente(const AgendadorUploads &agendador, GLuint vbo)
+{
+    return std::any_of(agendador.fila.begin(), agendador.fila.end(), [vbo](const TarefaUpload &tarefa) { return tarefa.vbo == vbo; });
+}
+
+// Chamada uma vez por frame: envia fatias de linhas (blocos de 4 linhas nos formatos BC) até esgotar o orçamento
+void processarUploads(AgendadorUploads &agendador)
+{
+    agendador.bytesUltimoFrame = 0;
+    agendador.msUltimoFrame = 0.0f;
+    if (agendador.fila.empty()) return;
+
+    // O segmento da vez ainda pode estar sendo lido pela GPU (frames anteriores): nesse caso espera o próximo frame
+    GLsync &fence = agendador.fences[agendador.segmentoAtual];
+    if (fence)
+    {
+        GLenum estado = glClientWaitSync(fence, 0, 0);
+        if (estado != GL_ALREADY_SIGNALED && estado != GL_CONDITION_SATISFIED)
+        {
+            agendador.framesEsperandoGPU++;
+            return;
+        }
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    auto inicio = std::chrono::high_resolution_clock::now();
+    size_t base = agendador.tamanhoSegmento * agendador.segmentoAtual;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, agendador.pbo);
+    unsigned char *destino = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, base, agendador.tamanhoSegmento,
+                                                               GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!destino)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return;
+    }
+
+    // Primeiro copia as fatias para o PBO; as chamadas glTexSubImage2D só podem acontecer depois do unmap
+    struct Fatia { GLuint texID; GLenum formato; int nivel, largura, y, altura; size_t offset, bytes; GLuint vbo; size_t destino; };
+    std::vector<Fatia> fatias;
+    std::vector<std::function<void()>> concluidas;
+    size_t usado = 0;
+    while (!agendador.fila.empty())
+    {
+        TarefaUpload &tarefa = agendador.fila.front();
+        size_t disponivel = std::min(agendador.orcamentoBytes > usado ? agendador.orcamentoBytes - usado : 0, agendador.tamanhoSegmento - usado);
+        if (tarefa.vbo)
+        {
+            // Vértices: fatias de bytes copiadas do PBO para o VBO com glCopyBufferSubData
+            const std::vector<GLfloat> &vertices = tarefa.malha.get().vBuffer;
+            size_t bytes = std::min(vertices.size() * sizeof(GLfloat) - tarefa.bytesEnviados, disponivel);
+            if (bytes == 0 && tarefa.bytesEnviados < vertices.size() * sizeof(GLfloat)) break;
+            memcpy(destino + usado, (const unsigned char *)vertices.data() + tarefa.bytesEnviados, bytes);
+            fatias.push_back({0, 0, 0, 0, 0, 0, base + usado, bytes, tarefa.vbo, tarefa.bytesEnviados});
+            usado = (usado + bytes + 15) & ~(size_t)15;
+            tarefa.bytesEnviados += bytes;
+            if (tarefa.bytesEnviados >= vertices.size() * sizeof(GLfloat))
+            {
+                concluidas.push_back(std::move(tarefa.aoConcluir));
+                agendador.fila.pop_front();
+            }
+            float us = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - inicio).count();
+            if (us >= agendador.orcamentoMicrossegundos || usado >= agendador.orcamentoBytes) break;
+            continue;
+        }
+        auto ts = std::find_if(texturasStreaming.begin(), texturasStreaming.end(), [&tarefa](const TexturaStreaming &t) { return t.texID == tarefa.texID; });
+        if (ts == texturasStreaming.end())
+        {
+            agendador.fila.pop_front(); // textura foi substituída
+            continue;
+        }
+        const NivelMip &mip = ts->textura.niveis[tarefa.nivel];
+        bool comprimido = formatoComprimido(ts->textura.formato);
+        int linhasPorUnidade = comprimido ? 4 : 1;
+        size_t bytesPorUnidade = comprimido ? (size_t)((mip.largura + 3) / 4) * (ts->textura.formato == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16) : (size_t)mip.largura * 4;
+        int unidadesRestantes = (mip.altura - tarefa.linhasEnviadas + linhasPorUnidade - 1) / linhasPorUnidade;
+        int unidades = std::min(unidadesRestantes, (int)(disponivel / bytesPorUnidade));
+        if (unidades == 0 && usado == 0) unidades = 1; // linha maior que o orçamento: envia uma mesmo assim para não travar a fila
+        if (unidades == 0) break;
+
+        size_t origem = (size_t)(tarefa.linhasEnviadas / linhasPorUnidade) * bytesPorUnidade;
+        size_t bytes = std::min((size_t)unidades * bytesPorUnidade, mip.dados.size() - origem);
+        memcpy(destino + usado, mip.dados.data() + origem, bytes);
+        int altura = std::min(unidades * linhasPorUnidade, mip.altura - tarefa.linhasEnviadas);
+        fatias.push_back({tarefa.texID, ts->textura.formato, tarefa.nivel, mip.largura, tarefa.linhasEnviadas, altura, base + usado, bytes, 0, 0});
+        usado = (usado + bytes + 15) & ~(size_t)15; // mantém os offsets alinhados
+        tarefa.linhasEnviadas += altura;
+
+        if (tarefa.linhasEnviadas >= mip.altura)
+        {
+            concluidas.push_back(std::move(tarefa.aoConcluir));
+            agendador.fila.pop_front();
+        }
+        float us = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - inicio).count();
+        if (us >= agendador.orcamentoMicrossegundos || usado >= agendador.orcamentoBytes) break;
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    for (const Fatia &fatia : fatias)
+    {
+        agendador.bytesUltimoFrame += fatia.bytes;
+        if (fatia.vbo)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, agendador.pbo);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, fatia.vbo);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, fatia.offset, fatia.destino, fatia.bytes);
+            continue;
+        }
+        glBindTexture(GL_TEXTURE_2D, fatia.texID);
+        if (formatoComprimido(fatia.formato))
+        {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, fatia.nivel, 0, fatia.y, fatia.largura, fatia.altura, fatia.formato, fatia.bytes, (const void *)fatia.offset);
+        }
+        else
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, fatia.nivel, 0, fatia.y, fatia.largura, fatia.altura, GL_RGBA, GL_UNSIGNED_BYTE, (const void *)fatia.offset);
+        }
+        bytesTexturasGPU += fatia.bytes;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    for (auto &aoConcluir : concluidas) aoConcluir();
+
+    if (!fatias.empty())
+    {
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        agendador.segmentoAtual = (agendador.segmentoAtual + 1) % AgendadorUploads::SEGMENTOS;
+    }
+    agendador.msUltimoFrame = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - inicio).count();
+    agendador.msMaximo = std::max(agendador.msMaximo, agendador.msUltimoFrame);
+}
+
+int loadSimpleOBJ(string filePATH, int &nVertices, string &nomeMtl, glm::vec3 &centro, float &raio)
+{
+    MalhaOBJ malha = lerArquivoOBJ(filePATH, false);
+    if (!malha.valida)
+    {
+        return -1;
+    }
+    materiais[malha.nomeMaterial] = malha.material;
+    nomeMaterial = malha.nomeMaterial;
+    nVertices = malha.nVertices;
+    nomeMtl = malha.nomeMaterial;
+    centro = malha.centro;
+    raio = malha.raio;
+    return criarVAOdoOBJ(enviarMalhaParaVBO(malha));
+}
+
+// Lê o OBJ/MTL sem usar a OpenGL (pode rodar em qualquer thread); o envio para o VBO é feito depois em enviarMalhaParaVBO
+MalhaOBJ lerArquivoOBJ(const std::string &filePATH, bool requisitarTexturaDoMaterial)
+{
+    auto inicio = std::chrono::high_resolution_clock::now();
+    MalhaOBJ malha;
+    malha.caminho = filePATH;
+    std::string nomeArquivoMtl;
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+    std::vector<GLfloat> &vBuffer = malha.vBuffer;
+    glm::vec3 color = glm::vec3(1.0, 1.0, 1.0);
+
+    std::ifstream arqEntrada(filePATH.c_str());
+    if (!arqEntrada.is_open()) 
+	{
+        std::cerr << "Erro ao tentar ler o arquivo " << filePATH << std::endl;
+        return malha;
+    }
+
+    std::string line;
+    while (std::getline(arqEntrada, line)) 
+	{
+        std::istringstream ssline(line);
+        std::string word;
+        ssline >> word;
+
+        if (word == "mtllib") 
+		{
+            ssline >> nomeArquivoMtl;
+        } 
+        if (word == "v") 
+		{
+            glm::vec3 vertice;
+            ssline >> vertice.x >> vertice.y >> vertice.z;
+            vertices.push_back(vertice);
+        } 
+        else if (word == "vt") 
+		{
+            glm::vec2 vt;
+            ssline >> vt.s >> vt.t;
+            texCoords.push_back(vt);
+        } 
+        else if (word == "vn") 
+		{
+            glm::vec3 normal;
+            ssline >> normal.x >> normal.y >> normal.z;
+            normals.push_back(normal);
+        } 
+        else if (word == "f")
+		 {
+            while (ssline >> word) 
+			{
+                int vi = 0, ti = 0, ni = 0;
+                std::istringstream ss(word);
+                std::string index;
+
+                if (std::getline(ss, index, '/')) vi = !index.empty() ? std::stoi(index) - 1 : 0;
+                if (std::getline(ss, index, '/')) ti = !index.empty() ? std::stoi(index) - 1 : 0;
+                if (std::getline(ss, index)) ni = !index.empty() ? std::stoi(index) - 1 : 0;
+
+                vBuffer.push_back(vertices[vi].x);
+                vBuffer.push_back(vertices[vi].y);
+                vBuffer.push_back(vertices[vi].z);
+                vBuffer.push_back(color.r);
+                vBuffer.push_back(color.g);
+                vBuffer.push_back(color.b);
+
+                if (ti >= 0 && ti < texCoords.size()) {
+                    vBuffer.push_back(texCoords[ti].x);
+                    vBuffer.push_back(texCoords[ti].y);
+                } else {
+                    vBuffer.push_back(0.0f);
+                    vBuffer.push_back(0.0f);
+                }
+                
+                // Adicionando normais (nx, ny, nz)
+                if (ni >= 0 && ni < normals.size()) {
+                    vBuffer.push_back(normals[ni].x);
+                    vBuffer.push_back(normals[ni].y);
+                    vBuffer.push_back(normals[ni].z);
+                } else {
+                    vBuffer.push_back(0.0f);
+                    vBuffer.push_back(0.0f);
+                    vBuffer.push_back(0.0f);
+                }
+            }
+        }
+    }
+
+    arqEntrada.close();
+
+    // Materiais deste arquivo (a tabela global materiais é atualizada na thread principal)
+    std::unordered_map<std::string, Material> materiais;
+    std::string nomeMaterial;
+    if (!nomeArquivoMtl.empty()) {
+        std::string diretorioObj = filePATH.substr(0, filePATH.find_last_of("/\\") + 1);
+        std::string caminhoMTL = diretorioObj + nomeArquivoMtl;
+        std::ifstream arqMTL(caminhoMTL.c_str());
+        if (arqMTL.is_open()) {
+            std::string mtlLine;
+            while (std::getline(arqMTL, mtlLine)) {
+                std::istringstream ssmtl(mtlLine);
+                std::string mtlWord;
+                ssmtl >> mtlWord;
+
+                if (mtlWord == "newmtl") {
+                    ssmtl >> nomeMaterial;
+                    materiais[nomeMaterial] = Material();
+                }
+
+                if (mtlWord == "Ka") {
+                    ssmtl >> materiais[nomeMaterial].ka.r >> materiais[nomeMaterial].ka.g >> materiais[nomeMaterial].ka.b;
+                }
+
+                if (mtlWord == "Kd") {
+                    ssmtl >> materiais[nomeMaterial].kd.r >> materiais[nomeMaterial].kd.g >> materiais[nomeMaterial].kd.b;
+                }
+
+                if (mtlWord == "Ks") {
+                    ssmtl >> materiais[nomeMaterial].ks.r >> materiais[nomeMaterial].ks.g >> materiais[nomeMaterial].ks.b;
+                }
+
+                if (mtlWord == "map_Kd") {
+                    ssmtl >> materiais[nomeMaterial].textureFile;
+                }
+            }
+            arqMTL.close();
+        }
+    }   
+
+	malha.nVertices = vBuffer.size() / 11;  // x, y, z, r, g, b, s, t, nx, ny, nz (valores atualmente armazenados por vértice)
+
+    // Esfera envolvente no espaço do modelo (usada para estimar o tamanho do objeto na tela)
+    glm::vec3 minimo(1e30f), maximo(-1e30f);
+    for (const glm::vec3 &v : vertices)
+    {
+        minimo = glm::min(minimo, v);
+        maximo = glm::max(maximo, v);
+    }
+    malha.centro = vertices.empty() ? glm::vec3(0.0f) : (minimo + maximo) * 0.5f;
+    for (const glm::vec3 &v : vertices)
+    {
+        malha.raio = std::max(malha.raio, glm::length(v - malha.centro));
+    }
+    malha.nomeMaterial = nomeMaterial;
+    malha.material = materiais[nomeMaterial];
+    malha.valida = true;
+    if (malhasProgressivas && malha.nVertices / 3 > limiarMalhaProgressiva)
+    {
+        malha.vBufferProvisorio = simplificarPorAgrupamento(vBuffer, minimo, maximo, resolucaoMalhaProvisoria);
+    }
+    malha.bvh = construirBVHMalha(vBuffer);
+    malha.oclusor = construirOclusor(vBuffer);
+
+    // A textura começa a ser preparada já, enquanto os outros OBJs ainda estão sendo lidos
+    if (requisitarTexturaDoMaterial)
+    {
+        malha.textura = criarRequisicaoTextura("../assets/Modelos3D/" + malha.material.textureFile);
+    }
+    malha.msCPU = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - inicio).count();
+    return malha;
+}
+
+GLuint enviarMalhaParaVBO(const MalhaOBJ &malha)
+{
+    std::cout << "Gerando o buffer de geometria..." << std::endl;
+    GLuint VBO;
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, malha.vBuffer.size() * sizeof(GLfloat), malha.vBuffer.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+	cout << "nVertices: " << malha.nVertices << " (" << malha.caminho << ", lido em " << malha.msCPU << " ms)" << endl;
+    return VBO;
+}
+
+// Agrupamento de vértices: cada célula de uma grade sobre a caixa envolvente vira um vértice (média das posições,
+// coordenadas de textura e normais) e os triângulos que caem em menos de três células diferentes são descartados
+std::vector<GLfloat> simplificarPorAgrupamento(const std::vector<GLfloat> &vBuffer, glm::vec3 minimo, glm::vec3 maximo, int resolucao)
+{
+    const int componentes = 11;
+    glm::vec3 tamanho = maximo - minimo;
+    float tamanhoCelula = std::max(std::max(tamanho.x, tamanho.y), std::max(tamanho.z, 1e-6f)) / resolucao;
+    auto celulaDoVertice = [&](size_t v) {
+        glm::vec3 c = glm::clamp((glm::vec3(vBuffer[v * componentes], vBuffer[v * componentes + 1], vBuffer[v * componentes + 2]) - minimo) / tamanhoCelula,
+                                 glm::vec3(0.0f), glm::vec3((float)resolucao));
+        return (uint32_t)(((int)c.z * (resolucao + 1) + (int)c.y) * (resolucao + 1) + (int)c.x);
+    };
+
+    // Soma dos atributos de cada célula ocupada
+    size_t nVertices = vBuffer.size() / componentes;
+    std::unordered_map<uint32_t, uint32_t> indiceDaCelula;
+    std::vector<std::vector<float>> somas;
+    std::vector<uint32_t> celulas(nVertices);
+    for (size_t v = 0; v < nVertices; v++)
+    {
+        auto inserida = indiceDaCelula.emplace(celulaDoVertice(v), (uint32_t)somas.size());
+        if (inserida.second) somas.push_back(std::vector<float>(componentes + 1, 0.0f));
+        std::vector<float> &soma = somas[inserida.first->second];
+        for (int k = 0; k < componentes; k++) soma[k] += vBuffer[v * componentes + k];
+        soma[componentes] += 1.0f;
+        celulas[v] = inserida.first->second;
+    }
+    for (std::vector<float> &soma : somas)
+    {
+        for (int k = 0; k < componentes; k++) soma[k] /= soma[componentes];
+        glm::vec3 normal(soma[8], soma[9], soma[10]);
+        if (glm::length(normal) > 1e-6f) normal = glm::normalize(normal);
+        soma[8] = normal.x; soma[9] = normal.y; soma[10] = normal.z;
+    }
+
+    // Triângulos que sobrevivem, sem repetir o mesmo trio de células
+    std::vector<GLfloat> resultado;
+    std::unordered_map<uint64_t, bool> trios;
+    for (size_t t = 0; t + 2 < nVertices; t += 3)
+    {
+        uint32_t a = celulas[t], b = celulas[t + 1], c = celulas[t + 2];
+        if (a == b || b == c || a == c) continue;
+        uint32_t ordenados[3] = {a, b, c};
+        std::sort(ordenados, ordenados + 3);
+        uint64_t chave = ((uint64_t)ordenados[0] << 42) | ((uint64_t)ordenados[1] << 21) | ordenados[2];
+        if (!trios.emplace(chave, true).second) continue;
+        for (uint32_t celula : {a, b, c})
+        {
+            resultado.insert(resultado.end(), somas[celula].begin(), somas[celula].begin() + componentes);
+        }
+    }
+    return resultado;
+}
+
+// Só as posições dos triângulos, juntas para a projeção percorrer a memória em sequência. A malha não é simplificada:
+// os OBJs da cena não são fechados (não dá para saber o que fica dentro deles), e qualquer simplificação que saia da
+// superfície esconderia objetos que estão visíveis. Malhas acima de `limiteTriangulosOclusor` não viram oclusor
+std::shared_ptr<const std::vector<glm::vec3>> construirOclusor(const std::vector<GLfloat> &vBuffer)
+{
+    auto oclusor = std::make_shared<std::vector<glm::vec3>>();
+    if (vBuffer.size() / 33 > (size_t)limiteTriangulosOclusor) return oclusor;
+    oclusor->reserve(vBuffer.size() / 11);
+    for (size_t v = 0; v + 10 < vBuffer.size(); v += 11) oclusor->push_back(glm::vec3(vBuffer[v], vBuffer[v + 1], vBuffer[v + 2]));
+    return oclusor;
+}
+
+// Malhas pequenas vão inteiras; nas progressivas só a versão simplificada é enviada agora e o VBO completo fica
+// alocado (sem dados) esperando os lotes do agendador de uploads. Pode rodar no contexto da thread de carregamento
+BuffersMalha enviarMalha(const MalhaOBJ &malha)
+{
+    BuffersMalha buffers;
+    if (malha.vBufferProvisorio.empty())
+    {
+        buffers.VBO = enviarMalhaParaVBO(malha);
+        return buffers;
+    }
+    glGenBuffers(1, &buffers.VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.VBO);
+    glBufferData(GL_ARRAY_BUFFER, malha.vBuffer.size() * sizeof(GLfloat), nullptr, GL_STATIC_DRAW);
+    glGenBuffers(1, &buffers.VBOProvisorio);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.VBOProvisorio);
+    glBufferData(GL_ARRAY_BUFFER, malha.vBufferProvisorio.size() * sizeof(GLfloat), malha.vBufferProvisorio.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    buffers.nVerticesProvisorio = (int)(malha.vBufferProvisorio.size() / 11);
+    return buffers;
+}
+
+// Thread principal: liga o objeto à malha simplificada e, no primeiro objeto com esta malha, agenda o envio da completa
+void usarMalhaProgressiva(Object &obj, const BuffersMalha &buffers, int nVerticesProvisorio, std::shared_future<MalhaOBJ> malha, bool iniciarRefinamento)
+{
+    obj.VBO = buffers.VBO;
+    if (!buffers.VBOProvisorio || (!iniciarRefinamento && !uploadPendente(agendadorUploads, buffers.VBO)))
+    {
+        return; // malha pequena, ou o refinamento já terminou
+    }
+    obj.VAOProvisorio = criarVAOdoOBJ(buffers.VBOProvisorio);
+    obj.VBOProvisorio = buffers.VBOProvisorio;
+    obj.nVerticesProvisorio = nVerticesProvisorio;
+    if (!iniciarRefinamento)
+    {
+        return;
+    }
+
+    GLuint VBO = buffers.VBO, VBOProvisorio = buffers.VBOProvisorio;
+    agendarUploadMalha(agendadorUploads, VBO, malha, [VBO, VBOProvisorio]() {
+        for (Object &o : objs)
+        {
+            if (o.VBO != VBO || !o.VAOProvisorio) continue;
+            glDeleteVertexArrays(1, &o.VAOProvisorio);
+            o.VAOProvisorio = 0;
+            o.VBOProvisorio = 0;
+        }
+        GLuint provisorio = VBOProvisorio; // compartilhado por todos os objetos com esta malha
+        glDeleteBuffers(1, &provisorio);
+    });
+}
+
+// Lê no pool se ainda não foi pedido; só a thread dona do mapa pode chamar
+std::shared_future<MalhaOBJ> requisitarMalha(std::unordered_map<std::string, std::shared_future<MalhaOBJ>> &requisitadas, const std::string &filePATH)
+{
+    auto requisitada = requisitadas.find(filePATH);
+    if (requisitada != requisitadas.end())
+    {
+        return requisitada->second;
+    }
+    return requisitadas[filePATH] = agendarCarregamento([filePATH]() {
+        return lerArquivoOBJ(filePATH, true);
+    });
+}
+
+
+
+// Precisa rodar no contexto que vai desenhar o objeto
+GLuint criarVAOdoOBJ(GLuint VBO)
+{
+    GLuint VAO;
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+	GLsizei stride = 11 * sizeof(GLfloat);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);                    // posição
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(3 * sizeof(GLfloat))); // cor
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(6 * sizeof(GLfloat))); // texcoord
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(8 * sizeof(GLfloat))); // normal
+
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	glEnableVertexAttribArray(3);
+
+    
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    return VAO;
+}
+
+GLuint loadCubemap(vector<std::string> faces)
+{
+    // Cada face (decodificação + mipmaps) é preparada no pool; aqui só acontece o upload, na ordem das faces
+    bool comprimir = usarTexturasComprimidas && suportaCompressaoS3TC();
+    bool provisorio = carregamentoParalelo && texturasProvisorias;
+    std::vector<std::shared_future<TexturaPreparada>> preparacoes, provisorias;
+    for (const std::string &face : faces) provisorio = provisorio && !cacheDeTexturaValido(face, comprimir);
+    if (provisorio)
+    {
+        // As faces 1/8 entram na fila antes das completas, senão esperariam a decodificação e os mipmaps delas
+        for (const std::string &face : faces)
+        {
+            provisorias.push_back(agendarCarregamento([face]() { return prepararTexturaProvisoria(face, false); }));
+        }
+    }
+    for (const std::string &face : faces)
+    {
+        auto preparar = [face, comprimir]() { return prepararTextura(face, comprimir, false); };
+        preparacoes.push_back(agendarCarregamento(preparar));
+    }
+
+    // Sem cache, o skybox começa com as faces 1/8 e a versão completa entra depois em processarTrocasDeTexturas
+    std::vector<TexturaPreparada> enviar;
+    for (const auto &parte : provisorio ? provisorias : preparacoes) enviar.push_back(parte.get());
+    for (const TexturaPreparada &face : enviar) provisorio = provisorio && !face.textura.niveis.empty();
+    if (!provisorio && !provisorias.empty())
+    {
+        enviar.clear(); // alguma face não é JPEG baseline: espera a versão completa
+        for (const auto &parte : preparacoes) enviar.push_back(parte.get());
+    }
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    enviarFacesCubemap(textureID, enviar);
+    if (provisorio)
+    {
+        trocasDeTexturas.push_back({textureID, GL_TEXTURE_CUBE_MAP, preparacoes});
+    }
+    return textureID;
+}
+
+void enviarFacesCubemap(GLuint texID, const std::vector<TexturaPreparada> &faces)
+{
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texID);
+
+    GLint ultimoNivel = 0;
+    for (GLuint i = 0; i < faces.size(); i++)
+    {
+        if (!faces[i].textura.niveis.empty())
+        {
+            enviarNiveisMip(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, faces[i].textura);
+            ultimoNivel = (GLint)faces[i].textura.niveis.size() - 1;
+        }
+        else
+        {
+            std::cout << "Erro ao tentar ler o cubemap do arquivo: " << faces[i].caminho << std::endl;
+        }
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, ultimoNivel);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE); // GL_TEXTURE_WRAP_R é para texturas 3D/cubemaps
+}
+
+void initializeCatmullRomMatrix(glm::mat4 &matrix)
+{
+    // matrix[0] = glm::vec4(-1.0f, 3.0f, -3.0f, 1.0f);
+    // matrix[1] = glm::vec4(2.0f, -5.0f, 4.0f, -1.0f);
+    // matrix[2] = glm::vec4(-1.0f, 0.0f, 1.0f, 0.0f);
+    // matrix[3] = glm::vec4(0.0f, 2.0f, 0.0f, 0.0f);
+
+    matrix[0] = glm::vec4(-0.5f, 1.5f, -1.5f, 0.5f); // Primeira linha
+    matrix[1] = glm::vec4(1.0f, -2.5f, 2.0f, -0.5f); // Segunda linha
+    matrix[2] = glm::vec4(-0.5f, 0.0f, 0.5f, 0.0f);  // Terceira linha
+    matrix[3] = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);   // Quarta linha
+}
+
+void generateCatmullRomCurvePoints(Curve &curve, int numPoints)
+{
+    initializeCatmullRomMatrix(curve.M);
+    calcularCoeficientesCurva(curve);
+    construirBVHCurva(curve);
+    if (curve.toleranciaPlanicidade > 0.0f)
+    {
+        tesselarCurvaAdaptativa(curve);
+    }
+    else
+    {
+        tesselarCurva(curve, numPoints, curve.curvePoints);
+        int segmentos = segmentosDaCurva(curve);
+        curve.capacidadePorSegmento = numPoints + 1;
+        curve.inicioDosTrechos.resize(segmentos);
+        curve.pontosDosTrechos.assign(segmentos, numPoints + 1);
+        for (int i = 0; i < segmentos; i++) curve.inicioDosTrechos[i] = i * (numPoints + 1);
+    }
+    construirTabelaComprimento(curve);
+}
+
+int segmentosDaCurva(const Curve &curve)
+{
+    return std::max(0, (int)curve.controlPoints.size() - 3);
+}
+
+// G * M de todos os segmentos (em paralelo: caminhos com milhões de pontos de controle)
+void calcularCoeficientesCurva(Curve &curve)
+{
+    int segmentos = segmentosDaCurva(curve);
+    curve.coeficientes.resize(segmentos);
+    executarEmParalelo(0, segmentos, [&curve](int i) {
+        glm::mat4x3 G(curve.controlPoints[i], curve.controlPoints[i + 1], curve.controlPoints[i + 2], curve.controlPoints[i + 3]);
+        glm::mat4x3 GM = G * curve.M;
+        curve.coeficientes[i] = {GM[0], GM[1], GM[2], GM[3]};
+    }, 4096);
+}
+
+// Escreve os numPoints + 1 pontos de t = 0 a t = 1 do segmento. Com SSE2 são 4 valores de t por vez,
+// cada eixo avaliado por Horner ((a t + b) t + c) t + d: sem acumular erro como nas diferenças progressivas
+void tesselarSegmento(const CoeficientesSegmento &coef, int numPoints, glm::vec3 *saida)
+{
+    float piece = 1.0f / (float)numPoints;
+    int j = 0;
+#ifdef MIPMAP_SSE2
+    __m128 eixoA[3], eixoB[3], eixoC[3], eixoD[3];
+    for (int e = 0; e < 3; e++)
+    {
+        eixoA[e] = _mm_set1_ps(coef.a[e]);
+        eixoB[e] = _mm_set1_ps(coef.b[e]);
+        eixoC[e] = _mm_set1_ps(coef.c[e]);
+        eixoD[e] = _mm_set1_ps(coef.d[e]);
+    }
+    __m128 deslocamentos = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    __m128 pieces = _mm_set1_ps(piece);
+    alignas(16) float valores[3][4];
+    for (; j + 3 <= numPoints; j += 4)
+    {
+        __m128 t = _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)j), deslocamentos), pieces); // mesmo t do laço escalar
+        for (int e = 0; e < 3; e++)
+        {
+            __m128 v = _mm_add_ps(_mm_mul_ps(eixoA[e], t), eixoB[e]);
+            v = _mm_add_ps(_mm_mul_ps(v, t), eixoC[e]);
+            v = _mm_add_ps(_mm_mul_ps(v, t), eixoD[e]);
+            _mm_store_ps(valores[e], v);
+        }
+        for (int k = 0; k < 4; k++) saida[j + k] = glm::vec3(valores[0][k], valores[1][k], valores[2][k]);
+    }
+#endif
+    for (; j <= numPoints; j++)
+    {
+        float t1 = j * piece;
+        saida[j] = ((coef.a * t1 + coef.b) * t1 + coef.c) * t1 + coef.d;
+    }
+}
+
+// Cada segmento escreve a sua faixa da saída (já no tamanho final), então os segmentos são divididos entre as threads
+void tesselarCurva(const Curve &curve, int numPoints, std::vector<glm::vec3> &saida)
+{
+    int segmentos = segmentosDaCurva(curve);
+    saida.resize((size_t)segmentos * (numPoints + 1));
+    executarEmParalelo(0, segmentos, [&](int i) {
+        tesselarSegmento(curve.coeficientes[i], numPoints, &saida[(size_t)i * (numPoints + 1)]);
+    }, std::max(1, 4096 / (numPoints + 1)));
+}
+
+inline glm::vec3 avaliarSegmento(const CoeficientesSegmento &coef, float t)
+{
+    return ((coef.a * t + coef.b) * t + coef.c) * t + coef.d;
+}
+
+// Divide [t0, t1] ao meio enquanto o ponto do meio se afastar da corda p0-p1 mais que a tolerância.
+// Os dois primeiros níveis sempre dividem, senão um trecho em S (meio em cima da corda) passaria direto.
+// Escreve o início de cada trecho final; o fim fica para o trecho seguinte
+void subdividirSegmento(const CoeficientesSegmento &coef, float t0, glm::vec3 p0, float t1, glm::vec3 p1, float tolerancia, int profundidade, int profundidadeMaxima, std::vector<glm::vec3> &saida)
+{
+    float tm = 0.5f * (t0 + t1);
+    glm::vec3 pm = avaliarSegmento(coef, tm);
+    glm::vec3 corda = p1 - p0;
+    float comprimento2 = glm::dot(corda, corda);
+    glm::vec3 relativo = pm - p0;
+    float desvio = comprimento2 > 0.0f ? glm::length(relativo - corda * (glm::dot(relativo, corda) / comprimento2)) : glm::length(relativo);
+    if (profundidade < profundidadeMaxima && (profundidade < 2 || desvio > tolerancia))
+    {
+        subdividirSegmento(coef, t0, p0, tm, pm, tolerancia, profundidade + 1, profundidadeMaxima, saida);
+        subdividirSegmento(coef, tm, pm, t1, p1, tolerancia, profundidade + 1, profundidadeMaxima, saida);
+        return;
+    }
+    saida.push_back(p0);
+}
+
+// Tesselação pela tolerância da curva: trechos retos ficam com poucos pontos e curvas fechadas com muitos.
+// Os segmentos são subdivididos em paralelo; a faixa de cada um em curvePoints tem o tamanho do maior
+// com folga de um nível, para que uma edição quase sempre caiba sem mover os outros segmentos
+void tesselarCurvaAdaptativa(Curve &curve)
+{
+    int segmentos = segmentosDaCurva(curve);
+    curve.curvePoints.clear();
+    curve.inicioDosTrechos.clear();
+    curve.pontosDosTrechos.clear();
+    if (segmentos <= 0) return;
+
+    std::vector<std::vector<glm::vec3>> pontosPorSegmento(segmentos);
+    executarEmParalelo(0, segmentos, [&](int i) {
+        const CoeficientesSegmento &coef = curve.coeficientes[i];
+        subdividirSegmento(coef, 0.0f, avaliarSegmento(coef, 0.0f), 1.0f, avaliarSegmento(coef, 1.0f), curve.toleranciaPlanicidade, 0, 16, pontosPorSegmento[i]);
+    }, 64);
+
+    size_t maior = 1;
+    for (const std::vector<glm::vec3> &pontos : pontosPorSegmento) maior = std::max(maior, pontos.size());
+    curve.profundidadeMaxima = 2;
+    while ((1u << curve.profundidadeMaxima) < maior) curve.profundidadeMaxima++;
+    curve.profundidadeMaxima = std::min(curve.profundidadeMaxima + 1, 16);
+    curve.capacidadePorSegmento = (1 << curve.profundidadeMaxima) + 1;
+
+    curve.curvePoints.resize((size_t)segmentos * curve.capacidadePorSegmento);
+    curve.inicioDosTrechos.resize(segmentos);
+    curve.pontosDosTrechos.resize(segmentos);
+    executarEmParalelo(0, segmentos, [&](int i) {
+        std::vector<glm::vec3> &pontos = pontosPorSegmento[i];
+        pontos.push_back(avaliarSegmento(curve.coeficientes[i], 1.0f));
+        std::copy(pontos.begin(), pontos.end(), curve.curvePoints.begin() + (size_t)i * curve.capacidadePorSegmento);
+        curve.inicioDosTrechos[i] = i * curve.capacidadePorSegmento;
+        curve.pontosDosTrechos[i] = (GLsizei)pontos.size();
+    }, 256);
+}
+
+// Refaz a faixa de um segmento depois de uma edição (a profundidade fica limitada ao que cabe na faixa)
+void tesselarTrechoAdaptativo(Curve &curve, int segmento)
+{
+    const CoeficientesSegmento &coef = curve.coeficientes[segmento];
+    std::vector<glm::vec3> pontos;
+    subdividirSegmento(coef, 0.0f, avaliarSegmento(coef, 0.0f), 1.0f, avaliarSegmento(coef, 1.0f), curve.toleranciaPlanicidade, 0, curve.profundidadeMaxima, pontos);
+    pontos.push_back(avaliarSegmento(coef, 1.0f));
+    std::copy(pontos.begin(), pontos.end(), curve.curvePoints.begin() + (size_t)segmento * curve.capacidadePorSegmento);
+    curve.pontosDosTrechos[segmento] = (GLsizei)pontos.size();
+}
+
+// Ponto da curva no parâmetro u = segmento + t (0 <= u < segmentosDaCurva)
+glm::vec3 avaliarCurva(const Curve &curve, float u)
+{
+    int i = glm::clamp((int)u, 0, segmentosDaCurva(curve) - 1);
+    return avaliarSegmento(curve.coeficientes[i], u - i);
+}
+
+// Derivada de avaliarCurva em relação a u (a tangente, sem normalizar)
+glm::vec3 derivadaCurva(const Curve &curve, float u)
+{
+    int i = glm::clamp((int)u, 0, segmentosDaCurva(curve) - 1);
+    float t = u - i;
+    const CoeficientesSegmento &coef = curve.coeficientes[i];
+    return (3.0f * coef.a * t + 2.0f * coef.b) * t + coef.c;
+}
+
+// Orientação na curva no parâmetro u: slerp entre as duas amostras vizinhas da tabela de referenciais
+glm::quat orientacaoNaCurva(const Curve &curve, float u)
+{
+    int segmentos = segmentosDaCurva(curve);
+    if (segmentos <= 0 || curve.orientacoesArco.empty()) return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    float x = glm::clamp(u, 0.0f, (float)segmentos) * AMOSTRAS_ARCO;
+    int amostra = std::min((int)x, segmentos * AMOSTRAS_ARCO - 1);
+    const glm::quat *q = &curve.orientacoesArco[(size_t)(amostra / AMOSTRAS_ARCO) * (AMOSTRAS_ARCO + 1) + amostra % AMOSTRAS_ARCO];
+    return glm::slerp(q[0], q[1], x - amostra);
+}
+
+// Gauss-Legendre de 5 pontos de |C'(u)| em [u0, u1], sem subdivisão
+float comprimentoGaussLegendre(const Curve &curve, float u0, float u1)
+{
+    static const float nos[5] = {0.0f, -0.5384693101f, 0.5384693101f, -0.9061798459f, 0.9061798459f};
+    static const float pesos[5] = {0.5688888889f, 0.4786286705f, 0.4786286705f, 0.2369268851f, 0.2369268851f};
+    float meio = 0.5f * (u0 + u1), raio = 0.5f * (u1 - u0);
+    float soma = 0.0f;
+    for (int k = 0; k < 5; k++) soma += pesos[k] * glm::length(derivadaCurva(curve, meio + raio * nos[k]));
+    return soma * raio;
+}
+
+// Comprimento da curva entre u0 e u1 (dentro de um segmento): divide o intervalo ao meio enquanto as duas
+// metades não concordarem com o intervalo inteiro. Com 5 pontos quase nunca passa da primeira divisão
+float comprimentoAdaptativo(const Curve &curve, float u0, float u1, float inteiro, float tolerancia, int profundidade)
+{
+    float meio = 0.5f * (u0 + u1);
+    float esquerda = comprimentoGaussLegendre(curve, u0, meio);
+    float direita = comprimentoGaussLegendre(curve, meio, u1);
+    if (profundidade >= 8 || std::fabs(esquerda + direita - inteiro) <= tolerancia)
+    {
+        return esquerda + direita;
+    }
+    return comprimentoAdaptativo(curve, u0, meio, esquerda, tolerancia * 0.5f, profundidade + 1) +
+           comprimentoAdaptativo(curve, meio, u1, direita, tolerancia * 0.5f, profundidade + 1);
+}
+
+float comprimentoEntre(const Curve &curve, float u0, float u1)
+{
+    if (u1 <= u0) return 0.0f;
+    return comprimentoAdaptativo(curve, u0, u1, comprimentoGaussLegendre(curve, u0, u1), 1e-5f, 0);
+}
+
+// Distâncias das amostras de um segmento, contadas do início dele
+void medirSegmento(Curve &curve, int segmento)
+{
+    float *distancias = &curve.distanciasArco[(size_t)segmento * (AMOSTRAS_ARCO + 1)];
+    distancias[0] = 0.0f;
+    for (int k = 0; k < AMOSTRAS_ARCO; k++)
+    {
+        float u0 = segmento + (float)k / AMOSTRAS_ARCO;
+        float u1 = segmento + (float)(k + 1) / AMOSTRAS_ARCO;
+        distancias[k + 1] = distancias[k] + comprimentoEntre(curve, u0, u1);
+    }
+}
+
+// Mede todos os segmentos em paralelo e monta a árvore de Fenwick em O(n)
+void construirTabelaComprimento(Curve &curve)
+{
+    int segmentos = segmentosDaCurva(curve);
+    curve.distanciasArco.resize((size_t)segmentos * (AMOSTRAS_ARCO + 1));
+    curve.arvoreComprimentos.assign(segmentos + 1, 0.0);
+    curve.comprimento = 0.0f;
+    if (segmentos <= 0) return;
+
+    executarEmParalelo(0, segmentos, [&curve](int i) { medirSegmento(curve, i); });
+
+    double total = 0.0;
+    for (int i = 1; i <= segmentos; i++)
+    {
+        double comprimentoSegmento = curve.distanciasArco[(size_t)i * (AMOSTRAS_ARCO + 1) - 1];
+        total += comprimentoSegmento;
+        curve.arvoreComprimentos[i] += comprimentoSegmento;
+        int pai = i + (i & -i);
+        if (pai <= segmentos) curve.arvoreComprimentos[pai] += curve.arvoreComprimentos[i];
+    }
+    curve.comprimento = (float)total;
+    construirReferenciaisCurva(curve);
+}
+
+// Transporte paralelo da normal pelas amostras da tabela de comprimento, com a dupla reflexão de Wang et al.
+// (refletir no plano entre os dois pontos e depois no plano entre as tangentes). A normal inicial é o "para cima"
+// do mundo projetado na tangente, então uma curva no plano XY gira só em torno de z como antes. Numa curva fechada
+// a diferença entre a normal que volta ao início e a normal inicial é distribuída pelo comprimento, para o
+// referencial não dar um salto na emenda.
+// Com primeiroSegmento > 0 (curva aberta) os referenciais anteriores não mudam: o transporte recomeça da última
+// amostra do segmento anterior, que pela continuidade C1 tem o mesmo ponto e a mesma tangente de antes
+void construirReferenciaisCurva(Curve &curve, int primeiroSegmento)
+{
+    int segmentos = segmentosDaCurva(curve);
+    size_t amostras = (size_t)std::max(segmentos, 0) * (AMOSTRAS_ARCO + 1);
+    size_t base = 0; // primeira amostra refeita; as de antes continuam valendo
+    if (primeiroSegmento > 0 && primeiroSegmento < segmentos && !curve.referenciaisFechados && curve.orientacoesArco.size() == amostras)
+    {
+        base = (size_t)primeiroSegmento * (AMOSTRAS_ARCO + 1) - 1;
+    }
+    curve.orientacoesArco.resize(amostras);
+    if (amostras == 0) return;
+
+    size_t n = amostras - base; // os vetores abaixo são indexados a partir de base
+    std::vector<glm::vec3> pontos(n), tangentes(n), normais(n);
+    executarEmParalelo((int)(base / (AMOSTRAS_ARCO + 1)), segmentos, [&](int i) {
+        for (int k = 0; k <= AMOSTRAS_ARCO; k++)
+        {
+            size_t j = (size_t)i * (AMOSTRAS_ARCO + 1) + k;
+            if (j < base) continue;
+            float u = i + (float)k / AMOSTRAS_ARCO;
+            pontos[j - base] = avaliarCurva(curve, u);
+            tangentes[j - base] = derivadaCurva(curve, u);
+        }
+    });
+    if (base > 0)
+    {
+        tangentes[0] = curve.orientacoesArco[base] * glm::vec3(0.0f, 0.0f, 1.0f);
+        normais[0] = curve.orientacoesArco[base] * glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    // Tangentes nulas (pontos de controle repetidos) herdam a da amostra anterior, ou a primeira válida no começo
+    size_t primeiraValida = n;
+    for (size_t j = 0; j < n; j++)
+    {
+        float tamanho = glm::length(tangentes[j]);
+        if (tamanho > 1e-6f)
+        {
+            tangentes[j] = tangentes[j] / tamanho;
+            if (primeiraValida == n) primeiraValida = j;
+        }
+        else if (j > 0)
+        {
+            tangentes[j] = tangentes[j - 1];
+        }
+    }
+    glm::vec3 primeiraTangente = primeiraValida < n ? tangentes[primeiraValida] : glm::vec3(1.0f, 0.0f, 0.0f);
+    for (size_t j = 0; j < std::min(primeiraValida, n); j++) tangentes[j] = primeiraTangente;
+
+    if (base == 0)
+    {
+        glm::vec3 cima(0.0f, 1.0f, 0.0f);
+        if (std::fabs(glm::dot(cima, tangentes[0])) > 0.999f) cima = glm::vec3(0.0f, 0.0f, 1.0f);
+        normais[0] = glm::normalize(cima - glm::dot(cima, tangentes[0]) * tangentes[0]);
+    }
+    for (size_t j = 0; j + 1 < n; j++)
+    {
+        glm::vec3 r = normais[j], t = tangentes[j];
+        glm::vec3 v1 = pontos[j + 1] - pontos[j];
+        float c1 = glm::dot(v1, v1);
+        if (c1 > 1e-12f)
+        {
+            r -= (2.0f / c1) * glm::dot(v1, r) * v1;
+            t -= (2.0f / c1) * glm::dot(v1, t) * v1;
+        }
+        glm::vec3 v2 = tangentes[j + 1] - t;
+        float c2 = glm::dot(v2, v2);
+        if (c2 > 1e-12f) r -= (2.0f / c2) * glm::dot(v2, r) * v2;
+        normais[j + 1] = glm::normalize(r - glm::dot(r, tangentes[j + 1]) * tangentes[j + 1]);
+    }
+
+    glm::vec3 inicio = base > 0 ? avaliarCurva(curve, 0.0f) : pontos[0], fim = pontos[n - 1];
+    glm::vec3 tangenteInicial = base > 0 ? curve.orientacoesArco[0] * glm::vec3(0.0f, 0.0f, 1.0f) : tangentes[0];
+    bool fechada = glm::length(fim - inicio) <= 1e-4f * std::max(1.0f, curve.comprimento) &&
+                   glm::dot(tangenteInicial, tangentes[n - 1]) > 0.9999f;
+    if (fechada && base > 0)
+    {
+        construirReferenciaisCurva(curve); // a edição fechou a curva: a torção depende dela inteira
+        return;
+    }
+    curve.referenciaisFechados = fechada && curve.comprimento > 0.0f;
+    if (curve.referenciaisFechados)
+    {
+        glm::vec3 t0 = tangentes[0];
+        float torcao = std::atan2(glm::dot(glm::cross(normais[n - 1], normais[0]), t0), glm::dot(normais[n - 1], normais[0]));
+        double percorrido = 0.0;
+        for (int i = 0; i < segmentos; i++)
+        {
+            for (int k = 0; k <= AMOSTRAS_ARCO; k++)
+            {
+                size_t j = (size_t)i * (AMOSTRAS_ARCO + 1) + k;
+                float angulo = torcao * (float)((percorrido + curve.distanciasArco[j]) / curve.comprimento);
+                normais[j] = normais[j] * std::cos(angulo) + glm::cross(tangentes[j], normais[j]) * std::sin(angulo);
+            }
+            percorrido += curve.distanciasArco[(size_t)(i + 1) * (AMOSTRAS_ARCO + 1) - 1];
+        }
+    }
+
+    // Colunas x, y, z do referencial: binormal, normal e tangente. Quatérnios vizinhos no mesmo hemisfério para o slerp
+    for (size_t j = base > 0 ? 1 : 0; j < n; j++)
+    {
+        glm::quat q = glm::quat_cast(glm::mat3(glm::cross(normais[j], tangentes[j]), normais[j], tangentes[j]));
+        if (base + j > 0 && glm::dot(q, curve.orientacoesArco[base + j - 1]) < 0.0f) q = glm::quat(-q.w, -q.x, -q.y, -q.z);
+        curve.orientacoesArco[base + j] = q;
+    }
+}
+
+// Mede de novo um segmento editado e corrige a árvore em O(log n)
+void atualizarComprimentoSegmento(Curve &curve, int segmento)
+{
+    float antes = curve.distanciasArco[(size_t)(segmento + 1) * (AMOSTRAS_ARCO + 1) - 1];
+    medirSegmento(curve, segmento);
+    double diferenca = curve.distanciasArco[(size_t)(segmento + 1) * (AMOSTRAS_ARCO + 1) - 1] - antes;
+    int segmentos = segmentosDaCurva(curve);
+    for (int i = segmento + 1; i <= segmentos; i += i & -i) curve.arvoreComprimentos[i] += diferenca;
+    // O total é lido da árvore (em double) em vez de somar a diferença no float, que acumularia erro a cada edição
+    double total = 0.0;
+    for (int i = segmentos; i > 0; i -= i & -i) total += curve.arvoreComprimentos[i];
+    curve.comprimento = (float)total;
+}
+
+// Inverte a tabela: desce a árvore de Fenwick até o segmento que contém a distância (O(log n)), acha a amostra
+// dentro dele, chuta u por interpolação linear e corrige com Newton (a derivada do comprimento em relação a u é |C'(u)|),
+// então a distância fica exata sem amostrar mais a curva
+float parametroPorDistancia(const Curve &curve, float distancia, int iteracoesNewton)
+{
+    int segmentos = segmentosDaCurva(curve);
+    if (segmentos <= 0 || curve.comprimento <= 0.0f) return 0.0f;
+
+    double resto = glm::clamp(distancia, 0.0f, curve.comprimento);
+    int segmento = 0;
+    int passo = 1;
+    while (passo * 2 <= segmentos) passo *= 2;
+    for (; passo > 0; passo /= 2)
+    {
+        if (segmento + passo <= segmentos && curve.arvoreComprimentos[segmento + passo] <= resto)
+        {
+            segmento += passo;
+            resto -= curve.arvoreComprimentos[segmento];
+        }
+    }
+    if (segmento >= segmentos) // distância igual ao comprimento (ou erro de arredondamento): fim do último segmento
+    {
+        segmento = segmentos - 1;
+        resto = curve.distanciasArco[(size_t)segmentos * (AMOSTRAS_ARCO + 1) - 1];
+    }
+
+    const float *distancias = &curve.distanciasArco[(size_t)segmento * (AMOSTRAS_ARCO + 1)];
+    int k = 0;
+    while (k < AMOSTRAS_ARCO - 1 && distancias[k + 1] < resto) k++;
+    float d0 = distancias[k], d1 = distancias[k + 1];
+    float u0 = segmento + (float)k / AMOSTRAS_ARCO, u1 = segmento + (float)(k + 1) / AMOSTRAS_ARCO;
+    if (d1 <= d0) return u0; // trecho de comprimento zero (pontos de controle repetidos)
+    float alvo = (float)resto;
+    float u = u0 + (u1 - u0) * (alvo - d0) / (d1 - d0);
+    for (int iteracao = 0; iteracao < iteracoesNewton; iteracao++)
+    {
+        float erro = d0 + comprimentoEntre(curve, u0, u) - alvo;
+        float velocidade = glm::length(derivadaCurva(curve, u));
+        if (std::fabs(erro) < 1e-4f || velocidade < 1e-6f) break;
+        u = glm::clamp(u - erro / velocidade, u0, u1);
+    }
+    return u;
+}
+
+// Move um ponto de controle: só os (até 4) segmentos que usam o ponto são recalculados, na CPU e nos buffers,
+// e o comprimento de arco é corrigido só para eles, em O(log n). Os referenciais são a exceção: o transporte
+// paralelo é refeito do primeiro segmento editado até o fim (a curva inteira se ela for fechada)
+void moverPontoDeControle(Curve &curve, BuffersDaCurva &buffers, int indice, glm::vec3 posicao)
+{
+    if (indice < 0 || indice >= (int)curve.controlPoints.size()) return;
+    int primeiro = std::max(0, indice - 3);
+    int ultimo = std::min(segmentosDaCurva(curve) - 1, indice);
+    {
+        std::lock_guard<std::mutex> lock(mutexCurva);
+        curve.controlPoints[indice] = posicao;
+        for (int i = primeiro; i <= ultimo; i++)
+        {
+            glm::mat4x3 G(curve.controlPoints[i], curve.controlPoints[i + 1], curve.controlPoints[i + 2], curve.controlPoints[i + 3]);
+            glm::mat4x3 GM = G * curve.M;
+            curve.coeficientes[i] = {GM[0], GM[1], GM[2], GM[3]};
+            if (curve.toleranciaPlanicidade > 0.0f)
+            {
+                tesselarTrechoAdaptativo(curve, i);
+            }
+            else
+            {
+                tesselarSegmento(curve.coeficientes[i], curve.capacidadePorSegmento - 1, &curve.curvePoints[(size_t)i * curve.capacidadePorSegmento]);
+            }
+            atualizarComprimentoSegmento(curve, i);
+            curve.caixasSegmentos[i] = caixaDoSegmento(curve.coeficientes[i]);
+        }
+        reajustarBVH(curve.bvh, curve.caixasSegmentos); // a topologia continua boa para um ponto movido; só as caixas mudam
+        // O transporte paralelo depende de tudo que vem antes do ponto (e a correção da curva fechada, da curva
+        // inteira), então os referenciais são refeitos a partir do primeiro segmento editado
+        construirReferenciaisCurva(curve, primeiro);
+    }
+
+    if (buffers.VBOLinha && ultimo >= primeiro)
+    {
+        size_t inicio = (size_t)primeiro * curve.capacidadePorSegmento;
+        size_t quantidade = (size_t)(ultimo - primeiro + 1) * curve.capacidadePorSegmento;
+        glBindBuffer(GL_ARRAY_BUFFER, buffers.VBOLinha);
+        glBufferSubData(GL_ARRAY_BUFFER, inicio * sizeof(glm::vec3), quantidade * sizeof(glm::vec3), &curve.curvePoints[inicio]);
+    }
+    GLuint buffersDosPontos[2] = {buffers.VBOControle, buffers.gpu ? buffers.gpu->VBO : 0};
+    for (GLuint vbo : buffersDosPontos)
+    {
+        if (!vbo) continue;
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, indice * sizeof(glm::vec3), sizeof(glm::vec3), &curve.controlPoints[indice]);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+// Caixa exata do segmento: além das pontas, os pontos onde a derivada 3a t² + 2b t + c zera em cada eixo
+CaixaEnvolvente caixaDoSegmento(const CoeficientesSegmento &coef)
+{
+    CaixaEnvolvente caixa;
+    glm::vec3 inicio = coef.d, fim = coef.a + coef.b + coef.c + coef.d;
+    caixa.minimo = glm::min(inicio, fim);
+    caixa.maximo = glm::max(inicio, fim);
+    for (int eixo = 0; eixo < 3; eixo++)
+    {
+        float qa = 3.0f * coef.a[eixo], qb = 2.0f * coef.b[eixo], qc = coef.c[eixo];
+        float raizes[2];
+        int nRaizes = 0;
+        if (std::fabs(qa) < 1e-12f)
+        {
+            if (std::fabs(qb) > 1e-12f) raizes[nRaizes++] = -qc / qb;
+        }
+        else
+        {
+            float discriminante = qb * qb - 4.0f * qa * qc;
+            if (discriminante >= 0.0f)
+            {
+                float raiz = std::sqrt(discriminante);
+                raizes[nRaizes++] = (-qb - raiz) / (2.0f * qa);
+                raizes[nRaizes++] = (-qb + raiz) / (2.0f * qa);
+            }
+        }
+        for (int r = 0; r < nRaizes; r++)
+        {
+            if (raizes[r] <= 0.0f || raizes[r] >= 1.0f) continue;
+            float valor = avaliarSegmento(coef, raizes[r])[eixo];
+            caixa.minimo[eixo] = std::min(caixa.minimo[eixo], valor);
+            caixa.maximo[eixo] = std::max(caixa.maximo[eixo], valor);
+        }
+    }
+    return caixa;
+}
+
+CaixaEnvolvente unirCaixas(const CaixaEnvolvente &a, const CaixaEnvolvente &b)
+{
+    CaixaEnvolvente caixa;
+    caixa.minimo = glm::min(a.minimo, b.minimo);
+    caixa.maximo = glm::max(a.maximo, b.maximo);
+    return caixa;
+}
+
+float distanciaQuadradaCaixa(const CaixaEnvolvente &caixa, glm::vec3 ponto)
+{
+    glm::vec3 fora = glm::max(glm::max(caixa.minimo - ponto, ponto - caixa.maximo), glm::vec3(0.0f));
+    return glm::dot(fora, fora);
+}
+
+float areaDaCaixa(const CaixaEnvolvente &caixa)
+{
+    glm::vec3 lado = caixa.maximo - caixa.minimo;
+    return 2.0f * (lado.x * lado.y + lado.y * lado.z + lado.z * lado.x);
+}
+
+// 1 / direção para o teste de lâminas. Componentes nulas viram um número grande e finito em vez de infinito: com
+// a origem exatamente num plano da caixa, (minimo - origem) * inverso seria 0 * inf = NaN e o teste daria qualquer coisa
+glm::vec3 inversoDaDirecao(glm::vec3 direcao)
+{
+    glm::vec3 inverso;
+    for (int eixo = 0; eixo < 3; eixo++)
+    {
+        float d = direcao[eixo];
+        inverso[eixo] = std::fabs(d) > 1e-30f ? 1.0f / d : std::copysign(1e30f, d);
+    }
+    return inverso;
+}
+
+// Teste de lâminas; devolve em entrada a distância ao longo do raio onde ele entra na caixa
+bool raioNaCaixa(const CaixaEnvolvente &caixa, glm::vec3 origem, glm::vec3 inversoDirecao, float distanciaMaxima, float &entrada)
+{
+    glm::vec3 t0 = (caixa.minimo - origem) * inversoDirecao;
+    glm::vec3 t1 = (caixa.maximo - origem) * inversoDirecao;
+    glm::vec3 perto = glm::min(t0, t1), longe = glm::max(t0, t1);
+    entrada = std::max(std::max(perto.x, perto.y), std::max(perto.z, 0.0f));
+    float saida = std::min(std::min(longe.x, longe.y), std::min(longe.z, distanciaMaxima));
+    return entrada <= saida;
+}
+
+// Divide pelo eixo mais longo dos centros, na mediana; folhas com até 4 itens
+int construirNoBVH(BVH &bvh, const std::vector<CaixaEnvolvente> &caixas, int inicio, int fim)
+{
+    int indiceNo = (int)bvh.nos.size();
+    bvh.nos.push_back(NoBVH());
+    CaixaEnvolvente caixa, centros;
+    for (int i = inicio; i < fim; i++)
+    {
+        const CaixaEnvolvente &item = caixas[bvh.itens[i]];
+        caixa = unirCaixas(caixa, item);
+        glm::vec3 centro = (item.minimo + item.maximo) * 0.5f;
+        centros.minimo = glm::min(centros.minimo, centro);
+        centros.maximo = glm::max(centros.maximo, centro);
+    }
+    bvh.nos[indiceNo].caixa = caixa;
+    if (fim - inicio <= 4)
+    {
+        bvh.nos[indiceNo].primeiro = inicio;
+        bvh.nos[indiceNo].quantidade = fim - inicio;
+        return indiceNo;
+    }
+
+    glm::vec3 extensao = centros.maximo - centros.minimo;
+    int eixo = extensao.x > extensao.y ? (extensao.x > extensao.z ? 0 : 2) : (extensao.y > extensao.z ? 1 : 2);
+    int meio = (inicio + fim) / 2;
+    std::nth_element(bvh.itens.begin() + inicio, bvh.itens.begin() + meio, bvh.itens.begin() + fim, [&caixas, eixo](int a, int b) {
+        return caixas[a].minimo[eixo] + caixas[a].maximo[eixo] < caixas[b].minimo[eixo] + caixas[b].maximo[eixo];
+    });
+    construirNoBVH(bvh, caixas, inicio, meio);
+    int direito = construirNoBVH(bvh, caixas, meio, fim);
+    bvh.nos[indiceNo].primeiro = direito;
+    return indiceNo;
+}
+
+void construirBVH(BVH &bvh, const std::vector<CaixaEnvolvente> &caixas)
+{
+    bvh.nos.clear();
+    bvh.itens.resize(caixas.size());
+    std::iota(bvh.itens.begin(), bvh.itens.end(), 0);
+    if (caixas.empty()) return;
+    bvh.nos.reserve(caixas.size() / 2 + 1);
+    construirNoBVH(bvh, caixas, 0, (int)caixas.size());
+}
+
+// Recalcula as caixas dos nós sem mudar a árvore: em pré-ordem os filhos vêm depois do pai, então de trás para frente
+// cada nó interno já encontra os filhos atualizados
+void reajustarBVH(BVH &bvh, const std::vector<CaixaEnvolvente> &caixas)
+{
+    for (int i = (int)bvh.nos.size() - 1; i >= 0; i--)
+    {
+        NoBVH &no = bvh.nos[i];
+        if (no.quantidade > 0)
+        {
+            no.caixa = CaixaEnvolvente();
+            for (int k = 0; k < no.quantidade; k++) no.caixa = unirCaixas(no.caixa, caixas[bvh.itens[no.primeiro + k]]);
+        }
+        else
+        {
+            no.caixa = unirCaixas(bvh.nos[i + 1].caixa, bvh.nos[no.primeiro].caixa);
+        }
+    }
+}
+
+void construirBVHCurva(Curve &curve)
+{
+    int segmentos = segmentosDaCurva(curve);
+    curve.caixasSegmentos.resize(segmentos);
+    executarEmParalelo(0, segmentos, [&curve](int i) { curve.caixasSegmentos[i] = caixaDoSegmento(curve.coeficientes[i]); }, 4096);
+    construirBVH(curve.bvh, curve.caixasSegmentos);
+}
+
+// Ponto do segmento mais perto de p: a melhor de AMOSTRAS_ARCO + 1 amostras é refinada com Newton em
+// f(t) = (C(t) - p) . C'(t). Devolve a distância ao quadrado
+float maisProximoNoSegmento(const CoeficientesSegmento &coef, glm::vec3 ponto, float &t)
+{
+    float melhor = 1e30f;
+    t = 0.0f;
+    for (int k = 0; k <= AMOSTRAS_ARCO; k++)
+    {
+        glm::vec3 diferenca = avaliarSegmento(coef, (float)k / AMOSTRAS_ARCO) - ponto;
+        float d = glm::dot(diferenca, diferenca);
+        if (d < melhor)
+        {
+            melhor = d;
+            t = (float)k / AMOSTRAS_ARCO;
+        }
+    }
+    float refinado = t;
+    for (int iteracao = 0; iteracao < 4; iteracao++)
+    {
+        glm::vec3 diferenca = avaliarSegmento(coef, refinado) - ponto;
+        glm::vec3 primeira = (3.0f * coef.a * refinado + 2.0f * coef.b) * refinado + coef.c;
+        glm::vec3 segunda = 6.0f * coef.a * refinado + 2.0f * coef.b;
+        float derivada = glm::dot(primeira, primeira) + glm::dot(diferenca, segunda);
+        if (std::fabs(derivada) < 1e-12f) break;
+        refinado = glm::clamp(refinado - glm::dot(diferenca, primeira) / derivada, 0.0f, 1.0f);
+    }
+    glm::vec3 diferenca = avaliarSegmento(coef, refinado) - ponto;
+    float d = glm::dot(diferenca, diferenca);
+    if (d < melhor) // Newton pode sair da bacia da amostra perto de uma ponta; aí fica a amostra
+    {
+        melhor = d;
+        t = refinado;
+    }
+    return melhor;
+}
+
+// Entrada de um raio (direção unitária) no tubo de raio raioTubo em volta do segmento, vendo o tubo como a união das
+// esferas centradas na curva: a esfera em C(t) é atingida em e(t) = s - sqrt(r² - q²), com s a projeção de C(t) - origem
+// no raio e q a distância perpendicular. O ponto de maior aproximação (Newton em q(t) . C'(t), como no ponto mais próximo)
+// garante uma semente dentro do tubo mesmo quando o raio cruza o segmento num trecho curto; a menor entrada entre ela e
+// as amostras é refinada por busca de passo decrescente. Devolve a distância ao longo do raio (1e30 se não acerta)
+float entradaNoTuboDoSegmento(const CoeficientesSegmento &coef, glm::vec3 origem, glm::vec3 direcao, float raioTubo, float &t)
+{
+    float raioQuadrado = raioTubo * raioTubo;
+    auto entrada = [&](float tt) {
+        glm::vec3 w = avaliarSegmento(coef, tt) - origem;
+        float s = glm::dot(w, direcao);
+        float perpendicular = glm::dot(w, w) - s * s;
+        if (perpendicular > raioQuadrado) return 1e30f;
+        float meiaCorda = std::sqrt(raioQuadrado - perpendicular);
+        if (s + meiaCorda < 0.0f) return 1e30f; // esfera inteira atrás da origem
+        return std::max(0.0f, s - meiaCorda);
+    };
+
+    float perto = 0.0f, menorPerpendicular = 1e30f;
+    for (int k = 0; k <= AMOSTRAS_ARCO; k++)
+    {
+        glm::vec3 w = avaliarSegmento(coef, (float)k / AMOSTRAS_ARCO) - origem;
+        float s = glm::dot(w, direcao);
+        if (glm::dot(w, w) - s * s < menorPerpendicular)
+        {
+            menorPerpendicular = glm::dot(w, w) - s * s;
+            perto = (float)k / AMOSTRAS_ARCO;
+        }
+    }
+    for (int iteracao = 0; iteracao < 4; iteracao++)
+    {
+        glm::vec3 w = avaliarSegmento(coef, perto) - origem;
+        glm::vec3 q = w - glm::dot(w, direcao) * direcao;
+        glm::vec3 primeira = (3.0f * coef.a * perto + 2.0f * coef.b) * perto + coef.c;
+        glm::vec3 segunda = 6.0f * coef.a * perto + 2.0f * coef.b;
+        float aoLongo = glm::dot(primeira, direcao);
+        float derivada = glm::dot(primeira, primeira) - aoLongo * aoLongo + glm::dot(q, segunda);
+        if (std::fabs(derivada) < 1e-12f) break;
+        perto = glm::clamp(perto - glm::dot(q, primeira) / derivada, 0.0f, 1.0f);
+    }
+
+    t = perto;
+    float melhor = entrada(perto);
+    const int amostras = 2 * AMOSTRAS_ARCO;
+    for (int k = 0; k <= amostras; k++)
+    {
+        float e = entrada((float)k / amostras);
+        if (e < melhor)
+        {
+            melhor = e;
+            t = (float)k / amostras;
+        }
+    }
+    if (melhor >= 1e30f) return melhor;
+    for (float passo = 0.5f / amostras; passo > 1e-5f;)
+    {
+        float antes = entrada(std::max(0.0f, t - passo)), depois = entrada(std::min(1.0f, t + passo));
+        if (antes < melhor && antes <= depois)
+        {
+            melhor = antes;
+            t = std::max(0.0f, t - passo);
+        }
+        else if (depois < melhor)
+        {
+            melhor = depois;
+            t = std::min(1.0f, t + passo);
+        }
+        else
+        {
+            passo *= 0.5f;
+        }
+    }
+    return melhor;
+}
+
+// Percorre a BVH dos segmentos do nó mais perto para o mais longe, descartando caixas mais longe que o melhor
+// ponto achado até agora. Só os segmentos que sobram são refinados
+PontoNaCurva pontoMaisProximoNaCurva(const Curve &curve, glm::vec3 ponto, float distanciaMaxima)
+{
+    PontoNaCurva resultado;
+    const BVH &bvh = curve.bvh;
+    if (bvh.nos.empty()) return resultado;
+    float melhor = distanciaMaxima < 1e15f ? distanciaMaxima * distanciaMaxima : 1e30f;
+    int pilha[64];
+    int topo = 0;
+    pilha[topo++] = 0;
+    while (topo > 0)
+    {
+        const NoBVH &no = bvh.nos[pilha[--topo]];
+        if (distanciaQuadradaCaixa(no.caixa, ponto) >= melhor) continue;
+        if (no.quantidade > 0)
+        {
+            for (int k = 0; k < no.quantidade; k++)
+            {
+                int segmento = bvh.itens[no.primeiro + k];
+                if (distanciaQuadradaCaixa(curve.caixasSegmentos[segmento], ponto) >= melhor) continue;
+                float t;
+                float d = maisProximoNoSegmento(curve.coeficientes[segmento], ponto, t);
+                if (d < melhor)
+                {
+                    melhor = d;
+                    resultado.curva = 0;
+                    resultado.u = segmento + t;
+                }
+            }
+            continue;
+        }
+        int esquerdo = (int)(&no - bvh.nos.data()) + 1, direito = no.primeiro;
+        if (distanciaQuadradaCaixa(bvh.nos[esquerdo].caixa, ponto) < distanciaQuadradaCaixa(bvh.nos[direito].caixa, ponto)) std::swap(esquerdo, direito);
+        pilha[topo++] = esquerdo; // o mais perto sai primeiro
+        pilha[topo++] = direito;
+    }
+    if (resultado.curva >= 0)
+    {
+        resultado.ponto = avaliarCurva(curve, resultado.u);
+        resultado.distancia = std::sqrt(melhor);
+    }
+    return resultado;
+}
+
+// Raio contra um tubo de raio raioTubo em volta da curva: as caixas crescem raioTubo e os segmentos das folhas
+// atingidas calculam a entrada no tubo. resultado.distancia é a distância ao longo do raio (e o limite da busca)
+bool raioNaCurva(const Curve &curve, glm::vec3 origem, glm::vec3 direcao, float raioTubo, PontoNaCurva &resultado)
+{
+    const BVH &bvh = curve.bvh;
+    if (bvh.nos.empty()) return false;
+    direcao = glm::normalize(direcao);
+    glm::vec3 inversoDirecao = inversoDaDirecao(direcao);
+    glm::vec3 folga(raioTubo);
+    float maisPerto = resultado.distancia;
+    bool acertou = false;
+    int pilha[64];
+    int topo = 0;
+    pilha[topo++] = 0;
+    while (topo > 0)
+    {
+        const NoBVH &no = bvh.nos[pilha[--topo]];
+        CaixaEnvolvente caixa = no.caixa;
+        caixa.minimo -= folga;
+        caixa.maximo += folga;
+        float entrada;
+        if (!raioNaCaixa(caixa, origem, inversoDirecao, maisPerto, entrada)) continue;
+        if (no.quantidade == 0)
+        {
+            pilha[topo++] = no.primeiro;
+            pilha[topo++] = (int)(&no - bvh.nos.data()) + 1;
+            continue;
+        }
+        for (int k = 0; k < no.quantidade; k++)
+        {
+            int segmento = bvh.itens[no.primeiro + k];
+            float t;
+            float distancia = entradaNoTuboDoSegmento(curve.coeficientes[segmento], origem, direcao, raioTubo, t);
+            if (distancia < maisPerto)
+            {
+                maisPerto = distancia;
+                resultado.curva = 0;
+                resultado.u = segmento + t;
+                resultado.ponto = avaliarSegmento(curve.coeficientes[segmento], t);
+                resultado.distancia = distancia;
+                acertou = true;
+            }
+        }
+    }
+    return acertou;
+}
+
+void construirIndiceDeCurvas(IndiceDeCurvas &indice, const std::vector<const Curve *> &curvas)
+{
+    indice.curvas = curvas;
+    indice.caixas.resize(curvas.size());
+    for (size_t i = 0; i < curvas.size(); i++)
+    {
+        indice.caixas[i] = curvas[i]->bvh.nos.empty() ? CaixaEnvolvente() : curvas[i]->bvh.nos[0].caixa;
+    }
+    construirBVH(indice.bvh, indice.caixas);
+}
+
+PontoNaCurva pontoMaisProximoNasCurvas(const IndiceDeCurvas &indice, glm::vec3 ponto)
+{
+    PontoNaCurva melhor;
+    const BVH &bvh = indice.bvh;
+    if (bvh.nos.empty()) return melhor;
+    int pilha[64];
+    int topo = 0;
+    pilha[topo++] = 0;
+    while (topo > 0)
+    {
+        const NoBVH &no = bvh.nos[pilha[--topo]];
+        if (distanciaQuadradaCaixa(no.caixa, ponto) >= melhor.distancia * melhor.distancia) continue;
+        if (no.quantidade > 0)
+        {
+            for (int k = 0; k < no.quantidade; k++)
+            {
+                int curva = bvh.itens[no.primeiro + k];
+                PontoNaCurva candidato = pontoMaisProximoNaCurva(*indice.curvas[curva], ponto, melhor.distancia);
+                if (candidato.curva >= 0 && candidato.distancia < melhor.distancia)
+                {
+                    melhor = candidato;
+                    melhor.curva = curva;
+                }
+            }
+            continue;
+        }
+        int esquerdo = (int)(&no - bvh.nos.data()) + 1, direito = no.primeiro;
+        if (distanciaQuadradaCaixa(bvh.nos[esquerdo].caixa, ponto) < distanciaQuadradaCaixa(bvh.nos[direito].caixa, ponto)) std::swap(esquerdo, direito);
+        pilha[topo++] = esquerdo;
+        pilha[topo++] = direito;
+    }
+    return melhor;
+}
+
+bool raioNasCurvas(const IndiceDeCurvas &indice, glm::vec3 origem, glm::vec3 direcao, float raioTubo, PontoNaCurva &resultado)
+{
+    const BVH &bvh = indice.bvh;
+    if (bvh.nos.empty()) return false;
+    glm::vec3 inversoDirecao = inversoDaDirecao(glm::normalize(direcao));
+    glm::vec3 folga(raioTubo);
+    bool acertou = false;
+    int pilha[64];
+    int topo = 0;
+    pilha[topo++] = 0;
+    while (topo > 0)
+    {
+        const NoBVH &no = bvh.nos[pilha[--topo]];
+        CaixaEnvolvente caixa = no.caixa;
+        caixa.minimo -= folga;
+        caixa.maximo += folga;
+        float entrada;
+        if (!raioNaCaixa(caixa, origem, inversoDirecao, resultado.distancia, entrada)) continue;
+        if (no.quantidade == 0)
+        {
+            pilha[topo++] = no.primeiro;
+            pilha[topo++] = (int)(&no - bvh.nos.data()) + 1;
+            continue;
+        }
+        for (int k = 0; k < no.quantidade; k++)
+        {
+            int curva = bvh.itens[no.primeiro + k];
+            if (raioNaCurva(*indice.curvas[curva], origem, direcao, raioTubo, resultado))
+            {
+                resultado.curva = curva;
+                acertou = true;
+            }
+        }
+    }
+    return acertou;
+}
+
+// Möller–Trumbore com as arestas já calculadas; t em unidades de `direcao`
+bool raioNoTriangulo(glm::vec3 v0, glm::vec3 aresta1, glm::vec3 aresta2, glm::vec3 origem, glm::vec3 direcao, float &t)
+{
+    glm::vec3 p = glm::cross(direcao, aresta2);
+    float det = glm::dot(aresta1, p);
+    if (std::fabs(det) < 1e-12f) return false;
+    float inverso = 1.0f / det;
+    glm::vec3 s = origem - v0;
+    float u = glm::dot(s, p) * inverso;
+    if (u < 0.0f || u > 1.0f) return false;
+    glm::vec3 q = glm::cross(s, aresta1);
+    float v = glm::dot(direcao, q) * inverso;
+    if (v < 0.0f || u + v > 1.0f) return false;
+    t = glm::dot(aresta2, q) * inverso;
+    return t > 1e-6f;
+}
+
+// Testa os 4 triângulos do pacote de uma vez; devolve a vaga do acerto mais próximo antes de `distancia` (ou -1)
+int raioNoPacote(const PacoteTriangulos &pacote, glm::vec3 origem, glm::vec3 direcao, float &distancia)
+{
+    alignas(16) float ts[4];
+    int acertos = 0;
+#ifdef MIPMAP_SSE2
+    __m128 d[3], o[3], v0[3], e1[3], e2[3];
+    for (int e = 0; e < 3; e++)
+    {
+        d[e] = _mm_set1_ps(direcao[e]);
+        o[e] = _mm_set1_ps(origem[e]);
+        v0[e] = _mm_load_ps(pacote.v0[e]);
+        e1[e] = _mm_load_ps(pacote.aresta1[e]);
+        e2[e] = _mm_load_ps(pacote.aresta2[e]);
+    }
+    auto produtoEscalar = [](const __m128 *a, const __m128 *b) {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+    };
+    auto produtoVetorial = [](const __m128 *a, const __m128 *b, __m128 *r) {
+        r[0] = _mm_sub_ps(_mm_mul_ps(a[1], b[2]), _mm_mul_ps(a[2], b[1]));
+        r[1] = _mm_sub_ps(_mm_mul_ps(a[2], b[0]), _mm_mul_ps(a[0], b[2]));
+        r[2] = _mm_sub_ps(_mm_mul_ps(a[0], b[1]), _mm_mul_ps(a[1], b[0]));
+    };
+    __m128 p[3], s[3], q[3];
+    produtoVetorial(d, e2, p);
+    __m128 det = produtoEscalar(e1, p);
+    __m128 valido = _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), det), _mm_set1_ps(1e-12f)); // vagas vazias têm det = 0
+    __m128 inverso = _mm_div_ps(_mm_set1_ps(1.0f), det);
+    for (int e = 0; e < 3; e++) s[e] = _mm_sub_ps(o[e], v0[e]);
+    __m128 u = _mm_mul_ps(produtoEscalar(s, p), inverso);
+    produtoVetorial(s, e1, q);
+    __m128 v = _mm_mul_ps(produtoEscalar(d, q), inverso);
+    __m128 t = _mm_mul_ps(produtoEscalar(e2, q), inverso);
+    valido = _mm_and_ps(valido, _mm_cmpge_ps(u, _mm_setzero_ps()));
+    valido = _mm_and_ps(valido, _mm_cmpge_ps(v, _mm_setzero_ps()));
+    valido = _mm_and_ps(valido, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    valido = _mm_and_ps(valido, _mm_cmpgt_ps(t, _mm_set1_ps(1e-6f)));
+    valido = _mm_and_ps(valido, _mm_cmplt_ps(t, _mm_set1_ps(distancia)));
+    acertos = _mm_movemask_ps(valido);
+    if (acertos == 0) return -1;
+    _mm_store_ps(ts, t);
+#else
+    for (int k = 0; k < 4; k++)
+    {
+        if (pacote.indices[k] < 0) continue;
+        glm::vec3 v0(pacote.v0[0][k], pacote.v0[1][k], pacote.v0[2][k]);
+        glm::vec3 e1(pacote.aresta1[0][k], pacote.aresta1[1][k], pacote.aresta1[2][k]);
+        glm::vec3 e2(pacote.aresta2[0][k], pacote.aresta2[1][k], pacote.aresta2[2][k]);
+        if (raioNoTriangulo(v0, e1, e2, origem, direcao, ts[k]) && ts[k] < distancia) acertos |= 1 << k;
+    }
+    if (acertos == 0) return -1;
+#endif
+    int melhor = -1;
+    for (int k = 0; k < 4; k++)
+    {
+        if ((acertos & (1 << k)) && ts[k] < distancia)
+        {
+            distancia = ts[k];
+            melhor = k;
+        }
+    }
+    return melhor;
+}
+
+// SAH com 16 baldes por eixo sobre os centróides. Como cada folha vira um único pacote, nós com mais de 4 triângulos
+// sempre se dividem; quando os centróides coincidem (ou nenhum corte separa nada) cai para a mediana
+int construirNoBVHMalha(BVHMalha &malha, const std::vector<CaixaEnvolvente> &caixas, const std::vector<glm::vec3> &centros,
+                        const std::vector<GLfloat> &vBuffer, int inicio, int fim)
+{
+    const int BALDES = 16;
+    BVH &bvh = malha.bvh;
+    int indiceNo = (int)bvh.nos.size();
+    bvh.nos.push_back(NoBVH());
+    CaixaEnvolvente caixa, caixaCentros;
+    for (int i = inicio; i < fim; i++)
+    {
+        caixa = unirCaixas(caixa, caixas[bvh.itens[i]]);
+        caixaCentros.minimo = glm::min(caixaCentros.minimo, centros[bvh.itens[i]]);
+        caixaCentros.maximo = glm::max(caixaCentros.maximo, centros[bvh.itens[i]]);
+    }
+    bvh.nos[indiceNo].caixa = caixa;
+    if (fim - inicio <= 4)
+    {
+        PacoteTriangulos pacote;
+        std::memset(&pacote, 0, sizeof(pacote));
+        for (int k = 0; k < 4; k++)
+        {
+            pacote.indices[k] = -1;
+            if (inicio + k >= fim) continue;
+            int triangulo = bvh.itens[inicio + k];
+            const GLfloat *v = &vBuffer[(size_t)triangulo * 33];
+            for (int e = 0; e < 3; e++)
+            {
+                pacote.v0[e][k] = v[e];
+                pacote.aresta1[e][k] = v[11 + e] - v[e];
+                pacote.aresta2[e][k] = v[22 + e] - v[e];
+            }
+            pacote.indices[k] = triangulo;
+        }
+        bvh.nos[indiceNo].primeiro = (int)malha.pacotes.size();
+        bvh.nos[indiceNo].quantidade = fim - inicio;
+        malha.pacotes.push_back(pacote);
+        return indiceNo;
+    }
+
+    int melhorEixo = -1, melhorCorte = 0;
+    float melhorCusto = 1e30f;
+    glm::vec3 extensao = caixaCentros.maximo - caixaCentros.minimo;
+    for (int eixo = 0; eixo < 3; eixo++)
+    {
+        if (extensao[eixo] <= 0.0f) continue;
+        CaixaEnvolvente caixasBalde[BALDES];
+        int contagem[BALDES] = {};
+        float escala = BALDES / extensao[eixo];
+        for (int i = inicio; i < fim; i++)
+        {
+            int item = bvh.itens[i];
+            int b = std::min(BALDES - 1, (int)((centros[item][eixo] - caixaCentros.minimo[eixo]) * escala));
+            contagem[b]++;
+            caixasBalde[b] = unirCaixas(caixasBalde[b], caixas[item]);
+        }
+        // Varredura da direita acumula as áreas; a da esquerda avalia cada corte
+        float areaDireita[BALDES];
+        int quantidadeDireita[BALDES];
+        CaixaEnvolvente acumulada;
+        int n = 0;
+        for (int b = BALDES - 1; b > 0; b--)
+        {
+            acumulada = unirCaixas(acumulada, caixasBalde[b]);
+            n += contagem[b];
+            areaDireita[b] = areaDaCaixa(acumulada);
+            quantidadeDireita[b] = n;
+        }
+        acumulada = CaixaEnvolvente();
+        n = 0;
+        for (int corte = 1; corte < BALDES; corte++)
+        {
+            acumulada = unirCaixas(acumulada, caixasBalde[corte - 1]);
+            n += contagem[corte - 1];
+            if (n == 0 || quantidadeDireita[corte] == 0) continue;
+            float custo = areaDaCaixa(acumulada) * n + areaDireita[corte] * quantidadeDireita[corte];
+            if (custo < melhorCusto)
+            {
+                melhorCusto = custo;
+                melhorEixo = eixo;
+                melhorCorte = corte;
+            }
+        }
+    }
+
+    int meio;
+    if (melhorEixo >= 0)
+    {
+        float minimo = caixaCentros.minimo[melhorEixo], escala = BALDES / extensao[melhorEixo];
+        meio = (int)(std::partition(bvh.itens.begin() + inicio, bvh.itens.begin() + fim, [&](int item) {
+            return std::min(BALDES - 1, (int)((centros[item][melhorEixo] - minimo) * escala)) < melhorCorte;
+        }) - bvh.itens.begin());
+    }
+    else
+    {
+        meio = (inicio + fim) / 2;
+    }
+    construirNoBVHMalha(malha, caixas, centros, vBuffer, inicio, meio);
+    int direito = construirNoBVHMalha(malha, caixas, centros, vBuffer, meio, fim);
+    bvh.nos[indiceNo].primeiro = direito;
+    return indiceNo;
+}
+
+// vBuffer no formato de lerArquivoOBJ (11 floats por vértice, posição primeiro, 3 vértices por triângulo)
+std::shared_ptr<const BVHMalha> construirBVHMalha(const std::vector<GLfloat> &vBuffer)
+{
+    auto inicio = std::chrono::steady_clock::now();
+    auto malha = std::make_shared<BVHMalha>();
+    malha->triangulos = (int)(vBuffer.size() / 33);
+    if (malha->triangulos == 0) return malha;
+
+    std::vector<CaixaEnvolvente> caixas(malha->triangulos);
+    std::vector<glm::vec3> centros(malha->triangulos);
+    for (int i = 0; i < malha->triangulos; i++)
+    {
+        const GLfloat *v = &vBuffer[(size_t)i * 33];
+        for (int k = 0; k < 3; k++)
+        {
+            glm::vec3 p(v[k * 11], v[k * 11 + 1], v[k * 11 + 2]);
+            caixas[i].minimo = glm::min(caixas[i].minimo, p);
+            caixas[i].maximo = glm::max(caixas[i].maximo, p);
+        }
+        centros[i] = (caixas[i].minimo + caixas[i].maximo) * 0.5f;
+    }
+    malha->bvh.itens.resize(malha->triangulos);
+    std::iota(malha->bvh.itens.begin(), malha->bvh.itens.end(), 0);
+    malha->bvh.nos.reserve(malha->triangulos / 2 + 1);
+    malha->pacotes.reserve(malha->triangulos / 2 + 1);
+    construirNoBVHMalha(*malha, caixas, centros, vBuffer, 0, malha->triangulos);
+    malha->msConstrucao = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - inicio).count();
+    return malha;
+}
+
+// Raio no espaço do modelo. Desce primeiro no filho que o raio atinge antes, para que `distancia` encolha cedo e
+// descarte o outro; devolve o triângulo mais próximo (ou -1) e a distância em unidades de `direcao`
+int raioNaMalha(const BVHMalha &malha, glm::vec3 origem, glm::vec3 direcao, float &distancia)
+{
+    if (malha.bvh.nos.empty()) return -1;
+    glm::vec3 inversoDirecao = inversoDaDirecao(direcao);
+    int melhor = -1;
+    float entrada;
+    if (!raioNaCaixa(malha.bvh.nos[0].caixa, origem, inversoDirecao, distancia, entrada)) return -1;
+    std::vector<int> pilha;
+    pilha.push_back(0);
+    while (!pilha.empty())
+    {
+        const NoBVH &no = malha.bvh.nos[pilha.back()];
+        pilha.pop_back();
+        if (no.quantidade > 0)
+        {
+            const PacoteTriangulos &pacote = malha.pacotes[no.primeiro];
+            int vaga = raioNoPacote(pacote, origem, direcao, distancia);
+            if (vaga >= 0) melhor = pacote.indices[vaga];
+            continue;
+        }
+        int esquerdo = (int)(&no - &malha.bvh.nos[0]) + 1, direito = no.primeiro;
+        float entradaEsquerdo, entradaDireito;
+        bool acertaEsquerdo = raioNaCaixa(malha.bvh.nos[esquerdo].caixa, origem, inversoDirecao, distancia, entradaEsquerdo);
+        bool acertaDireito = raioNaCaixa(malha.bvh.nos[direito].caixa, origem, inversoDirecao, distancia, entradaDireito);
+        if (acertaEsquerdo && acertaDireito)
+        {
+            // O mais distante vai primeiro para a pilha
+            if (entradaEsquerdo < entradaDireito) std::swap(esquerdo, direito);
+            pilha.push_back(esquerdo);
+            pilha.push_back(direito);
+        }
+        else if (acertaEsquerdo)
+        {
+            pilha.push_back(esquerdo);
+        }
+        else if (acertaDireito)
+        {
+            pilha.push_back(direito);
+        }
+    }
+    return melhor;
+}
+
+
+// Programa da curva com os shaders de tesselação; devolve 0 se algum estágio falhar (o desenho volta para a CPU)
+int setupShaderCurva()
+{
+    const GLchar *fontes[4] = {curvaVertexShaderSource, curvaTessControlShaderSource, curvaTessEvalShaderSource, curvaFragmentShaderSource};
+    GLenum tipos[4] = {GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_FRAGMENT_SHADER};
+    GLint success;
+    GLchar infoLog[512];
+
+    GLuint shaderProgram = glCreateProgram();
+    GLuint shaders[4];
+    for (int i = 0; i < 4; i++)
+    {
+        shaders[i] = glCreateShader(tipos[i]);
+        glShaderSource(shaders[i], 1, &fontes[i], NULL);
+        glCompileShader(shaders[i]);
+        glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(shaders[i], 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::CURVA::COMPILATION_FAILED (estagio " << i << ")\n"
+                      << infoLog << std::endl;
+        }
+        glAttachShader(shaderProgram, shaders[i]);
+    }
+    glLinkProgram(shaderProgram);
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    for (int i = 0; i < 4; i++) glDeleteShader(shaders[i]);
+    if (!success)
+    {
+        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::CURVA::LINKING_FAILED\n"
+                  << infoLog << std::endl;
+        glDeleteProgram(shaderProgram);
+        return 0;
+    }
+    return shaderProgram;
+}
+
+// Envia só os pontos de controle (12 bytes cada) e os índices dos patches
+CurvaGPU criarCurvaGPU(const Curve &curve)
+{
+    CurvaGPU curva;
+    int segmentos = segmentosDaCurva(curve);
+    std::vector<GLuint> indices;
+    indices.reserve(segmentos * 4);
+    for (int i = 0; i < segmentos; i++)
+    {
+        for (int k = 0; k < 4; k++) indices.push_back(i + k);
+    }
+    curva.nIndices = (int)indices.size();
+
+    glGenVertexArrays(1, &curva.VAO);
+    glGenBuffers(1, &curva.VBO);
+    glGenBuffers(1, &curva.EBO);
+    glBindVertexArray(curva.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, curva.VBO);
+    glBufferData(GL_ARRAY_BUFFER, curve.controlPoints.size() * sizeof(glm::vec3), curve.controlPoints.data(), GL_DYNAMIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid *)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, curva.EBO); // fica registrado no VAO
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return curva;
+}
+
+void destruirCurvaGPU(CurvaGPU &curva)
+{
+    glDeleteVertexArrays(1, &curva.VAO);
+    glDeleteBuffers(1, &curva.VBO);
+    glDeleteBuffers(1, &curva.EBO);
+    curva = CurvaGPU();
+}
+
+GLuint generateControlPointsBuffer(vector<glm::vec3> controlPoints, GLuint *VBOGerado)
+{
+    GLuint VBO, VAO;
+
+    // Geração do identificador do VBO
+    glGenBuffers(1, &VBO);
+
+    // Faz a conexão (vincula) do buffer como um buffer de array
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+    // Envia os dados do array de floats para o buffer da OpenGl
+    glBufferData(GL_ARRAY_BUFFER, controlPoints.size() * sizeof(GLfloat) * 3, controlPoints.data(), GL_STATIC_DRAW);
+
+    // Geração do identificador do VAO (Vertex Array Object)
+    glGenVertexArrays(1, &VAO);
+
+    // Vincula (bind) o VAO primeiro, e em seguida  conecta e seta o(s) buffer(s) de vértices
+    // e os ponteiros para os atributos
+    glBindVertexArray(VAO);
+
+    // Atributo posição (x, y, z)
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid *)0);
+    glEnableVertexAttribArray(0);
+
+    // Observe que isso é permitido, a chamada para glVertexAttribPointer registrou o VBO como o objeto de buffer de vértice
+    // atualmente vinculado - para que depois possamos desvincular com segurança
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Desvincula o VAO (é uma boa prática desvincular qualquer buffer ou array para evitar bugs medonhos)
+    glBindVertexArray(0);
+
+    // Quem precisar atualizar (glBufferSubData) ou apagar o VBO pede o identificador; senão ele é apagado
+    // aqui mesmo e continua vivo enquanto o VAO existir
+    if (VBOGerado) *VBOGerado = VBO;
+    else glDeleteBuffers(1, &VBO);
+
+    return VAO;
+}
+
+std::vector<glm::vec3> loadPontosDaCurvaDoArquivo(const std::string& filePath)
+{
+    std::vector<glm::vec3> controlPoints;
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        std::cerr << "Erro ao tentar ler o arquivo dos pontos de controle: " << filePath << std::endl;
+        return controlPoints;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::stringstream ss(line);
+        float x, y, z;
+        if (ss >> x >> y >> z) {
+            controlPoints.push_back(glm::vec3(x, y, z));
+        } else {
+            std::cerr << "Erro ao parsear linha no arquivo de pontos de controle: " << line << std::endl;
+        }
+    }
+    file.close();
+    return controlPoints;
+}
+void loadSceneConfiguration(const std::string& configFilePath, std::vector<Object>& objs, glm::vec3& cameraPos, glm::vec3& cameraFront, glm::vec3& cameraUp, float& rotacaoYaw, float& rotaocaoPitch, glm::vec3& lightPos)
+{
+    std::ifstream configFile(configFilePath);
+    if (!configFile.is_open()) {
+        std::cerr << "ERRO: Nao foi possivel abrir o arquivo de configuracao: " << configFilePath << std::endl;
+        return;
+    }
+
+    std::string line;
+    bool inObjectBlock = false;
+    bool inCameraBlock = false;
+    bool inLightBlock = false;
+    Object currentObject;
+    std::vector<Object> declarados; // objetos do arquivo, na ordem (os OBJs já começam a ser lidos no pool)
+    while (std::getline(configFile, line)) {
+        std::stringstream ss(line);
+        std::string tag;
+        ss >> tag;
+
+        if (tag == "<OBJECT>") {
+            inObjectBlock = true;
+            inCameraBlock = false;
+            currentObject = Object();
+            currentObject.posX = 0.0f; currentObject.posY = 0.0f; currentObject.posZ = 0.0f;
+            currentObject.rotateX = false; currentObject.rotateY = false; currentObject.rotateZ = false;
+            currentObject.tamanhoEscala = 1.0f;
+            currentObject.model = glm::mat4(1.0f);
+            
+        } else if (tag == "<CAMERA>") {
+            inObjectBlock = false;
+            inCameraBlock = true;
+        } else if (tag == "<LIGHT>") {
+            inObjectBlock = false;
+            inCameraBlock = false;
+            inLightBlock = true;
+        } else if (tag == "</OBJECT>") {
+            if (inObjectBlock) {
+                if (!currentObject.NomeObj.empty() && carregamentoAssincrono) {
+                    // O objeto entra em objs quando a thread de carregamento terminar (na mesma ordem do arquivo)
+                    carregarObjetoAssincrono(carregador, currentObject);
+                } else if (!currentObject.NomeObj.empty()) {
+                    requisitarMalha(malhasRequisitadas, "../assets/Modelos3D/" + currentObject.NomeObj);
+                    declarados.push_back(currentObject);
+                } else {
+                    std::cerr << "AVISO: <OBJECT> sem nome especificado." << std::endl;
+                }
+            }
+            inObjectBlock = false;
+        } else if (tag == "</CAMERA>") {
+            inCameraBlock = false;
+        } else if (tag == "</LIGHT>") {
+            inLightBlock = false;
+        } else if (inObjectBlock) {
+            if (tag == "nomeObj") {
+                ss >> currentObject.NomeObj;
+            } else if (tag == "rotacaoX") {
+                ss >> currentObject.rotateX;
+            } else if (tag == "rotacaoY") {
+                ss >> currentObject.rotateY;
+            } else if (tag == "rotacaoZ") {
+                ss >> currentObject.rotateZ;
+            }else if (tag == "trans") {
+                ss >> currentObject.posX >> currentObject.posY >> currentObject.posZ;
+            } else if (tag == "escala") {
+                ss >> currentObject.tamanhoEscala;
+            } else if (tag == "consultaOclusao") {
+                ss >> currentObject.consultaDeOclusao;
+            }
+        } else if (inCameraBlock) {
+            if (tag == "pos") {
+                ss >> cameraPos.x >> cameraPos.y >> cameraPos.z;
+            } else if (tag == "front") {
+                ss >> cameraFront.x >> cameraFront.y >> cameraFront.z;
+            } else if (tag == "up") {
+                ss >> cameraUp.x >> cameraUp.y >> cameraUp.z;
+            } else if (tag == "yaw") {
+                ss >> rotacaoYaw;
+            } else if (tag == "pitch") {
+                ss >> rotaocaoPitch;
+            }
+        } else if (inLightBlock) { // Lendo propriedades da luz
+            if (tag == "pos") {
+                ss >> lightPos.x >> lightPos.y >> lightPos.z;
+            }
+        }
+    }
+
+    configFile.close();
+    marcarFaseInicializacao("leitura da configuracao");
+
+    if (!carregamentoAssincrono) {
+        carregarObjetosDeclarados(declarados, objs);
+        enviarTexturasRequisitadas(objs);
+    }
+}
+
+// Segunda fase do carregamento: espera cada OBJ lido no pool e envia na ordem do arquivo (objs[0] segue a curva)
+void carregarObjetosDeclarados(const std::vector<Object> &declarados, std::vector<Object> &objs)
+{
+    std::unordered_map<std::string, GLuint> vaos; // objetos com o mesmo OBJ compartilham o VAO
+    std::unordered_map<std::string, BuffersMalha> buffers;
+    for (Object obj : declarados)
+    {
+        std::string caminho = "../assets/Modelos3D/" + obj.NomeObj;
+        std::shared_future<MalhaOBJ> leitura = requisitarMalha(malhasRequisitadas, caminho);
+        const MalhaOBJ &malha = leitura.get();
+        if (!malha.valida)
+        {
+            continue;
+        }
+        bool primeiro = !vaos.count(caminho);
+        if (primeiro)
+        {
+            buffers[caminho] = enviarMalha(malha);
+            vaos[caminho] = criarVAOdoOBJ(buffers[caminho].VBO);
+        }
+        obj.VAO = vaos[caminho];
+        usarMalhaProgressiva(obj, buffers[caminho], malha.vBufferProvisorio.size() / 11, leitura, primeiro);
+        obj.nVertices = malha.nVertices;
+        obj.nomeDoMaterial = malha.nomeMaterial;
+        obj.centroLocal = malha.centro;
+        obj.raioLocal = malha.raio;
+        obj.bvhMalha = malha.bvh;
+        obj.oclusor = malha.oclusor;
+        obj.material = malha.material;
+        materiais[malha.nomeMaterial] = malha.material;
+
+        // O upload das texturas acontece em enviarTexturasRequisitadas, depois de todos os objetos
+        std::string caminhoTextura = "../assets/Modelos3D/" + obj.material.textureFile;
+        if (!texturasRequisitadas.count(caminhoTextura)) texturasRequisitadas[caminhoTextura] = malha.textura;
+        obj.texID = 0;
+
+        obj.model = glm::mat4(1.0f);
+        obj.model = glm::translate(obj.model, glm::vec3(obj.posX, obj.posY, obj.posZ));
+        obj.model = glm::scale(obj.model, glm::vec3(obj.tamanhoEscala));
+        objs.push_back(obj);
+    }
+    malhasRequisitadas.clear(); // libera os vértices na CPU
+    marcarFaseInicializacao("espera + upload dos OBJs");
+}
+
+template <typename T, size_t N>
+bool inserirNaFila(FilaSPSC<T, N> &fila, T &item)
+{
+    // Só move o item depois de saber que há lugar: com a fila cheia ele fica intacto para a próxima tentativa
+    size_t cauda = fila.cauda.load(std::memory_order_relaxed);
+    size_t proxima = (cauda + 1) % N;
+    if (proxima == fila.cabeca.load(std::memory_order_acquire))
+    {
+        return false; // cheia
+    }
+    fila.itens[cauda] = std::move(item);
+    fila.cauda.store(proxima, std::memory_order_release); // publica o item para a consumidora
+    return true;
+}
+
+template <typename T, size_t N>
+bool retirarDaFila(FilaSPSC<T, N> &fila, T &item)
+{
+    size_t cabeca = fila.cabeca.load(std::memory_order_relaxed);
+    if (cabeca == fila.cauda.load(std::memory_order_acquire))
+    {
+        return false; // vazia
+    }
+    item = std::move(fila.itens[cabeca]);
+    fila.cabeca.store((cabeca + 1) % N, std::memory_order_release); // devolve a posição para a produtora
+    return true;
+}
+
+void iniciarCarregadorAssincrono(CarregadorAssincrono &carregador, GLFWwindow *janelaPrincipal)
+{
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    carregador.contexto = glfwCreateWindow(1, 1, "carregador", nullptr, janelaPrincipal);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (!carregador.contexto)
+    {
+        std::cout << "Nao foi possivel criar o contexto compartilhado, carregando os objetos na thread principal" << std::endl;
+        carregamentoAssincrono = false;
+        return;
+    }
+    carregador.encerrar = false;
+    carregador.thread = std::thread(threadDoCarregador, &carregador);
+}
+
+void encerrarCarregadorAssincrono(CarregadorAssincrono &carregador)
+{
+    carregador.encerrar = true;
+    if (carregador.thread.joinable()) carregador.thread.join();
+
+    ObjetoCarregado pronto;
+    while (retirarDaFila(carregador.prontos, pronto)) carregador.aguardandoFence.push_back(std::move(pronto));
+    for (ObjetoCarregado &objeto : carregador.aguardandoFence) glDeleteSync(objeto.fence);
+    carregador.aguardandoFence.clear();
+    glfwDestroyWindow(carregador.contexto);
+    carregador.contexto = nullptr;
+}
+
+void carregarObjetoAssincrono(CarregadorAssincrono &carregador, const Object &obj)
+{
+    carregador.pendentes++;
+    Object pedido = obj;
+    while (!inserirNaFila(carregador.pedidos, pedido))
+    {
+        std::this_thread::yield(); // só acontece com mais de 63 pedidos de uma vez
+    }
+}
+
+void threadDoCarregador(CarregadorAssincrono *carregador)
+{
+    glfwMakeContextCurrent(carregador->contexto);
+    // Leituras já pedidas e buffers/texturas já enviados por esta thread (as duas luas usam o mesmo OBJ e a mesma imagem)
+    std::unordered_map<std::string, std::shared_future<MalhaOBJ>> malhas;
+    std::unordered_map<std::string, BuffersMalha> buffersEnviados;
+    std::unordered_map<std::string, Object> texturasEnviadas;
+    std::deque<Object> emPreparo; // pedidos cujos OBJs/texturas estão no pool, na ordem de chegada
+
+    while (!carregador->encerrar)
+    {
+        // Todos os pedidos novos vão para o pool de uma vez
+        Object pedido;
+        while (retirarDaFila(carregador->pedidos, pedido))
+        {
+            requisitarMalha(malhas, "../assets/Modelos3D/" + pedido.NomeObj);
+            emPreparo.push_back(pedido);
+        }
+
+        // Envia na ordem: um objeto só sai depois dos anteriores, mesmo que o pool termine fora de ordem
+        bool enviou = false;
+        while (!emPreparo.empty() && !carregador->encerrar)
+        {
+            Object obj = emPreparo.front();
+            std::string caminho = "../assets/Modelos3D/" + obj.NomeObj;
+            std::shared_future<MalhaOBJ> leitura = malhas[caminho];
+            if (!futuroPronto(leitura)) break;
+            const MalhaOBJ &malha = leitura.get();
+            std::string caminhoTextura = "../assets/Modelos3D/" + malha.material.textureFile;
+            bool texturaEnviada = texturasEnviadas.count(caminhoTextura) > 0;
+            // Se a completa ainda não ficou pronta, o objeto sai com a provisória (1/8) e a troca é feita depois pela thread principal
+            const RequisicaoTextura &requisicao = malha.textura;
+            bool usarProvisoria = malha.valida && !texturaEnviada && !futuroPronto(requisicao.completa) && requisicao.provisoria.valid() &&
+                                  futuroPronto(requisicao.provisoria) && !requisicao.provisoria.get().textura.niveis.empty();
+            if (malha.valida && !texturaEnviada && !futuroPronto(requisicao.completa) && !usarProvisoria) break;
+
+            ObjetoCarregado pronto;
+            obj.nVertices = malha.nVertices;
+            obj.nomeDoMaterial = malha.nomeMaterial;
+            obj.centroLocal = malha.centro;
+            obj.raioLocal = malha.raio;
+            obj.bvhMalha = malha.bvh;
+            obj.oclusor = malha.oclusor;
+            obj.material = malha.material;
+            obj.texID = 0;
+            if (malha.valida)
+            {
+                pronto.iniciarRefinamento = !buffersEnviados.count(caminho);
+                if (pronto.iniciarRefinamento) buffersEnviados[caminho] = enviarMalha(malha);
+                pronto.VBO = buffersEnviados[caminho].VBO;
+                pronto.VBOProvisorio = buffersEnviados[caminho].VBOProvisorio;
+                pronto.nVerticesProvisorio = buffersEnviados[caminho].nVerticesProvisorio;
+                if (pronto.iniciarRefinamento) pronto.malha = leitura;
+            }
+            if (malha.valida && texturaEnviada)
+            {
+                obj.texID = texturasEnviadas[caminhoTextura].texID;
+                obj.TextureimgWidth = texturasEnviadas[caminhoTextura].TextureimgWidth;
+                obj.TextureimgHeight = texturasEnviadas[caminhoTextura].TextureimgHeight;
+            }
+            else if (usarProvisoria)
+            {
+                const TexturaPreparada &provisoria = requisicao.provisoria.get();
+                obj.texID = uploadTextura2D(provisoria.textura);
+                obj.TextureimgWidth = provisoria.textura.niveis[0].largura;
+                obj.TextureimgHeight = provisoria.textura.niveis[0].altura;
+                pronto.texturaCompleta = requisicao.completa;
+                texturasEnviadas[caminhoTextura] = obj;
+            }
+            else if (malha.valida)
+            {
+                const TexturaPreparada &preparada = malha.textura.completa.get();
+                if (!preparada.textura.niveis.empty())
+                {
+                    obj.TextureimgWidth = preparada.textura.niveis[0].largura;
+                    obj.TextureimgHeight = preparada.textura.niveis[0].altura;
+                    if (streamingTexturas)
+                    {
+                        pronto.texturaStreaming = criarTexturaStreaming(preparada.textura, 0);
+                        pronto.temTexturaStreaming = true;
+                        obj.texID = pronto.texturaStreaming.texID;
+                    }
+                    else
+                    {
+                        obj.texID = uploadTextura2D(preparada.textura);
+                    }
+                }
+                else
+                {
+                    std::cout << "Failed to load texture " << caminhoTextura << std::endl;
+                }
+                texturasEnviadas[caminhoTextura] = obj;
+            }
+
+            // A fence marca o fim dos uploads deste objeto; o flush garante que ela chegue à GPU
+            pronto.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+            pronto.objeto = obj;
+            while (!inserirNaFila(carregador->prontos, pronto) && !carregador->encerrar)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            emPreparo.pop_front();
+            enviou = true;
+
+            // Vértices e textura já estão na GPU (e o refinamento guarda a sua cópia da leitura): no mapa fica só o
+            // que os próximos objetos com este OBJ usam, senão todas as malhas ficariam na memória até o fim
+            if (malha.valida && !malha.vBuffer.empty())
+            {
+                MalhaOBJ resumo;
+                resumo.caminho = malha.caminho;
+                resumo.valida = true;
+                resumo.nVertices = malha.nVertices;
+                resumo.nomeMaterial = malha.nomeMaterial;
+                resumo.material = malha.material;
+                resumo.centro = malha.centro;
+                resumo.raio = malha.raio;
+                resumo.msCPU = malha.msCPU;
+                resumo.bvh = malha.bvh;
+                resumo.oclusor = malha.oclusor;
+                std::promise<MalhaOBJ> pronta;
+                pronta.set_value(std::move(resumo));
+                malhas[caminho] = pronta.get_future().share();
+            }
+        }
+        if (!enviou)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    glfwMakeContextCurrent(nullptr);
+}
+
+// Chamada a cada frame: adiciona em objs os objetos cujos uploads já terminaram na GPU, sem bloquear
+void receberObjetosCarregados(CarregadorAssincrono &carregador, std::vector<Object> &objs)
+{
+    ObjetoCarregado pronto;
+    while (retirarDaFila(carregador.prontos, pronto))
+    {
+        carregador.aguardandoFence.push_back(std::move(pronto));
+    }
+
+    // Em ordem: objs[0] continua sendo o primeiro objeto do arquivo (o que percorre a curva)
+    while (!carregador.aguardandoFence.empty())
+    {
+        ObjetoCarregado &objeto = carregador.aguardandoFence.front();
+        GLenum estado = glClientWaitSync(objeto.fence, 0, 0);
+        if (estado != GL_ALREADY_SIGNALED && estado != GL_CONDITION_SATISFIED) break;
+        glDeleteSync(objeto.fence);
+
+        if (objeto.temTexturaStreaming)
+        {
+            texturasStreaming.push_back(std::move(objeto.texturaStreaming));
+        }
+        if (objeto.texturaCompleta.valid())
+        {
+            trocasDeTexturas.push_back({objeto.objeto.texID, GL_TEXTURE_2D, {objeto.texturaCompleta}});
+        }
+        Object obj = objeto.objeto;
+        obj.VAO = objeto.VBO ? criarVAOdoOBJ(objeto.VBO) : 0;
+        if (objeto.VBO)
+        {
+            BuffersMalha buffers;
+            buffers.VBO = objeto.VBO;
+            buffers.VBOProvisorio = objeto.VBOProvisorio;
+            usarMalhaProgressiva(obj, buffers, objeto.nVerticesProvisorio, objeto.malha, objeto.iniciarRefinamento);
+        }
+        obj.model = glm::mat4(1.0f);
+        obj.model = glm::translate(obj.model, glm::vec3(obj.posX, obj.posY, obj.posZ));
+        obj.model = glm::scale(obj.model, glm::vec3(obj.tamanhoEscala));
+        objs.push_back(obj);
+        carregador.aguardandoFence.pop_front();
+        carregador.pendentes--;
+        carregador.adicionados++;
+    }
+}
+// Calcula as matrizes model de todos os objetos em lotes paralelos
+void atualizarTransformacoes(std::vector<Object> &objs, float angulo)
+{
+    executarEmParalelo(0, (int)objs.size(), [&](int i) {
+        Object &obj = objs[i];
+        obj.model = glm::mat4(1.0f);
+        obj.model = glm::translate(obj.model, glm::vec3(obj.posX, obj.posY, obj.posZ));
+        obj.model = obj.model * glm::mat4_cast(obj.orientacao);
+
+        if (obj.rotateX)
+        {
+            obj.model = glm::rotate(obj.model, angulo, glm::vec3(1.0f, 0.0f, 0.0f));
+        }
+        else if (obj.rotateY)
+        {
+            obj.model = glm::rotate(obj.model, angulo, glm::vec3(0.0f, 1.0f, 0.0f));
+        }
+        else if (obj.rotateZ)
+        {
+            obj.model = glm::rotate(obj.model, angulo, glm::vec3(0.0f, 0.0f, 1.0f));
+        }
+
+        obj.model = glm::scale(obj.model, glm::vec3(obj.tamanhoEscala));
+    }, 256);
+}
+
+// Testa a esfera envolvente de cada objeto contra os 6 planos do frustum (extraídos das linhas de projection * view)
+// e marca obj.visivel. Devolve quantos objetos ficaram visíveis
+int cullingPorFrustum(std::vector<Object> &objs, const glm::mat4 &viewProjection)
+{
+    glm::vec4 planos[6];
+    extrairPlanosFrustum(viewProjection, planos);
+
+    std::atomic<int> visiveis{0};
+    executarEmParalelo(0, (int)objs.size(), [&](int i) {
+        Object &obj = objs[i];
+        glm::vec3 centro = glm::vec3(obj.model * glm::vec4(obj.centroLocal, 1.0f));
+        float raio = obj.raioLocal * obj.tamanhoEscala;
+        obj.visivel = true;
+        for (const glm::vec4 &plano : planos)
+        {
+            if (glm::dot(glm::vec3(plano), centro) + plano.w < -raio)
+            {
+                obj.visivel = false;
+                break;
+            }
+        }
+        if (obj.visivel) visiveis++;
+    }, 256);
+    return visiveis;
+}
+
+// Planos do frustum (normais para dentro, normalizados) a partir das linhas de projection * view
+void extrairPlanosFrustum(const glm::mat4 &viewProjection, glm::vec4 planos[6])
+{
+    glm::vec4 linha[4];
+    for (int i = 0; i < 4; i++) linha[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    planos[0] = linha[3] + linha[0];
+    planos[1] = linha[3] - linha[0];
+    planos[2] = linha[3] + linha[1];
+    planos[3] = linha[3] - linha[1];
+    planos[4] = linha[3] + linha[2];
+    planos[5] = linha[3] - linha[2];
+    for (int i = 0; i < 6; i++) planos[i] /= glm::length(glm::vec3(planos[i]));
+}
+
+// Caixa da esfera envolvente do objeto no mundo (a mesma esfera do culling por frustum)
+CaixaEnvolvente caixaDoObjeto(const Object &obj)
+{
+    glm::vec3 centro = glm::vec3(obj.model * glm::vec4(obj.centroLocal, 1.0f));
+    glm::vec3 raio(obj.raioLocal * obj.tamanhoEscala);
+    CaixaEnvolvente caixa;
+    caixa.minimo = centro - raio;
+    caixa.maximo = centro + raio;
+    return caixa;
+}
+
+bool caixaContem(const CaixaEnvolvente &fora, const CaixaEnvolvente &dentro)
+{
+    return fora.minimo.x <= dentro.minimo.x && fora.minimo.y <= dentro.minimo.y && fora.minimo.z <= dentro.minimo.z &&
+           dentro.maximo.x <= fora.maximo.x && dentro.maximo.y <= fora.maximo.y && dentro.maximo.z <= fora.maximo.z;
+}
+
+bool caixasSeTocam(const CaixaEnvolvente &a, const CaixaEnvolvente &b)
+{
+    return a.minimo.x <= b.maximo.x && b.minimo.x <= a.maximo.x && a.minimo.y <= b.maximo.y && b.minimo.y <= a.maximo.y &&
+           a.minimo.z <= b.maximo.z && b.minimo.z <= a.maximo.z;
+}
+
+int alocarNoArvore(ArvoreDinamica &arvore)
+{
+    int indice;
+    if (arvore.livre >= 0)
+    {
+        indice = arvore.livre;
+        arvore.livre = arvore.nos[indice].pai;
+        arvore.nos[indice] = NoArvoreDinamica();
+    }
+    else
+    {
+        indice = (int)arvore.nos.size();
+        arvore.nos.push_back(NoArvoreDinamica());
+    }
+    arvore.nos[indice].altura = 0;
+    return indice;
+}
+
+void liberarNoArvore(ArvoreDinamica &arvore, int indice)
+{
+    arvore.nos[indice].altura = -1;
+    arvore.nos[indice].pai = arvore.livre;
+    arvore.livre = indice;
+}
+
+// Rotação em torno de iA se a diferença de altura entre os filhos passar de 1; devolve o nó que ficou no lugar de iA
+int balancearArvore(ArvoreDinamica &arvore, int iA)
+{
+    std::vector<NoArvoreDinamica> &nos = arvore.nos;
+    NoArvoreDinamica &A = nos[iA];
+    if (A.filho1 < 0 || A.altura < 2) return iA;
+
+    int iB = A.filho1, iC = A.filho2;
+    NoArvoreDinamica &B = nos[iB], &C = nos[iC];
+    int equilibrio = C.altura - B.altura;
+    if (equilibrio > 1 || equilibrio < -1)
+    {
+        // O filho mais alto (P) sobe para o lugar de A; A fica com o outro filho (Q) e com o neto mais baixo de P
+        bool sobeC = equilibrio > 1;
+        int iP = sobeC ? iC : iB, iQ = sobeC ? iB : iC;
+        NoArvoreDinamica &P = nos[iP], &Q = nos[iQ];
+        int iF = P.filho1, iG = P.filho2;
+        P.filho1 = iA;
+        P.pai = A.pai;
+        A.pai = iP;
+        if (P.pai >= 0)
+        {
+            if (nos[P.pai].filho1 == iA) nos[P.pai].filho1 = iP;
+            else nos[P.pai].filho2 = iP;
+        }
+        else
+        {
+            arvore.raiz = iP;
+        }
+        int iAlto = nos[iF].altura > nos[iG].altura ? iF : iG;
+        int iBaixo = iAlto == iF ? iG : iF;
+        P.filho2 = iAlto;
+        if (sobeC) A.filho2 = iBaixo;
+        else A.filho1 = iBaixo;
+        nos[iBaixo].pai = iA;
+        A.caixa = unirCaixas(Q.caixa, nos[iBaixo].caixa);
+        A.altura = 1 + std::max(Q.altura, nos[iBaixo].altura);
+        P.caixa = unirCaixas(A.caixa, nos[iAlto].caixa);
+        P.altura = 1 + std::max(A.altura, nos[iAlto].altura);
+        return iP;
+    }
+    return iA;
+}
+
+// Sobe de i até a raiz rebalanceando e recalculando caixas e alturas
+void reajustarAteARaiz(ArvoreDinamica &arvore, int i)
+{
+    while (i >= 0)
+    {
+        i = balancearArvore(arvore, i);
+        NoArvoreDinamica &no = arvore.nos[i];
+        const NoArvoreDinamica &filho1 = arvore.nos[no.filho1], &filho2 = arvore.nos[no.filho2];
+        no.altura = 1 + std::max(filho1.altura, filho2.altura);
+        no.caixa = unirCaixas(filho1.caixa, filho2.caixa);
+        i = no.pai;
+    }
+}
+
+// Desce escolhendo o lado que menos aumenta a área das caixas (o custo herdado pelos ancestrais entra em todos os
+// caminhos) e para onde criar um irmão novo sai mais barato que descer
+void inserirFolha(ArvoreDinamica &arvore, int folha)
+{
+    std::vector<NoArvoreDinamica> &nos = arvore.nos;
+    if (arvore.raiz < 0)
+    {
+        arvore.raiz = folha;
+        nos[folha].pai = -1;
+        return;
+    }
+
+    CaixaEnvolvente caixaFolha = nos[folha].caixa;
+    int irmao = arvore.raiz;
+    while (nos[irmao].filho1 >= 0)
+    {
+        float area = areaDaCaixa(nos[irmao].caixa);
+        float areaUnida = areaDaCaixa(unirCaixas(nos[irmao].caixa, caixaFolha));
+        float custo = 2.0f * areaUnida;
+        float custoHerdado = 2.0f * (areaUnida - area);
+        float custosFilhos[2];
+        int filhos[2] = {nos[irmao].filho1, nos[irmao].filho2};
+        for (int k = 0; k < 2; k++)
+        {
+            const NoArvoreDinamica &filho = nos[filhos[k]];
+            float unida = areaDaCaixa(unirCaixas(filho.caixa, caixaFolha));
+            custosFilhos[k] = (filho.filho1 < 0 ? unida : unida - areaDaCaixa(filho.caixa)) + custoHerdado;
+        }
+        if (custo < custosFilhos[0] && custo < custosFilhos[1]) break;
+        irmao = custosFilhos[0] < custosFilhos[1] ? filhos[0] : filhos[1];
+    }
+
+    int paiAntigo = nos[irmao].pai;
+    int novoPai = alocarNoArvore(arvore);
+    nos[novoPai].pai = paiAntigo;
+    nos[novoPai].caixa = unirCaixas(nos[irmao].caixa, caixaFolha);
+    nos[novoPai].altura = nos[irmao].altura + 1;
+    if (paiAntigo >= 0)
+    {
+        if (nos[paiAntigo].filho1 == irmao) nos[paiAntigo].filho1 = novoPai;
+        else nos[paiAntigo].filho2 = novoPai;
+    }
+    else
+    {
+        arvore.raiz = novoPai;
+    }
+    nos[novoPai].filho1 = irmao;
+    nos[novoPai].filho2 = folha;
+    nos[irmao].pai = novoPai;
+    nos[folha].pai = novoPai;
+    reajustarAteARaiz(arvore, novoPai);
+}
+
+void removerFolha(ArvoreDinamica &arvore, int folha)
+{
+    std::vector<NoArvoreDinamica> &nos = arvore.nos;
+    if (folha == arvore.raiz)
+    {
+        arvore.raiz = -1;
+        return;
+    }
+    int pai = nos[folha].pai;
+    int avo = nos[pai].pai;
+    int irmao = nos[pai].filho1 == folha ? nos[pai].filho2 : nos[pai].filho1;
+    if (avo >= 0)
+    {
+        if (nos[avo].filho1 == pai) nos[avo].filho1 = irmao;
+        else nos[avo].filho2 = irmao;
+        nos[irmao].pai = avo;
+        liberarNoArvore(arvore, pai);
+        reajustarAteARaiz(arvore, avo);
+    }
+    else
+    {
+        arvore.raiz = irmao;
+        nos[irmao].pai = -1;
+        liberarNoArvore(arvore, pai);
+    }
+}
+
+int inserirNaArvore(ArvoreDinamica &arvore, const CaixaEnvolvente &caixa, int objeto)
+{
+    int folha = alocarNoArvore(arvore);
+    glm::vec3 margem(arvore.margem);
+    arvore.nos[folha].caixa.minimo = caixa.minimo - margem;
+    arvore.nos[folha].caixa.maximo = caixa.maximo + margem;
+    arvore.nos[folha].objeto = objeto;
+    inserirFolha(arvore, folha);
+    return folha;
+}
+
+void removerDaArvore(ArvoreDinamica &arvore, int folha)
+{
+    removerFolha(arvore, folha);
+    liberarNoArvore(arvore, folha);
+}
+
+// Devolve true se a folha precisou ser reinserida (o objeto saiu da caixa gorda)
+bool moverNaArvore(ArvoreDinamica &arvore, int folha, const CaixaEnvolvente &caixa)
+{
+    if (caixaContem(arvore.nos[folha].caixa, caixa)) return false;
+    removerFolha(arvore, folha);
+    glm::vec3 margem(arvore.margem);
+    arvore.nos[folha].caixa.minimo = caixa.minimo - margem;
+    arvore.nos[folha].caixa.maximo = caixa.maximo + margem;
+    inserirFolha(arvore, folha);
+    arvore.reinsercoes++;
+    return true;
+}
+
+int alturaDaArvore(const ArvoreDinamica &arvore)
+{
+    return arvore.raiz >= 0 ? arvore.nos[arvore.raiz].altura : 0;
+}
+
+// funcao(objeto) para cada folha cuja caixa gorda toca a caixa
+template <typename Funcao>
+void consultarCaixaNaArvore(const ArvoreDinamica &arvore, const CaixaEnvolvente &caixa, Funcao funcao)
+{
+    if (arvore.raiz < 0) return;
+    std::vector<int> pilha;
+    pilha.push_back(arvore.raiz);
+    while (!pilha.empty())
+    {
+        const NoArvoreDinamica &no = arvore.nos[pilha.back()];
+        pilha.pop_back();
+        if (!caixasSeTocam(no.caixa, caixa)) continue;
+        if (no.filho1 < 0)
+        {
+            funcao(no.objeto);
+        }
+        else
+        {
+            pilha.push_back(no.filho1);
+            pilha.push_back(no.filho2);
+        }
+    }
+}
+
+// funcao(objeto, entrada) para cada folha atingida pelo raio antes de distanciaMaxima; o valor devolvido pela função
+// vira o novo limite (devolver a distância do acerto no objeto faz a busca parar nos mais próximos)
+template <typename Funcao>
+void consultarRaioNaArvore(const ArvoreDinamica &arvore, glm::vec3 origem, glm::vec3 direcao, float distanciaMaxima, Funcao funcao)
+{
+    if (arvore.raiz < 0) return;
+    glm::vec3 inversoDirecao = inversoDaDirecao(glm::normalize(direcao));
+    std::vector<int> pilha;
+    pilha.push_back(arvore.raiz);
+    while (!pilha.empty())
+    {
+        const NoArvoreDinamica &no = arvore.nos[pilha.back()];
+        pilha.pop_back();
+        float entrada;
+        if (!raioNaCaixa(no.caixa, origem, inversoDirecao, distanciaMaxima, entrada)) continue;
+        if (no.filho1 < 0)
+        {
+            distanciaMaxima = std::min(distanciaMaxima, (float)funcao(no.objeto, entrada));
+        }
+        else
+        {
+            pilha.push_back(no.filho1);
+            pilha.push_back(no.filho2);
+        }
+    }
+}
+
+// funcao(objeto, inteiroDentro) para cada folha que não está inteira fora de algum plano. Uma subárvore inteira dentro
+// do frustum é entregue sem mais testes (inteiroDentro = true)
+template <typename Funcao>
+void consultarFrustumNaArvore(const ArvoreDinamica &arvore, const glm::vec4 planos[6], Funcao funcao)
+{
+    if (arvore.raiz < 0) return;
+    std::vector<std::pair<int, bool>> pilha;
+    pilha.push_back({arvore.raiz, false});
+    while (!pilha.empty())
+    {
+        int indice = pilha.back().first;
+        bool dentro = pilha.back().second;
+        pilha.pop_back();
+        const NoArvoreDinamica &no = arvore.nos[indice];
+        if (!dentro)
+        {
+            dentro = true;
+            bool fora = false;
+            for (int p = 0; p < 6 && !fora; p++)
+            {
+                glm::vec3 normal = glm::vec3(planos[p]);
+                glm::vec3 positivo(normal.x >= 0.0f ? no.caixa.maximo.x : no.caixa.minimo.x, normal.y >= 0.0f ? no.caixa.maximo.y : no.caixa.minimo.y, normal.z >= 0.0f ? no.caixa.maximo.z : no.caixa.minimo.z);
+                glm::vec3 negativo(normal.x >= 0.0f ? no.caixa.minimo.x : no.caixa.maximo.x, normal.y >= 0.0f ? no.caixa.minimo.y : no.caixa.maximo.y, normal.z >= 0.0f ? no.caixa.minimo.z : no.caixa.maximo.z);
+                if (glm::dot(normal, positivo) + planos[p].w < 0.0f) fora = true;
+                else if (glm::dot(normal, negativo) + planos[p].w < 0.0f) dentro = false;
+            }
+            if (fora) continue;
+        }
+        if (no.filho1 < 0)
+        {
+            funcao(no.objeto, dentro);
+        }
+        else
+        {
+            pilha.push_back({no.filho1, dentro});
+            pilha.push_back({no.filho2, dentro});
+        }
+    }
+}
+
+// Insere os objetos novos e move os que já estão na árvore. Os estáticos nunca saem da caixa gorda e custam só o teste
+// de contenção; o objeto da curva e os que giram em torno de um centro fora da origem são reinseridos de vez em quando
+void atualizarArvoreCena(ArvoreDinamica &arvore, std::vector<Object> &objs)
+{
+    // O teste de contenção roda em paralelo (só lê a árvore); as reinserções, poucas, ficam na thread atual
+    std::vector<char> saiu(objs.size());
+    executarEmParalelo(0, (int)objs.size(), [&](int i) {
+        const Object &obj = objs[i];
+        saiu[i] = obj.folhaArvore < 0 || !caixaContem(arvore.nos[obj.folhaArvore].caixa, caixaDoObjeto(obj));
+    }, 1024);
+    for (size_t i = 0; i < objs.size(); i++)
+    {
+        if (!saiu[i]) continue;
+        Object &obj = objs[i];
+        if (obj.folhaArvore < 0)
+        {
+            obj.folhaArvore = inserirNaArvore(arvore, caixaDoObjeto(obj), (int)i);
+        }
+        else
+        {
+            moverNaArvore(arvore, obj.folhaArvore, caixaDoObjeto(obj));
+        }
+    }
+}
+
+// Culling pela árvore: subárvores fora do frustum são descartadas de uma vez, as inteiras dentro são aceitas sem
+// teste, e só as folhas na borda testam a esfera do objeto como em cullingPorFrustum
+int cullingNaArvore(std::vector<Object> &objs, const ArvoreDinamica &arvore, const glm::mat4 &viewProjection)
+{
+    glm::vec4 planos[6];
+    extrairPlanosFrustum(viewProjection, planos);
+    for (Object &obj : objs) obj.visivel = false;
+    int visiveis = 0;
+    consultarFrustumNaArvore(arvore, planos, [&](int indice, bool inteiroDentro) {
+        Object &obj = objs[indice];
+        if (!inteiroDentro)
+        {
+            glm::vec3 centro = glm::vec3(obj.model * glm::vec4(obj.centroLocal, 1.0f));
+            float raio = obj.raioLocal * obj.tamanhoEscala;
+            for (int p = 0; p < 6; p++)
+            {
+                if (glm::dot(glm::vec3(planos[p]), centro) + planos[p].w < -raio) return;
+            }
+        }
+        obj.visivel = true;
+        visiveis++;
+    });
+    return visiveis;
+}
+
+// O raio vai até a folha de cada objeto pela árvore da cena e então, já no espaço do modelo, pela BVH da malha. A
+// direção local não é normalizada, então a distância devolvida pela malha continua em unidades do mundo
+ResultadoSelecao selecionarPorRaio(const std::vector<Object> &objs, const ArvoreDinamica &arvore, glm::vec3 origem, glm::vec3 direcao)
+{
+    auto inicio = std::chrono::steady_clock::now();
+    ResultadoSelecao resultado;
+    direcao = glm::normalize(direcao);
+    consultarRaioNaArvore(arvore, origem, direcao, 1e30f, [&](int indice, float entrada) {
+        // A folha pode ter sido atingida antes de a busca encolher; se a caixa começa depois do melhor acerto, nem inverte a model
+        if (entrada > resultado.distancia) return resultado.distancia;
+        const Object &obj = objs[indice];
+        if (!obj.bvhMalha) return resultado.distancia;
+        glm::mat4 inversa = glm::inverse(obj.model);
+        glm::vec3 origemLocal = glm::vec3(inversa * glm::vec4(origem, 1.0f));
+        glm::vec3 direcaoLocal = glm::vec3(inversa * glm::vec4(direcao, 0.0f));
+        resultado.objetosTestados++;
+        int triangulo = raioNaMalha(*obj.bvhMalha, origemLocal, direcaoLocal, resultado.distancia);
+        if (triangulo >= 0)
+        {
+            resultado.objeto = indice;
+            resultado.triangulo = triangulo;
+        }
+        return resultado.distancia;
+    });
+    resultado.microssegundos = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - inicio).count();
+    return resultado;
+}
+
+// Raio do olho passando pelo pixel (x, y) da janela, desprojetando os planos near e far
+void raioDoCursor(double x, double y, int largura, int altura, const glm::mat4 &viewProjection, glm::vec3 &origem, glm::vec3 &direcao)
+{
+    float ndcX = (float)(2.0 * x / largura - 1.0), ndcY = (float)(1.0 - 2.0 * y / altura);
+    glm::mat4 inversa = glm::inverse(viewProjection);
+    glm::vec4 perto = inversa * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+    glm::vec4 longe = inversa * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+    origem = glm::vec3(perto) / perto.w;
+    direcao = glm::normalize(glm::vec3(longe) / longe.w - origem);
+}
+
+inline uint64_t chaveDoPar(int a, int b)
+{
+    if (a > b) std::swap(a, b);
+    return ((uint64_t)(uint32_t)a << 32) | (uint32_t)b;
+}
+
+// Ordenação por inserção de um eixo. Só as trocas entre o início de um corpo e o fim de outro mudam os pares: um início
+// passando para antes de um fim pode criar sobreposição (confirmada nos 3 eixos), e um fim passando para antes de um
+// início separa os dois. Os eixos são ordenados em x, y, z; se as caixas também se separaram num eixo que ainda vai ser
+// ordenado, o par é removido lá e nem precisa ser procurado aqui
+void ordenarEixoSAP(SistemaDeColisao &sistema, std::vector<ExtremoSAP> &eixo, int indiceEixo)
+{
+    for (size_t i = 1; i < eixo.size(); i++)
+    {
+        ExtremoSAP extremo = eixo[i];
+        size_t j = i;
+        while (j > 0 && eixo[j - 1].valor > extremo.valor)
+        {
+            const ExtremoSAP &outro = eixo[j - 1];
+            if (extremo.minimo && !outro.minimo)
+            {
+                if (caixasSeTocam(sistema.caixas[extremo.corpo], sistema.caixas[outro.corpo])) sistema.pares.emplace(chaveDoPar(extremo.corpo, outro.corpo), false);
+            }
+            else if (!extremo.minimo && outro.minimo)
+            {
+                const CaixaEnvolvente &a = sistema.caixas[extremo.corpo], &b = sistema.caixas[outro.corpo];
+                bool tocamNosSeguintes = true;
+                for (int e = indiceEixo + 1; e < 3; e++) tocamNosSeguintes = tocamNosSeguintes && a.minimo[e] <= b.maximo[e] && b.minimo[e] <= a.maximo[e];
+                auto par = tocamNosSeguintes ? sistema.pares.find(chaveDoPar(extremo.corpo, outro.corpo)) : sistema.pares.end();
+                if (par != sistema.pares.end())
+                {
+                    if (par->second && sistema.aoContato)
+                    {
+                        ContatoColisao contato;
+                        contato.a = std::min(extremo.corpo, outro.corpo);
+                        contato.b = std::max(extremo.corpo, outro.corpo);
+                        contato.normal = glm::vec3(0.0f);
+                        contato.penetracao = 0.0f;
+                        contato.comecou = false;
+                        sistema.aoContato(contato);
+                    }
+                    sistema.pares.erase(par);
+                }
+            }
+            eixo[j] = outro;
+            j--;
+            sistema.trocas++;
+        }
+        eixo[j] = extremo;
+    }
+}
+
+// Reordena os eixos do zero e refaz os pares varrendo o eixo x com a lista dos corpos abertos, mantendo o estado de
+// contato dos pares que continuam. Usado quando muitos corpos entram de uma vez (para a ordenação por inserção seria
+// quadrático)
+void reconstruirSAP(SistemaDeColisao &sistema)
+{
+    for (int e = 0; e < 3; e++)
+    {
+        std::sort(sistema.eixos[e].begin(), sistema.eixos[e].end(), [](const ExtremoSAP &a, const ExtremoSAP &b) { return a.valor < b.valor; });
+    }
+    std::unordered_map<uint64_t, bool> pares;
+    pares.reserve(sistema.pares.size());
+    std::vector<int> abertos, posicaoAberto(sistema.caixas.size(), -1);
+    for (const ExtremoSAP &extremo : sistema.eixos[0])
+    {
+        if (!extremo.minimo)
+        {
+            int posicao = posicaoAberto[extremo.corpo];
+            posicaoAberto[abertos.back()] = posicao;
+            abertos[posicao] = abertos.back();
+            abertos.pop_back();
+            continue;
+        }
+        for (int outro : abertos)
+        {
+            if (!caixasSeTocam(sistema.caixas[extremo.corpo], sistema.caixas[outro])) continue;
+            uint64_t chave = chaveDoPar(extremo.corpo, outro);
+            auto antigo = sistema.pares.find(chave);
+            pares.emplace(chave, antigo != sistema.pares.end() && antigo->second);
+        }
+        posicaoAberto[extremo.corpo] = (int)abertos.size();
+        abertos.push_back(extremo.corpo);
+    }
+    for (const auto &par : sistema.pares)
+    {
+        if (!par.second || !sistema.aoContato || pares.count(par.first)) continue;
+        ContatoColisao contato;
+        contato.a = (int)(par.first >> 32);
+        contato.b = (int)(par.first & 0xffffffffu);
+        contato.normal = glm::vec3(0.0f);
+        contato.penetracao = 0.0f;
+        contato.comecou = false;
+        sistema.aoContato(contato);
+    }
+    sistema.pares.swap(pares);
+}
+
+// Uma chamada por frame, depois de atualizarTransformacoes. Poucos objetos novos entram no fim dos eixos e a própria
+// ordenação os leva ao lugar (gerando os pares com quem já estava lá); muitos de uma vez passam por reconstruirSAP
+void atualizarColisoes(SistemaDeColisao &sistema, const std::vector<Object> &objs)
+{
+    auto inicio = std::chrono::steady_clock::now();
+    int corposAntes = (int)sistema.caixas.size();
+    int corpos = (int)objs.size();
+    sistema.caixas.resize(corpos);
+    sistema.esferas.resize(corpos);
+    executarEmParalelo(0, corpos, [&](int i) {
+        const Object &obj = objs[i];
+        sistema.caixas[i] = caixaDoObjeto(obj);
+        sistema.esferas[i] = glm::vec4(glm::vec3(obj.model * glm::vec4(obj.centroLocal, 1.0f)), obj.raioLocal * obj.tamanhoEscala);
+    }, 1024);
+
+    sistema.trocas = 0;
+    bool reconstruir = corpos - corposAntes > 64;
+    for (int e = 0; e < 3; e++)
+    {
+        std::vector<ExtremoSAP> &eixo = sistema.eixos[e];
+        for (int i = corposAntes; i < corpos; i++)
+        {
+            eixo.push_back({1e30f, i, true});
+            eixo.push_back({1e30f, i, false});
+        }
+        for (ExtremoSAP &extremo : eixo)
+        {
+            const CaixaEnvolvente &caixa = sistema.caixas[extremo.corpo];
+            extremo.valor = extremo.minimo ? caixa.minimo[e] : caixa.maximo[e];
+        }
+        if (!reconstruir) ordenarEixoSAP(sistema, eixo, e);
+    }
+    if (reconstruir) reconstruirSAP(sistema);
+
+    // Fase estreita: esferas dos pares que sobraram
+    for (auto &par : sistema.pares)
+    {
+        int a = (int)(par.first >> 32), b = (int)(par.first & 0xffffffffu);
+        glm::vec3 entre = glm::vec3(sistema.esferas[b]) - glm::vec3(sistema.esferas[a]);
+        float soma = sistema.esferas[a].w + sistema.esferas[b].w;
+        float distanciaQuadrada = glm::dot(entre, entre);
+        bool tocando = distanciaQuadrada <= soma * soma;
+        if (tocando == par.second) continue;
+        par.second = tocando;
+        if (!sistema.aoContato) continue;
+        ContatoColisao contato;
+        contato.a = a;
+        contato.b = b;
+        float distancia = std::sqrt(distanciaQuadrada);
+        contato.normal = distancia > 0.0f ? entre / distancia : glm::vec3(0.0f, 1.0f, 0.0f);
+        contato.penetracao = tocando ? soma - distancia : 0.0f;
+        contato.comecou = tocando;
+        sistema.aoContato(contato);
+    }
+    sistema.msUltimoFrame = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - inicio).count();
+}
+
+// Projeta os triângulos [inicio, fim) do oclusor com a matriz model * view * projection. Triângulos que cruzam o plano
+// near são descartados (um oclusor a menos só deixa o culling menos agressivo, nunca errado)
+void projetarOclusor(const std::vector<glm::vec3> &vertices, const glm::mat4 &mvp, size_t inicio, size_t fim, std::vector<TrianguloOclusor> &saida)
+{
+    const float L = (float)BufferOclusao::LARGURA, A = (float)BufferOclusao::ALTURA;
+    for (size_t v = inicio * 3; v < fim * 3; v += 3)
+    {
+        TrianguloOclusor t;
+        bool cruzaNear = false;
+        for (int k = 0; k < 3; k++)
+        {
+            glm::vec4 clip = mvp * glm::vec4(vertices[v + k], 1.0f);
+            if (clip.w <= 1e-5f || clip.z < -clip.w)
+            {
+                cruzaNear = true;
+                break;
+            }
+            t.x[k] = (clip.x / clip.w * 0.5f + 0.5f) * L;
+            t.y[k] = (clip.y / clip.w * 0.5f + 0.5f) * A;
+            t.z[k] = clip.z / clip.w * 0.5f + 0.5f;
+        }
+        if (cruzaNear) continue;
+        float area = (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+        if (std::fabs(area) < 1e-8f) continue;
+        if (area < 0.0f) // os dois lados desenham: só acerta a ordem dos vértices
+        {
+            std::swap(t.x[1], t.x[2]);
+            std::swap(t.y[1], t.y[2]);
+            std::swap(t.z[1], t.z[2]);
+        }
+        // Pixels cujo centro cai na caixa do triângulo; a maioria dos triângulos de uma malha detalhada não cobre nenhum
+        t.xMinimo = std::max(0, (int)std::ceil(std::min(std::min(t.x[0], t.x[1]), t.x[2]) - 0.5f));
+        t.xMaximo = std::min(BufferOclusao::LARGURA - 1, (int)std::floor(std::max(std::max(t.x[0], t.x[1]), t.x[2]) - 0.5f));
+        t.yMinimo = std::max(0, (int)std::ceil(std::min(std::min(t.y[0], t.y[1]), t.y[2]) - 0.5f));
+        t.yMaximo = std::min(BufferOclusao::ALTURA - 1, (int)std::floor(std::max(std::max(t.y[0], t.y[1]), t.y[2]) - 0.5f));
+        if (t.xMinimo > t.xMaximo || t.yMinimo > t.yMaximo) continue;
+        saida.push_back(t);
+    }
+}
+
+// Rasteriza todos os triângulos no bloco (funções de aresta avaliadas no centro dos pixels, 4 por vez com SSE2) e monta
+// a parte da pirâmide que cabe dentro dele
+void rasterizarBlocoOclusao(BufferOclusao &buffer, int bloco)
+{
+    const int L = BufferOclusao::LARGURA, B = BufferOclusao::BLOCO;
+    int bx = (bloco % (L / B)) * B, by = (bloco / (L / B)) * B;
+    float *profundidade = buffer.maximo[0].data();
+    for (int y = by; y < by + B; y++) std::fill(profundidade + y * L + bx, profundidade + y * L + bx + B, 1.0f);
+
+    for (int indice : buffer.triangulosDoBloco[bloco])
+    {
+        const TrianguloOclusor &t = buffer.triangulos[indice];
+        int x0 = std::max(t.xMinimo, bx) & ~3, x1 = std::min(t.xMaximo, bx + B - 1);
+        int y0 = std::max(t.yMinimo, by), y1 = std::min(t.yMaximo, by + B - 1);
+        if (x0 > x1 || y0 > y1) continue;
+        // Aresta k oposta ao vértice k: e(p) = a * p.x + b * p.y + c, positiva dentro
+        float a[3], b[3], c[3];
+        for (int k = 0; k < 3; k++)
+        {
+            int i = (k + 1) % 3, j = (k + 2) % 3;
+            a[k] = -(t.y[j] - t.y[i]);
+            b[k] = t.x[j] - t.x[i];
+            c[k] = -(a[k] * t.x[i] + b[k] * t.y[i]);
+        }
+        float inversoArea = 1.0f / (a[0] * t.x[0] + b[0] * t.y[0] + c[0]);
+#ifdef MIPMAP_SSE2
+        __m128 deslocamentos = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        __m128 zero = _mm_setzero_ps();
+        for (int y = y0; y <= y1; y++)
+        {
+            float py = y + 0.5f;
+            for (int x = x0; x <= x1; x += 4)
+            {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), deslocamentos);
+                __m128 e[3];
+                for (int k = 0; k < 3; k++) e[k] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[k]), px), _mm_set1_ps(b[k] * py + c[k]));
+                __m128 dentro = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e[0], zero), _mm_cmpge_ps(e[1], zero)), _mm_cmpge_ps(e[2], zero));
+                if (_mm_movemask_ps(dentro) == 0) continue;
+                __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e[0], _mm_set1_ps(t.z[0])), _mm_mul_ps(e[1], _mm_set1_ps(t.z[1]))), _mm_mul_ps(e[2], _mm_set1_ps(t.z[2])));
+                z = _mm_mul_ps(z, _mm_set1_ps(inversoArea));
+                float *destino = profundidade + y * L + x;
+                __m128 antigo = _mm_loadu_ps(destino);
+                _mm_storeu_ps(destino, _mm_or_ps(_mm_and_ps(dentro, _mm_min_ps(antigo, z)), _mm_andnot_ps(dentro, antigo)));
+            }
+        }
+#else
+        for (int y = y0; y <= y1; y++)
+        {
+            float py = y + 0.5f;
+            for (int x = x0; x <= x1; x++)
+            {
+                float px = x + 0.5f;
+                float e0 = a[0] * px + b[0] * py + c[0], e1 = a[1] * px + b[1] * py + c[1], e2 = a[2] * px + b[2] * py + c[2];
+                if (e0 < 0.0f || e1 < 0.0f || e2 < 0.0f) continue;
+                float z = (e0 * t.z[0] + e1 * t.z[1] + e2 * t.z[2]) * inversoArea;
+                profundidade[y * L + x] = std::min(profundidade[y * L + x], z);
+            }
+        }
+#endif
+    }
+
+    // Pirâmide dentro do bloco: cada texel fica com o maior e o menor dos 4 de baixo
+    for (int n = 1; n < BufferOclusao::NIVEIS && (B >> n) > 0; n++)
+    {
+        int largura = L >> n, larguraAbaixo = L >> (n - 1);
+        const float *maximoAbaixo = buffer.maximo[n - 1].data();
+        const float *minimoAbaixo = n == 1 ? maximoAbaixo : buffer.minimo[n - 1].data();
+        for (int y = by >> n; y < (by + B) >> n; y++)
+        {
+            for (int x = bx >> n; x < (bx + B) >> n; x++)
+            {
+                int i = 2 * y * larguraAbaixo + 2 * x;
+                buffer.maximo[n][y * largura + x] = std::max(std::max(maximoAbaixo[i], maximoAbaixo[i + 1]),
+                                                             std::max(maximoAbaixo[i + larguraAbaixo], maximoAbaixo[i + larguraAbaixo + 1]));
+                buffer.minimo[n][y * largura + x] = std::min(std::min(minimoAbaixo[i], minimoAbaixo[i + 1]),
+                                                             std::min(minimoAbaixo[i + larguraAbaixo], minimoAbaixo[i + larguraAbaixo + 1]));
+            }
+        }
+    }
+}
+
+// A caixa está atrás de tudo o que foi rasterizado na região que ela cobre? Usa o nível em que a região cabe em 2x2
+// texels; se der dúvida, o nível de baixo (até 4x4) decide, a não ser que a caixa esteja toda na frente dos oclusores
+bool caixaOculta(const BufferOclusao &buffer, const CaixaEnvolvente &caixa, const glm::mat4 &viewProjection)
+{
+    float xMinimo = 1e30f, xMaximo = -1e30f, yMinimo = 1e30f, yMaximo = -1e30f, zMinimo = 1e30f, zMaximo = -1e30f;
+    for (int k = 0; k < 8; k++)
+    {
+        glm::vec3 canto((k & 1) ? caixa.maximo.x : caixa.minimo.x, (k & 2) ? caixa.maximo.y : caixa.minimo.y, (k & 4) ? caixa.maximo.z : caixa.minimo.z);
+        glm::vec4 clip = viewProjection * glm::vec4(canto, 1.0f);
+        if (clip.w <= 1e-5f || clip.z < -clip.w) return false; // cruza o plano near
+        float x = (clip.x / clip.w * 0.5f + 0.5f) * BufferOclusao::LARGURA, y = (clip.y / clip.w * 0.5f + 0.5f) * BufferOclusao::ALTURA;
+        float z = clip.z / clip.w * 0.5f + 0.5f;
+        xMinimo = std::min(xMinimo, x); xMaximo = std::max(xMaximo, x);
+        yMinimo = std::min(yMinimo, y); yMaximo = std::max(yMaximo, y);
+        zMinimo = std::min(zMinimo, z); zMaximo = std::max(zMaximo, z);
+    }
+    if (xMaximo < 0.0f || yMaximo < 0.0f || xMinimo >= BufferOclusao::LARGURA || yMinimo >= BufferOclusao::ALTURA) return false;
+    int x0 = std::max(0, (int)xMinimo), x1 = std::min(BufferOclusao::LARGURA - 1, (int)xMaximo);
+    int y0 = std::max(0, (int)yMinimo), y1 = std::min(BufferOclusao::ALTURA - 1, (int)yMaximo);
+
+    int nivel = 0;
+    while (nivel < BufferOclusao::NIVEIS - 1 && ((x1 >> nivel) - (x0 >> nivel) > 1 || (y1 >> nivel) - (y0 >> nivel) > 1)) nivel++;
+    auto regiao = [&](int n, float &maisLonge, float &maisPerto) {
+        int largura = BufferOclusao::LARGURA >> n;
+        const std::vector<float> &minimo = n == 0 ? buffer.maximo[0] : buffer.minimo[n];
+        maisLonge = 0.0f;
+        maisPerto = 1.0f;
+        for (int y = y0 >> n; y <= y1 >> n; y++)
+        {
+            for (int x = x0 >> n; x <= x1 >> n; x++)
+            {
+                maisLonge = std::max(maisLonge, buffer.maximo[n][y * largura + x]);
+                maisPerto = std::min(maisPerto, minimo[y * largura + x]);
+            }
+        }
+    };
+    float maisLonge, maisPerto;
+    regiao(nivel, maisLonge, maisPerto);
+    if (zMinimo > maisLonge) return true;
+    if (zMaximo <= maisPerto || nivel == 0) return false;
+    regiao(nivel - 1, maisLonge, maisPerto);
+    return zMinimo > maisLonge;
+}
+
+// Depois do culling por frustum: escolhe os oclusores, rasteriza os blocos do buffer no sistema de jobs e testa os
+// objetos que continuam visíveis. Devolve quantos ficaram ocultos
+int cullingPorOclusao(BufferOclusao &buffer, std::vector<Object> &objs, const glm::mat4 &viewProjection)
+{
+    auto inicio = std::chrono::steady_clock::now();
+    if (buffer.maximo[0].empty())
+    {
+        for (int n = 0; n < BufferOclusao::NIVEIS; n++)
+        {
+            buffer.maximo[n].assign((BufferOclusao::LARGURA >> n) * (BufferOclusao::ALTURA >> n), 1.0f);
+            if (n > 0) buffer.minimo[n].assign((BufferOclusao::LARGURA >> n) * (BufferOclusao::ALTURA >> n), 1.0f);
+        }
+    }
+
+    // Oclusores: os maiores na tela (raio / w do centro)
+    std::vector<std::pair<float, int>> candidatos;
+    for (size_t i = 0; i < objs.size(); i++)
+    {
+        const Object &obj = objs[i];
+        if (!obj.visivel || !obj.oclusor || obj.oclusor->empty()) continue;
+        glm::vec4 centro = viewProjection * obj.model * glm::vec4(obj.centroLocal, 1.0f);
+        if (centro.w <= 1e-5f) continue;
+        float tamanho = obj.raioLocal * obj.tamanhoEscala / centro.w;
+        if (tamanho >= tamanhoMinimoOclusor) candidatos.push_back({tamanho, (int)i});
+    }
+    std::sort(candidatos.begin(), candidatos.end(), [](const std::pair<float, int> &a, const std::pair<float, int> &b) { return a.first > b.first; });
+    if ((int)candidatos.size() > maximoOclusores) candidatos.resize(maximoOclusores);
+    buffer.oclusores.clear();
+    buffer.triangulos.clear();
+    for (std::vector<int> &lista : buffer.triangulosDoBloco) lista.clear();
+
+    // Projeção em lotes de triângulos no sistema de jobs; depois cada triângulo vai para a lista dos blocos que ele toca
+    const size_t TRIANGULOS_POR_LOTE = 4096;
+    struct LoteOclusor
+    {
+        int objeto;
+        size_t inicio, fim;
+        glm::mat4 mvp;
+    };
+    std::vector<LoteOclusor> lotes;
+    for (const auto &candidato : candidatos)
+    {
+        const Object &obj = objs[candidato.second];
+        buffer.oclusores.push_back(candidato.second);
+        size_t triangulos = obj.oclusor->size() / 3;
+        for (size_t inicio = 0; inicio < triangulos; inicio += TRIANGULOS_POR_LOTE)
+        {
+            lotes.push_back({candidato.second, inicio, std::min(triangulos, inicio + TRIANGULOS_POR_LOTE), viewProjection * obj.model});
+        }
+    }
+    std::vector<std::vector<TrianguloOclusor>> projetados(lotes.size());
+    executarEmParalelo(0, (int)lotes.size(), [&](int i) {
+        const LoteOclusor &lote = lotes[i];
+        projetarOclusor(*objs[lote.objeto].oclusor, lote.mvp, lote.inicio, lote.fim, projetados[i]);
+    }, 1);
+    for (const std::vector<TrianguloOclusor> &lote : projetados)
+    {
+        for (const TrianguloOclusor &t : lote)
+        {
+            int indice = (int)buffer.triangulos.size();
+            buffer.triangulos.push_back(t);
+            for (int by = t.yMinimo / BufferOclusao::BLOCO; by <= t.yMaximo / BufferOclusao::BLOCO; by++)
+            {
+                for (int bx = t.xMinimo / BufferOclusao::BLOCO; bx <= t.xMaximo / BufferOclusao::BLOCO; bx++)
+                {
+                    buffer.triangulosDoBloco[by * (BufferOclusao::LARGURA / BufferOclusao::BLOCO) + bx].push_back(indice);
+                }
+            }
+        }
+    }
+
+    buffer.ocultos = 0;
+    if (!buffer.triangulos.empty())
+    {
+        const int blocos = (BufferOclusao::LARGURA / BufferOclusao::BLOCO) * (BufferOclusao::ALTURA / BufferOclusao::BLOCO);
+        executarEmParalelo(0, blocos, [&buffer](int bloco) { rasterizarBlocoOclusao(buffer, bloco); }, 1);
+        // Níveis menores que um bloco
+        for (int n = 1; n < BufferOclusao::NIVEIS; n++)
+        {
+            if ((BufferOclusao::BLOCO >> n) > 0) continue;
+            int largura = BufferOclusao::LARGURA >> n, altura = BufferOclusao::ALTURA >> n, larguraAbaixo = largura * 2;
+            for (int y = 0; y < altura; y++)
+            {
+                for (int x = 0; x < largura; x++)
+                {
+                    int i = 2 * y * larguraAbaixo + 2 * x;
+                    const std::vector<float> &ma = buffer.maximo[n - 1], &mi = buffer.minimo[n - 1];
+                    buffer.maximo[n][y * largura + x] = std::max(std::max(ma[i], ma[i + 1]), std::max(ma[i + larguraAbaixo], ma[i + larguraAbaixo + 1]));
+                    buffer.minimo[n][y * largura + x] = std::min(std::min(mi[i], mi[i + 1]), std::min(mi[i + larguraAbaixo], mi[i + larguraAbaixo + 1]));
+                }
+            }
+        }
+
+        std::atomic<int> ocultos{0};
+        executarEmParalelo(0, (int)objs.size(), [&](int i) {
+            Object &obj = objs[i];
+            if (!obj.visivel || !caixaOculta(buffer, caixaDoObjeto(obj), viewProjection)) return;
+            obj.visivel = false;
+            ocultos++;
+        }, 256);
+        buffer.ocultos = ocultos;
+    }
+    buffer.msUltimoFrame = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - inicio).count();
+    return buffer.ocultos;
+}
+
+// Sistema de jobs dos benchmarks: um worker por núcleo além da thread principal. Retorna o número de núcleos
+int iniciarJobsDoBenchmark()
+{
+    int nucleos = std::max(1, (int)std::thread::hardware_concurrency());
+    iniciarSistemaDeJobs(sistemaDeJobs, nucleos - 1);
+    return nucleos;
+}
+
+// Gerador congruente linear dos benchmarks (o mesmo resultado em toda execução)
+unsigned avancarSemente(unsigned &semente)
+{
+    semente = semente * 1664525u + 1013904223u;
+    return semente;
+}
+
+// Número entre 0 e 1
+float aleatorioBenchmark(unsigned &semente)
+{
+    return (avancarSemente(semente) >> 8) / 16777216.0f;
+}
+
+template <typename Funcao> double medirMilissegundos(Funcao funcao)
+{
+    auto inicio = std::chrono::steady_clock::now();
+    funcao();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - inicio).count();
+}
+
+// --bench-jobs: mede o sistema de jobs com 1, 2, 4... workers até o número de núcleos, sem abrir janela.
+// Cada rodada recria o sistema, então os tempos incluem só o trabalho e não a criação das threads
+int executarBenchmarkJobs()
+{
+    int nucleos = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<int> participantes;
+    for (int n = 1; n < nucleos; n *= 2) participantes.push_back(n);
+    participantes.push_back(nucleos);
+
+    Curve curva;
+    curva.toleranciaPlanicidade = 0.0f; // numPoints fixos: o trabalho por segmento é o mesmo em todas as rodadas
+    for (int i = 0; i < 64; i++) curva.controlPoints.push_back(glm::vec3(std::cos(i * 0.4f) * 10.0f, std::sin(i * 0.7f) * 3.0f, std::sin(i * 0.4f) * 10.0f));
+
+    std::vector<Object> objetos(200000);
+    for (size_t i = 0; i < objetos.size(); i++)
+    {
+        objetos[i].posX = (float)(i % 100) - 50.0f;
+        objetos[i].posY = (float)((i / 100) % 20) - 10.0f;
+        objetos[i].posZ = -(float)(i / 2000);
+        objetos[i].rotateY = i % 2 == 0;
+    }
+    glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+
+    double base[3] = {0.0, 0.0, 0.0};
+    cout << "Benchmark do sistema de jobs (" << nucleos << " nucleos)" << endl;
+    for (int n : participantes)
+    {
+        iniciarSistemaDeJobs(sistemaDeJobs, n - 1); // a thread principal é o n-ésimo participante
+        double tempos[3];
+        tempos[0] = medirMilissegundos([&]() {
+            for (int r = 0; r < 5; r++) generateCatmullRomCurvePoints(curva, 20000);
+        });
+        int visiveis = 0;
+        tempos[1] = medirMilissegundos([&]() {
+            for (int r = 0; r < 5; r++)
+            {
+                atualizarTransformacoes(objetos, r * 0.1f);
+                visiveis = cullingPorFrustum(objetos, viewProjection);
+            }
+        });
+        // Grafo: 4096 jobs independentes e, quando todos terminam, 64 jobs que somam os resultados
+        std::vector<double> parciais(4096), somas(64);
+        tempos[2] = medirMilissegundos([&]() {
+            ContadorJobs primeiraEtapa, segundaEtapa;
+            for (int j = 0; j < 4096; j++)
+            {
+                enviarJob(sistemaDeJobs, [&parciais, j]() {
+                    double s = 0.0;
+                    for (int k = 1; k < 2000; k++) s += std::sqrt((double)(j * k % 977));
+                    parciais[j] = s;
+                }, &primeiraEtapa);
+            }
+            for (int j = 0; j < 64; j++)
+            {
+                enviarJobDepoisDe(sistemaDeJobs, primeiraEtapa, [&parciais, &somas, j]() {
+                    somas[j] = std::accumulate(parciais.begin() + j * 64, parciais.begin() + (j + 1) * 64, 0.0);
+                }, &segundaEtapa);
+            }
+            esperarContador(sistemaDeJobs, segundaEtapa);
+        });
+        long roubos = sistemaDeJobs.roubos;
+        encerrarSistemaDeJobs(sistemaDeJobs);
+
+        if (n == 1) std::copy(tempos, tempos + 3, base);
+        cout << std::fixed << std::setprecision(2) << n << " thread(s): curva " << tempos[0] << " ms (x" << base[0] / tempos[0] << "), transformacoes + culling "
+             << tempos[1] << " ms (x" << base[1] / tempos[1] << ", " << visiveis << " visiveis), grafo de jobs " << tempos[2] << " ms (x" << base[2] / tempos[2]
+             << "), roubos " << roubos << endl;
+    }
+    return 0;
+}
+
+template <typename T>
+void publicarTroca(TrocaTripla<T> &troca)
+{
+    troca.escrita = troca.meio.exchange(troca.escrita | TrocaTripla<T>::NOVO) & 3;
+}
+
+// Pega o buffer publicado mais recente; false se nada mudou desde a última chamada
+template <typename T>
+bool pegarTroca(TrocaTripla<T> &troca)
+{
+    if (!(troca.meio.load() & TrocaTripla<T>::NOVO)) return false;
+    troca.leitura = troca.meio.exchange(troca.leitura) & 3;
+    return true;
+}
+
+// Copia o estado inicial dos objetos e da câmera e publica o primeiro retrato antes de a thread começar
+void iniciarSimulacao(Simulacao &simulacao, const std::vector<Object> &objs, bool emThread)
+{
+    simulacao.passo = 1.0 / FPS;
+    simulacao.tempo = glfwGetTime();
+    simulacao.posCamera = cameraPos;
+    simulacao.yaw = rotacaoYaw;
+    simulacao.pitch = rotaocaoPitch;
+    simulacao.fov = fov;
+    enviarObjetosNovosParaSimulacao(simulacao, objs);
+    passoDaSimulacao(simulacao);
+    if (emThread)
+    {
+        simulacao.thread = std::thread(threadDaSimulacao, &simulacao);
+    }
+}
+
+void encerrarSimulacao(Simulacao &simulacao)
+{
+    simulacao.encerrar = true;
+    if (simulacao.thread.joinable()) simulacao.thread.join();
+}
+
+void threadDaSimulacao(Simulacao *simulacao)
+{
+    while (!simulacao->encerrar)
+    {
+        avancarSimulacao(*simulacao, glfwGetTime());
+        double espera = simulacao->tempo + simulacao->passo - glfwGetTime();
+        if (espera > 0.0) std::this_thread::sleep_for(std::chrono::duration<double>(espera));
+    }
+}
+
+// Executa os ticks que couberem até agora. Se a simulação ficar muito atrasada (janela arrastada, breakpoint),
+// descarta o tempo em vez de tentar alcançar o relógio com dezenas de ticks seguidos
+void avancarSimulacao(Simulacao &simulacao, double agora)
+{
+    int ticks = 0;
+    while (simulacao.tempo + simulacao.passo <= agora && ticks < 8)
+    {
+        simulacao.tempo += simulacao.passo;
+        passoDaSimulacao(simulacao);
+        ticks++;
+    }
+    if (ticks == 8 && simulacao.tempo + simulacao.passo <= agora)
+    {
+        simulacao.tempo = agora;
+    }
+}
+
+void passoDaSimulacao(Simulacao &simulacao)
+{
+    // Entrada acumulada desde o tick anterior
+    {
+        std::lock_guard<std::mutex> lock(simulacao.entrada.mutex);
+        simulacao.eventosDoTick.swap(simulacao.entrada.eventos);
+    }
+    for (const EventoEntrada &evento : simulacao.eventosDoTick)
+    {
+        switch (evento.tipo)
+        {
+        case EVENTO_TECLA:
+            tratarTeclaNaSimulacao(simulacao, evento.tecla, evento.acao);
+            break;
+        case EVENTO_MOUSE:
+            simulacao.yaw += (float)evento.x;
+            simulacao.pitch = glm::clamp(simulacao.pitch + (float)evento.y, -89.0f, 89.0f);
+            break;
+        case EVENTO_SCROLL:
+            simulacao.fov = glm::clamp(simulacao.fov - (float)evento.y * 0.1f, 1.0f, 45.0f);
+            break;
+        case EVENTO_NOVO_OBJETO:
+            simulacao.objetos.push_back(evento.objeto);
+            break;
+        case EVENTO_SELECIONAR:
+            if (evento.indice >= 0 && evento.indice < (int)simulacao.objetos.size()) simulacao.indiceObjetoSelecionado = evento.indice;
+            break;
+        }
+    }
+    simulacao.eventosDoTick.clear();
+
+    // Câmera
+    glm::vec3 front;
+    front.x = cos(glm::radians(simulacao.pitch)) * cos(glm::radians(simulacao.yaw));
+    front.y = sin(glm::radians(simulacao.pitch));
+    front.z = cos(glm::radians(simulacao.pitch)) * sin(glm::radians(simulacao.yaw));
+    front = glm::normalize(front);
+    glm::vec3 right = glm::normalize(glm::cross(front, glm::vec3(0.0f, 1.0f, 0.0f)));
+    float cameraSpeed = 0.05f;
+    if (simulacao.teclas[GLFW_KEY_W]) simulacao.posCamera += cameraSpeed * front;
+    if (simulacao.teclas[GLFW_KEY_S]) simulacao.posCamera -= cameraSpeed * front;
+    if (simulacao.teclas[GLFW_KEY_A]) simulacao.posCamera -= right * cameraSpeed;
+    if (simulacao.teclas[GLFW_KEY_D]) simulacao.posCamera += right * cameraSpeed;
+
+    // O primeiro objeto anda velocidadeCurva unidades por segundo ao longo da curva (a tabela de comprimento converte em u)
+    std::unique_lock<std::mutex> lockCurva(mutexCurva);
+    if (!simulacao.objetos.empty() && curvaCatmull.comprimento > 0.0f)
+    {
+        simulacao.distanciaCurva = std::fmod(simulacao.distanciaCurva + velocidadeCurva * simulacao.passo, (double)curvaCatmull.comprimento);
+        float u = parametroPorDistancia(curvaCatmull, (float)simulacao.distanciaCurva);
+        simulacao.objetos[0].posicao = avaliarCurva(curvaCatmull, u);
+        simulacao.objetos[0].orientacao = orientacaoNaCurva(curvaCatmull, u);
+    }
+    lockCurva.unlock();
+
+    // Publica o retrato (o vetor do buffer reaproveita a memória dos retratos anteriores)
+    simulacao.tick++;
+    RetratoSimulacao &retrato = simulacao.retratos.buffers[simulacao.retratos.escrita];
+    retrato.tick = simulacao.tick;
+    retrato.tempo = simulacao.tempo;
+    retrato.objetos = simulacao.objetos;
+    retrato.posCamera = simulacao.posCamera;
+    retrato.yaw = simulacao.yaw;
+    retrato.pitch = simulacao.pitch;
+    retrato.fov = simulacao.fov;
+    retrato.distanciaCurva = simulacao.distanciaCurva;
+    publicarTroca(simulacao.retratos);
+}
+
+void tratarTeclaNaSimulacao(Simulacao &simulacao, int key, int action)
+{
+    if (action == GLFW_PRESS || action == GLFW_RELEASE)
+    {
+        if (key >= 0 && key <= GLFW_KEY_LAST) simulacao.teclas[key] = action == GLFW_PRESS;
+    }
+
+    std::vector<TransformacaoObjeto> &objetos = simulacao.objetos;
+    int &indiceObjetoSelecionado = simulacao.indiceObjetoSelecionado;
+
+    if (key == GLFW_KEY_1 && action == GLFW_PRESS)
+    {
+        indiceObjetoSelecionado = 0;
+        cout << "Objeto 1 selecionado" << endl;
+    }
+    if (key == GLFW_KEY_2 && action == GLFW_PRESS)
+    {
+        if (objetos.size() > 1) {
+            indiceObjetoSelecionado = 1;
+            cout << "Objeto 2 selecionado" << endl;
+        } else {
+            cout << "Objeto 2 não existe" << endl;
+        }
+    }
+    if (key == GLFW_KEY_3 && action == GLFW_PRESS)
+    {
+        if (objetos.size() > 2) {
+            indiceObjetoSelecionado = 2;
+            cout << "Objeto 3 selecionado" << endl;
+        } else {
+            cout << "Objeto 3 não existe" << endl;
+        }
+    }
+
+    if (objetos.empty()) return; // os objetos ainda estão carregando
+    TransformacaoObjeto &obj = objetos[indiceObjetoSelecionado];
+
+    if (key == GLFW_KEY_X && action == GLFW_PRESS)
+    {
+        obj.rotateX = true;
+        obj.rotateY = false;
+        obj.rotateZ = false;
+    }
+
+    if (key == GLFW_KEY_Y && action == GLFW_PRESS)
+    {
+        obj.rotateX = false;
+        obj.rotateY = true;
+        obj.rotateZ = false;
+    }
+
+    if (key == GLFW_KEY_Z && action == GLFW_PRESS)
+    {
+        obj.rotateX = false;
+        obj.rotateY = false;
+        obj.rotateZ = true;
+    }
+
+    if (key == GLFW_KEY_UP && action == GLFW_PRESS)
+    {
+        obj.posicao.y += 0.1f;
+    }
+
+    if (key == GLFW_KEY_DOWN && action == GLFW_PRESS)
+    {
+        obj.posicao.y -= 0.1f;
+    }
+
+    if (key == GLFW_KEY_LEFT && action == GLFW_PRESS)
+    {
+        obj.posicao.x -= 0.1f;
+    }
+
+    if (key == GLFW_KEY_RIGHT && action == GLFW_PRESS)
+    {
+        obj.posicao.x += 0.1f;
+    }
+
+    if (key == GLFW_KEY_KP_ADD && action == GLFW_PRESS) // Tecla + do teclado numérico
+    {
+        obj.posicao.z += 0.1f;
+    }
+
+    if (key == GLFW_KEY_KP_SUBTRACT && action == GLFW_PRESS) // Tecla - do teclado numérico
+    {
+        obj.posicao.z -= 0.1f;
+    }
+
+    if (key == GLFW_KEY_U && action == GLFW_PRESS)
+    {
+        obj.tamanhoEscala += 0.1f;
+    }
+
+    if (key == GLFW_KEY_N && action == GLFW_PRESS && indiceObjetoSelecionado > 0) // o objeto 1 já anda na curva
+    {
+        std::lock_guard<std::mutex> lockCurva(mutexCurva);
+        PontoNaCurva maisProximo = pontoMaisProximoNaCurva(curvaCatmull, obj.posicao);
+        if (maisProximo.curva >= 0)
+        {
+            cout << "Objeto " << indiceObjetoSelecionado + 1 << " encaixado na curva (u = " << maisProximo.u << ", distancia " << maisProximo.distancia << ")" << endl;
+            obj.posicao = maisProximo.ponto;
+        }
+    }
+
+    if (key == GLFW_KEY_H && action == GLFW_PRESS)
+    {
+        if (obj.tamanhoEscala < 0.1f)
+        {
+            obj.tamanhoEscala = 0.1f;
+        } else {
+            obj.tamanhoEscala -= 0.1f;
+        }
+    }
+}
+
+void enviarEventoEntrada(Simulacao &simulacao, const EventoEntrada &evento)
+{
+    std::lock_guard<std::mutex> lock(simulacao.entrada.mutex);
+    simulacao.entrada.eventos.push_back(evento);
+}
+
+// Objetos que entraram em objs desde a última chamada passam a ser controlados pela simulação
+void enviarObjetosNovosParaSimulacao(Simulacao &simulacao, const std::vector<Object> &objs)
+{
+    for (; simulacao.objetosEnviados < objs.size(); simulacao.objetosEnviados++)
+    {
+        const Object &obj = objs[simulacao.objetosEnviados];
+        EventoEntrada evento;
+        evento.tipo = EVENTO_NOVO_OBJETO;
+        evento.objeto.posicao = glm::vec3(obj.posX, obj.posY, obj.posZ);
+        evento.objeto.orientacao = obj.orientacao;
+        evento.objeto.tamanhoEscala = obj.tamanhoEscala;
+        evento.objeto.rotateX = obj.rotateX;
+        evento.objeto.rotateY = obj.rotateY;
+        evento.objeto.rotateZ = obj.rotateZ;
+        enviarEventoEntrada(simulacao, evento);
+    }
+}
+
+// Interpola entre os dois últimos retratos e escreve o resultado na câmera e em objs. O render fica um tick
+// atrás da simulação, então o instante desenhado quase sempre está entre os dois retratos.
+// Devolve o tempo interpolado (usado no ângulo das rotações contínuas)
+float aplicarRetratoSimulacao(Simulacao &simulacao, std::vector<Object> &objs, double agora)
+{
+    if (pegarTroca(simulacao.retratos))
+    {
+        // O buffer antigo volta para a troca e o escritor sobrescreve sem realocar
+        std::swap(simulacao.anterior, simulacao.atual);
+        std::swap(simulacao.atual, simulacao.retratos.buffers[simulacao.retratos.leitura]);
+        simulacao.ticksRecebidos++;
+    }
+    const RetratoSimulacao &a = simulacao.ticksRecebidos > 1 ? simulacao.anterior : simulacao.atual;
+    const RetratoSimulacao &b = simulacao.atual;
+
+    float alfa = 1.0f;
+    if (b.tempo > a.tempo)
+    {
+        alfa = glm::clamp((float)((agora - simulacao.passo - a.tempo) / (b.tempo - a.tempo)), 0.0f, 1.0f);
+    }
+
+    cameraPos = glm::mix(a.posCamera, b.posCamera, alfa);
+    rotacaoYaw = glm::mix(a.yaw, b.yaw, alfa);
+    rotaocaoPitch = glm::mix(a.pitch, b.pitch, alfa);
+    fov = glm::mix(a.fov, b.fov, alfa);
+
+    for (size_t i = 0; i < b.objetos.size() && i < objs.size(); i++)
+    {
+        const TransformacaoObjeto &depois = b.objetos[i];
+        const TransformacaoObjeto &antes = i < a.objetos.size() ? a.objetos[i] : depois; // objeto que acabou de entrar
+        glm::vec3 posicao = glm::mix(antes.posicao, depois.posicao, alfa);
+        objs[i].posX = posicao.x;
+        objs[i].posY = posicao.y;
+        objs[i].posZ = posicao.z;
+        objs[i].orientacao = glm::slerp(antes.orientacao, depois.orientacao, alfa);
+        objs[i].tamanhoEscala = glm::mix(antes.tamanhoEscala, depois.tamanhoEscala, alfa);
+        objs[i].rotateX = depois.rotateX;
+        objs[i].rotateY = depois.rotateY;
+        objs[i].rotateZ = depois.rotateZ;
+    }
+
+    // O objeto da curva é reavaliado na distância interpolada: a posição fica sobre a curva mesmo entre ticks
+    std::lock_guard<std::mutex> lockCurva(mutexCurva);
+    double comprimento = curvaCatmull.comprimento;
+    if (!b.objetos.empty() && !a.objetos.empty() && !objs.empty() && comprimento > 0.0)
+    {
+        double avanco = b.distanciaCurva - a.distanciaCurva;
+        if (avanco < 0.0) avanco += comprimento; // deu a volta na curva entre os dois retratos
+        float u = parametroPorDistancia(curvaCatmull, (float)std::fmod(a.distanciaCurva + avanco * alfa, comprimento));
+        glm::vec3 posicao = avaliarCurva(curvaCatmull, u);
+        objs[0].posX = posicao.x;
+        objs[0].posY = posicao.y;
+        objs[0].posZ = posicao.z;
+        objs[0].orientacao = orientacaoNaCurva(curvaCatmull, u);
+    }
+    return (float)glm::mix(a.tempo, b.tempo, (double)alfa);
+}
+
+// --bench-curva: tesselação de um caminho com 1 milhão de pontos de controle, comparando o laço antigo
+// (G * M * T por amostra, push_back) com os coeficientes por segmento + SSE2 em todas as threads
+int executarBenchmarkCurva()
+{
+    int nucleos = iniciarJobsDoBenchmark();
+
+    Curve curva;
+    curva.controlPoints.resize(1000000);
+    glm::vec3 ponto(0.0f);
+    for (size_t i = 0; i < curva.controlPoints.size(); i++)
+    {
+        ponto += glm::vec3(std::sin(i * 0.37f), std::cos(i * 0.11f), std::sin(i * 0.23f + 1.0f));
+        curva.controlPoints[i] = ponto;
+    }
+    initializeCatmullRomMatrix(curva.M);
+    int numPoints = 15;
+    int segmentos = segmentosDaCurva(curva);
+    double amostras = (double)segmentos * (numPoints + 1);
+
+    std::vector<glm::vec3> referencia;
+    double tempoReferencia = medirMilissegundos([&]() {
+        float piece = 1.0 / (float)numPoints;
+        for (int i = 0; i < segmentos; i++)
+        {
+            glm::mat4x3 G(curva.controlPoints[i], curva.controlPoints[i + 1], curva.controlPoints[i + 2], curva.controlPoints[i + 3]);
+            for (int j = 0; j <= numPoints; j++)
+            {
+                float t = j * piece;
+                referencia.push_back(G * curva.M * glm::vec4(t * t * t, t * t, t, 1));
+            }
+        }
+    });
+
+    double tempoCoeficientes = medirMilissegundos([&]() { calcularCoeficientesCurva(curva); }); // a tesselação lê os coeficientes
+    std::vector<glm::vec3> saida;
+    tesselarCurva(curva, numPoints, saida); // a primeira chamada paga a alocação da saída
+    double tempoTesselacao = 1e30;
+    for (int r = 0; r < 5; r++)
+    {
+        tempoTesselacao = std::min(tempoTesselacao, medirMilissegundos([&]() { tesselarCurva(curva, numPoints, saida); }));
+    }
+
+    float maiorDiferenca = 0.0f;
+    for (size_t i = 0; i < saida.size(); i += 997) maiorDiferenca = std::max(maiorDiferenca, glm::length(saida[i] - referencia[i]));
+    encerrarSistemaDeJobs(sistemaDeJobs);
+
+    cout << std::fixed << std::setprecision(1) << "Benchmark da curva: " << segmentos << " segmentos, " << amostras / 1e6 << " milhoes de amostras, "
+         << nucleos << " thread(s)" << endl;
+    cout << "  G * M * T por amostra: " << tempoReferencia << " ms (" << amostras / tempoReferencia / 1e3 << " milhoes de amostras/s)" << endl;
+    cout << "  coeficientes: " << tempoCoeficientes << " ms, tesselacao: " << tempoTesselacao << " ms ("
+         << amostras / tempoTesselacao / 1e3 << " milhoes de amostras/s)" << endl;
+    cout << std::setprecision(6) << "  maior diferenca entre os dois: " << maiorDiferenca << endl;
+    return 0;
+}
+
+int criarGrupoDeSeguidores(SistemaDeSeguidores &sistema, int curva, const Object &modelo)
+{
+    GrupoDeSeguidores grupo;
+    grupo.curva = curva;
+    grupo.VBOMalha = modelo.VBO;
+    grupo.texID = modelo.texID;
+    grupo.nVertices = modelo.nVertices;
+    grupo.escala = modelo.tamanhoEscala;
+    grupo.material = modelo.material;
+    sistema.grupos.push_back(grupo);
+    return (int)sistema.grupos.size() - 1;
+}
+
+void adicionarSeguidor(GrupoDeSeguidores &grupo, float deslocamento, float velocidade, ModoLaco modo)
+{
+    grupo.deslocamento.push_back(deslocamento);
+    grupo.velocidade.push_back(velocidade);
+    grupo.modo.push_back(modo);
+    grupo.distancia.push_back(0.0f);
+    grupo.sentido.push_back(1.0f);
+}
+
+// Kernel das distâncias: x = deslocamento + velocidade * tempo, dobrado para [0, comprimento] conforme o modo.
+// Com SSE2 são 4 seguidores por vez; os três modos são calculados e o resultado escolhido por máscara
+void calcularDistanciasSeguidores(GrupoDeSeguidores &grupo, float comprimento, float tempo)
+{
+    int n = (int)grupo.deslocamento.size();
+    const float *deslocamento = grupo.deslocamento.data();
+    const float *velocidade = grupo.velocidade.data();
+    const int32_t *modo = grupo.modo.data();
+    float *distancia = grupo.distancia.data();
+    float *sentido = grupo.sentido.data();
+    float inverso = 1.0f / comprimento;
+    int i = 0;
+#ifdef MIPMAP_SSE2
+    __m128 L = _mm_set1_ps(comprimento), L2 = _mm_set1_ps(2.0f * comprimento);
+    __m128 invL = _mm_set1_ps(inverso), invL2 = _mm_set1_ps(0.5f * inverso);
+    __m128 t = _mm_set1_ps(tempo), zero = _mm_setzero_ps(), um = _mm_set1_ps(1.0f), bitSinal = _mm_set1_ps(-0.0f);
+    __m128i modoRepetir = _mm_set1_epi32(LACO_REPETIR), modoIdaEVolta = _mm_set1_epi32(LACO_IDA_E_VOLTA);
+    auto piso = [um](__m128 q) {
+        __m128 truncado = _mm_cvtepi32_ps(_mm_cvttps_epi32(q));
+        return _mm_sub_ps(truncado, _mm_and_ps(_mm_cmpgt_ps(truncado, q), um)); // negativos truncam para cima
+    };
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 v = _mm_loadu_ps(velocidade + i);
+        __m128 x = _mm_add_ps(_mm_loadu_ps(deslocamento + i), _mm_mul_ps(v, t));
+        __m128i m = _mm_loadu_si128((const __m128i *)(modo + i));
+        __m128 repetir = _mm_castsi128_ps(_mm_cmpeq_epi32(m, modoRepetir));
+        __m128 idaEVolta = _mm_castsi128_ps(_mm_cmpeq_epi32(m, modoIdaEVolta));
+
+        __m128 dRepetir = _mm_sub_ps(x, _mm_mul_ps(piso(_mm_mul_ps(x, invL)), L));
+        __m128 y = _mm_sub_ps(x, _mm_mul_ps(piso(_mm_mul_ps(x, invL2)), L2)); // posição no ciclo de ida e volta, [0, 2L)
+        __m128 voltando = _mm_cmpgt_ps(y, L);
+        __m128 dIdaEVolta = _mm_or_ps(_mm_and_ps(voltando, _mm_sub_ps(L2, y)), _mm_andnot_ps(voltando, y));
+        __m128 dParar = _mm_min_ps(_mm_max_ps(x, zero), L);
+
+        __m128 d = _mm_or_ps(_mm_and_ps(repetir, dRepetir), _mm_and_ps(idaEVolta, dIdaEVolta));
+        d = _mm_or_ps(d, _mm_andnot_ps(_mm_or_ps(repetir, idaEVolta), dParar));
+        _mm_storeu_ps(distancia + i, d);
+
+        // Sentido: o sinal da velocidade, invertido na volta do modo ida e volta
+        __m128 s = _mm_or_ps(um, _mm_and_ps(v, bitSinal));
+        s = _mm_xor_ps(s, _mm_and_ps(_mm_and_ps(voltando, idaEVolta), bitSinal));
+        _mm_storeu_ps(sentido + i, s);
+    }
+#endif
+    for (; i < n; i++)
+    {
+        float x = deslocamento[i] + velocidade[i] * tempo;
+        float s = velocidade[i] < 0.0f ? -1.0f : 1.0f;
+        if (modo[i] == LACO_REPETIR)
+        {
+            distancia[i] = x - std::floor(x * inverso) * comprimento;
+        }
+        else if (modo[i] == LACO_IDA_E_VOLTA)
+        {
+            float y = x - std::floor(x * inverso * 0.5f) * 2.0f * comprimento;
+            distancia[i] = y > comprimento ? 2.0f * comprimento - y : y;
+            if (y > comprimento) s = -s;
+        }
+        else
+        {
+            distancia[i] = glm::clamp(x, 0.0f, comprimento);
+        }
+        sentido[i] = s;
+    }
+}
+
+// Distâncias pelo kernel e, em lotes paralelos, posição e orientação de cada seguidor escritos em instancias
+// (o buffer de instâncias mapeado). A inversão da tabela de comprimento é sem Newton: erro de uma fração
+// de AMOSTRAS_ARCO, invisível num objeto e muito mais barato para um milhão deles. A orientação vem da tabela
+// de referenciais; quem anda para trás gira meia volta em torno da normal
+void atualizarSeguidores(GrupoDeSeguidores &grupo, const Curve &curve, float tempo, InstanciaSeguidor *instancias)
+{
+    if (curve.comprimento <= 0.0f) return;
+    calcularDistanciasSeguidores(grupo, curve.comprimento, tempo);
+    executarEmParalelo(0, (int)grupo.distancia.size(), [&](int i) {
+        float u = parametroPorDistancia(curve, grupo.distancia[i], 0);
+        glm::quat q = orientacaoNaCurva(curve, u);
+        if (grupo.sentido[i] < 0.0f) q = q * glm::quat(0.0f, 0.0f, 1.0f, 0.0f);
+        instancias[i].posicao = avaliarCurva(curve, u);
+        instancias[i].orientacao = glm::vec4(q.x, q.y, q.z, q.w);
+    }, 4096);
+}
+
+void desenharSeguidores(SistemaDeSeguidores &sistema, GLuint shaderID, float tempo)
+{
+    auto inicio = std::chrono::high_resolution_clock::now();
+    glUniform1i(glGetUniformLocation(shaderID, "instanciado"), 1);
+    for (GrupoDeSeguidores &grupo : sistema.grupos)
+    {
+        size_t n = grupo.deslocamento.size();
+        if (n == 0 || !grupo.VBOMalha) continue;
+        if (!grupo.VAO)
+        {
+            grupo.VAO = criarVAOdoOBJ(grupo.VBOMalha);
+            glGenBuffers(1, &grupo.VBOInstancias);
+            glBindVertexArray(grupo.VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, grupo.VBOInstancias);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(InstanciaSeguidor), (GLvoid *)offsetof(InstanciaSeguidor, posicao));
+            glEnableVertexAttribArray(4);
+            glVertexAttribDivisor(4, 1);
+            glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(InstanciaSeguidor), (GLvoid *)offsetof(InstanciaSeguidor, orientacao));
+            glEnableVertexAttribArray(5);
+            glVertexAttribDivisor(5, 1);
+            glBindVertexArray(0);
+        }
+
+        // Buffer novo a cada frame (a GPU pode ainda estar lendo o anterior) e mapeado para os workers escreverem direto
+        glBindBuffer(GL_ARRAY_BUFFER, grupo.VBOInstancias);
+        glBufferData(GL_ARRAY_BUFFER, n * sizeof(InstanciaSeguidor), NULL, GL_STREAM_DRAW);
+        InstanciaSeguidor *instancias = (InstanciaSeguidor *)glMapBufferRange(GL_ARRAY_BUFFER, 0, n * sizeof(InstanciaSeguidor), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (instancias)
+        {
+            atualizarSeguidores(grupo, *sistema.curvas[grupo.curva], tempo, instancias);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0); // desvincula também quando o mapeamento falha
+        if (!instancias) continue;
+
+        glUniform1f(glGetUniformLocation(shaderID, "escalaInstancia"), grupo.escala);
+        glUniform1f(glGetUniformLocation(shaderID, "ka"), grupo.material.ka.r);
+        glUniform1f(glGetUniformLocation(shaderID, "kd"), grupo.material.kd.r);
+        glUniform1f(glGetUniformLocation(shaderID, "ks"), grupo.material.ks.r);
+        glBindVertexArray(grupo.VAO);
+        glBindTexture(GL_TEXTURE_2D, grupo.texID);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, grupo.nVertices, (GLsizei)n);
+    }
+    glBindVertexArray(0);
+    glUniform1i(glGetUniformLocation(shaderID, "instanciado"), 0);
+    sistema.msUltimaAtualizacao = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - inicio).count();
+}
+
+void destruirSeguidores(SistemaDeSeguidores &sistema)
+{
+    for (GrupoDeSeguidores &grupo : sistema.grupos)
+    {
+        glDeleteVertexArrays(1, &grupo.VAO);
+        glDeleteBuffers(1, &grupo.VBOInstancias);
+    }
+    sistema.grupos.clear();
+}
+
+// --bench-seguidores: 1 milhão de seguidores divididos entre 64 curvas, atualizados como num frame (sem OpenGL)
+int executarBenchmarkSeguidores()
+{
+    int nucleos = iniciarJobsDoBenchmark();
+
+    const int nCurvas = 64, nSeguidores = 1000000;
+    std::vector<Curve> curvas(nCurvas);
+    SistemaDeSeguidores sistema;
+    for (int c = 0; c < nCurvas; c++)
+    {
+        for (int i = 0; i < 32; i++)
+        {
+            curvas[c].controlPoints.push_back(glm::vec3(std::cos(i * 0.5f + c) * (10.0f + c), std::sin(i * 0.3f * (c % 5 + 1)) * 5.0f, std::sin(i * 0.5f + c) * (10.0f + c)));
+        }
+        generateCatmullRomCurvePoints(curvas[c], 16);
+        sistema.curvas.push_back(&curvas[c]);
+        criarGrupoDeSeguidores(sistema, c, Object());
+    }
+    for (int i = 0; i < nSeguidores; i++)
+    {
+        adicionarSeguidor(sistema.grupos[i % nCurvas], (float)(i % 1000), 2.0f + (float)(i % 17), (ModoLaco)(i % 3));
+    }
+
+    std::vector<std::vector<InstanciaSeguidor>> instancias(nCurvas);
+    for (int c = 0; c < nCurvas; c++) instancias[c].resize(sistema.grupos[c].deslocamento.size());
+    const int frames = 60;
+    double totalMs = 0.0, maiorMs = 0.0;
+    for (int f = 0; f < frames; f++)
+    {
+        double ms = medirMilissegundos([&]() {
+            for (int c = 0; c < nCurvas; c++)
+            {
+                atualizarSeguidores(sistema.grupos[c], curvas[c], f / 60.0f, instancias[c].data());
+            }
+        });
+        totalMs += ms;
+        maiorMs = std::max(maiorMs, ms);
+    }
+    encerrarSistemaDeJobs(sistemaDeJobs);
+
+    cout << std::fixed << std::setprecision(2) << "Benchmark dos seguidores: " << nSeguidores << " seguidores em " << nCurvas << " curvas, " << nucleos << " thread(s)" << endl;
+    cout << "  media " << totalMs / frames << " ms por frame (maximo " << maiorMs << " ms; 60 Hz = 16.67 ms)" << endl;
+    return 0;
+}
+
+// --bench-consultas-curva: ponto mais próximo e raio contra milhares de curvas, pela BVH e varrendo os curvePoints
+int executarBenchmarkConsultasCurva()
+{
+    iniciarJobsDoBenchmark();
+
+    const int nCurvas = 4096, nConsultas = 20000, nConsultasVarredura = 200;
+    std::vector<Curve> curvas(nCurvas);
+    std::vector<const Curve *> ponteiros;
+    unsigned semente = 12345;
+    size_t totalSegmentos = 0, totalPontos = 0;
+    IndiceDeCurvas indice;
+    double msConstrucao = medirMilissegundos([&]() {
+        for (int c = 0; c < nCurvas; c++)
+        {
+            glm::vec3 centro(aleatorioBenchmark(semente) * 1000.0f, aleatorioBenchmark(semente) * 100.0f, aleatorioBenchmark(semente) * 1000.0f);
+            for (int i = 0; i < 32; i++)
+            {
+                centro += glm::vec3(aleatorioBenchmark(semente) - 0.5f, aleatorioBenchmark(semente) - 0.5f, aleatorioBenchmark(semente) - 0.5f) * 4.0f;
+                curvas[c].controlPoints.push_back(centro);
+            }
+            generateCatmullRomCurvePoints(curvas[c], 16);
+            ponteiros.push_back(&curvas[c]);
+            totalSegmentos += curvas[c].coeficientes.size();
+            totalPontos += curvas[c].curvePoints.size();
+        }
+        construirIndiceDeCurvas(indice, ponteiros);
+    });
+    encerrarSistemaDeJobs(sistemaDeJobs);
+
+    std::vector<glm::vec3> pontos(nConsultas), direcoes(nConsultas);
+    for (int i = 0; i < nConsultas; i++)
+    {
+        pontos[i] = glm::vec3(aleatorioBenchmark(semente) * 1000.0f, aleatorioBenchmark(semente) * 100.0f, aleatorioBenchmark(semente) * 1000.0f);
+        direcoes[i] = glm::normalize(glm::vec3(aleatorioBenchmark(semente) - 0.5f, aleatorioBenchmark(semente) - 0.5f, aleatorioBenchmark(semente) - 0.5f));
+    }
+
+    double somaDistancias = 0.0;
+    double usProximo = medirMilissegundos([&]() {
+        for (int i = 0; i < nConsultas; i++) somaDistancias += pontoMaisProximoNasCurvas(indice, pontos[i]).distancia;
+    }) * 1000.0 / nConsultas;
+
+    int acertos = 0;
+    double usRaio = medirMilissegundos([&]() {
+        for (int i = 0; i < nConsultas; i++)
+        {
+            PontoNaCurva acerto;
+            if (raioNasCurvas(indice, pontos[i], direcoes[i], 1.0f, acerto)) acertos++;
+        }
+    }) * 1000.0 / nConsultas;
+
+    // Varredura de todos os pontos tesselados, como seria sem o índice (só as primeiras consultas, e para conferir)
+    double maiorDiferenca = 0.0;
+    double usVarredura = medirMilissegundos([&]() {
+        for (int i = 0; i < nConsultasVarredura; i++)
+        {
+            float melhor = 1e30f;
+            for (const Curve &curva : curvas)
+            {
+                for (const glm::vec3 &p : curva.curvePoints) melhor = std::min(melhor, glm::dot(p - pontos[i], p - pontos[i]));
+            }
+            maiorDiferenca = std::max(maiorDiferenca, (double)(pontoMaisProximoNasCurvas(indice, pontos[i]).distancia - std::sqrt(melhor)));
+        }
+    }) * 1000.0 / nConsultasVarredura;
+
+    cout << std::fixed << std::setprecision(2) << "Consultas em " << nCurvas << " curvas (" << totalSegmentos << " segmentos, " << totalPontos << " pontos tesselados)" << endl;
+    cout << "  construcao (curvas + BVHs): " << msConstrucao << " ms" << endl;
+    cout << "  ponto mais proximo pela BVH: " << usProximo << " us por consulta (distancia media " << somaDistancias / nConsultas << ")" << endl;
+    cout << "  raio contra tubo de raio 1: " << usRaio << " us por consulta (" << acertos << " de " << nConsultas << " acertaram)" << endl;
+    cout << "  varredura dos curvePoints: " << usVarredura << " us por consulta (a BVH ficou no maximo " << maiorDiferenca << " acima; a varredura so ve os pontos da linha)" << endl;
+    return 0;
+}
+
+// --bench-cena: 200 mil objetos numa grade, 1% deles andando a cada frame; compara a árvore (atualização + culling)
+// com o culling que testa todos os objetos em paralelo
+int executarBenchmarkCena()
+{
+    int nucleos = iniciarJobsDoBenchmark();
+
+    std::vector<Object> objetos(200000);
+    for (size_t i = 0; i < objetos.size(); i++)
+    {
+        objetos[i].posX = (float)(i % 500) * 4.0f - 1000.0f;
+        objetos[i].posY = (float)((i / 500) % 4) * 4.0f;
+        objetos[i].posZ = -(float)(i / 2000) * 4.0f;
+    }
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 5.0f, 10.0f), glm::vec3(0.0f, 0.0f, -100.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 viewProjection = projection * view;
+
+    ArvoreDinamica arvore;
+    atualizarTransformacoes(objetos, 0.0f);
+    double msConstrucao = medirMilissegundos([&]() { atualizarArvoreCena(arvore, objetos); });
+
+    const int frames = 120;
+    unsigned semente = 99;
+    double msArvore = 0.0, msLinear = 0.0;
+    int visiveisArvore = 0, visiveisLinear = 0;
+    for (int f = 0; f < frames; f++)
+    {
+        for (size_t k = 0; k < objetos.size() / 100; k++)
+        {
+            Object &obj = objetos[avancarSemente(semente) % objetos.size()];
+            obj.posX += ((semente >> 8) % 100 - 50) * 0.01f;
+            obj.posZ += ((semente >> 16) % 100 - 50) * 0.01f;
+        }
+        atualizarTransformacoes(objetos, f * 0.1f);
+
+        msArvore += medirMilissegundos([&]() {
+            atualizarArvoreCena(arvore, objetos);
+            visiveisArvore = cullingNaArvore(objetos, arvore, viewProjection);
+        });
+        msLinear += medirMilissegundos([&]() { visiveisLinear = cullingPorFrustum(objetos, viewProjection); });
+    }
+    encerrarSistemaDeJobs(sistemaDeJobs);
+
+    cout << std::fixed << std::setprecision(3) << "Arvore da cena: " << objetos.size() << " objetos, " << arvore.nos.size() << " nos, altura " << alturaDaArvore(arvore)
+         << ", construida em " << msConstrucao << " ms" << endl;
+    cout << "  arvore (atualizacao + culling): " << msArvore / frames << " ms por frame, " << arvore.reinsercoes << " reinsercoes em " << frames << " frames, "
+         << visiveisArvore << " visiveis" << endl;
+    cout << "  culling linear (" << nucleos << " threads): " << msLinear / frames << " ms por frame, " << visiveisLinear << " visiveis" << endl;
+    return 0;
+}
+
+// --bench-selecao: BVH de uma malha grande instanciada numa grade; compara a seleção (árvore da cena + BVH da malha)
+// com o teste de todos os triângulos de uma instância, sem abrir janela
+int executarBenchmarkSelecao()
+{
+    iniciarJobsDoBenchmark();
+    MalhaOBJ malha = lerArquivoOBJ("../assets/Modelos3D/Skeletal_Stego.obj", false);
+    if (!malha.valida || !malha.bvh)
+    {
+        encerrarSistemaDeJobs(sistemaDeJobs);
+        return 1;
+    }
+    const BVHMalha &bvh = *malha.bvh;
+    cout << std::fixed << std::setprecision(3) << "BVH da malha: " << bvh.triangulos << " triangulos, " << bvh.bvh.nos.size() << " nos, " << bvh.pacotes.size()
+         << " pacotes, construida em " << bvh.msConstrucao << " ms" << endl;
+
+    // Grade de instâncias espaçadas pelo diâmetro da malha
+    std::vector<Object> objetos(2000);
+    float passo = malha.raio * 2.5f;
+    for (size_t i = 0; i < objetos.size(); i++)
+    {
+        objetos[i].posX = (float)(i % 20) * passo;
+        objetos[i].posY = (float)((i / 20) % 10) * passo;
+        objetos[i].posZ = -(float)(i / 200) * passo;
+        objetos[i].centroLocal = malha.centro;
+        objetos[i].raioLocal = malha.raio;
+        objetos[i].bvhMalha = malha.bvh;
+    }
+    atualizarTransformacoes(objetos, 0.0f);
+    ArvoreDinamica arvore;
+    atualizarArvoreCena(arvore, objetos);
+
+    const int raios = 10000;
+    unsigned semente = 7;
+    glm::vec3 olho(passo * 10.0f, passo * 5.0f, passo * 4.0f);
+    double usTotal = 0.0;
+    int acertos = 0, malhasPercorridas = 0;
+    for (int r = 0; r < raios; r++)
+    {
+        const Object &alvo = objetos[semente % objetos.size()];
+        glm::vec3 ponto = glm::vec3(alvo.model * glm::vec4(malha.centro, 1.0f)) + (glm::vec3(aleatorioBenchmark(semente), aleatorioBenchmark(semente), aleatorioBenchmark(semente)) - glm::vec3(0.5f)) * malha.raio;
+        ResultadoSelecao selecao = selecionarPorRaio(objetos, arvore, olho, ponto - olho);
+        usTotal += selecao.microssegundos;
+        malhasPercorridas += selecao.objetosTestados;
+        if (selecao.objeto >= 0) acertos++;
+    }
+    cout << "  selecao em " << objetos.size() << " instancias: " << usTotal / raios << " us por raio, " << acertos << "/" << raios << " acertos, "
+         << (float)malhasPercorridas / raios << " malhas percorridas por raio" << endl;
+
+    // Uma instância na origem: BVH contra todos os triângulos
+    const int raiosForca = 200;
+    glm::vec3 olhoLocal = malha.centro + glm::vec3(0.0f, 0.0f, malha.raio * 3.0f);
+    double usBVH = 0.0, usForca = 0.0;
+    int divergencias = 0;
+    for (int r = 0; r < raiosForca; r++)
+    {
+        glm::vec3 ponto = malha.centro + (glm::vec3(aleatorioBenchmark(semente), aleatorioBenchmark(semente), aleatorioBenchmark(semente)) - glm::vec3(0.5f)) * malha.raio;
+        glm::vec3 direcao = glm::normalize(ponto - olhoLocal);
+        float distanciaBVH = 1e30f, distanciaForca = 1e30f;
+        int trianguloBVH = -1, trianguloForca = -1;
+        usBVH += medirMilissegundos([&]() { trianguloBVH = raioNaMalha(bvh, olhoLocal, direcao, distanciaBVH); }) * 1000.0;
+        usForca += medirMilissegundos([&]() {
+            for (int t = 0; t < bvh.triangulos; t++)
+            {
+                const GLfloat *v = &malha.vBuffer[(size_t)t * 33];
+                glm::vec3 v0(v[0], v[1], v[2]);
+                float d;
+                if (raioNoTriangulo(v0, glm::vec3(v[11], v[12], v[13]) - v0, glm::vec3(v[22], v[23], v[24]) - v0, olhoLocal, direcao, d) && d < distanciaForca)
+                {
+                    distanciaForca = d;
+                    trianguloForca = t;
+                }
+            }
+        }) * 1000.0;
+        if ((trianguloBVH < 0) != (trianguloForca < 0) || (trianguloForca >= 0 && std::fabs(distanciaBVH - distanciaForca) > 1e-3f * distanciaForca)) divergencias++;
+    }
+    encerrarSistemaDeJobs(sistemaDeJobs);
+    cout << "  uma instancia: BVH " << usBVH / raiosForca << " us, forca bruta " << usForca / raiosForca << " us por raio, " << divergencias << " divergencias em "
+         << raiosForca << " raios" << endl;
+    return 0;
+}
+
+// --bench-colisao: 100 mil corpos andando numa caixa; mede a atualização incremental e, num subconjunto, confere os
+// contatos contra o teste de todos os pares
+int executarBenchmarkColisao()
+{
+    iniciarJobsDoBenchmark();
+    const int corpos = 100000;
+    const float lado = 400.0f;
+    unsigned semente = 1234;
+    std::vector<Object> objetos(corpos);
+    std::vector<glm::vec3> velocidades(corpos);
+    for (int i = 0; i < corpos; i++)
+    {
+        objetos[i].posX = aleatorioBenchmark(semente) * lado;
+        objetos[i].posY = aleatorioBenchmark(semente) * lado;
+        objetos[i].posZ = aleatorioBenchmark(semente) * lado;
+        objetos[i].raioLocal = 0.5f + aleatorioBenchmark(semente);
+        velocidades[i] = glm::vec3(aleatorioBenchmark(semente) - 0.5f, aleatorioBenchmark(semente) - 0.5f, aleatorioBenchmark(semente) - 0.5f) * 0.1f; // até 3 unidades por segundo a 60 fps
+    }
+    SistemaDeColisao sistema;
+    int comecos = 0, fins = 0;
+    sistema.aoContato = [&](const ContatoColisao &contato) { (contato.comecou ? comecos : fins)++; };
+    atualizarTransformacoes(objetos, 0.0f);
+    double msConstrucao = medirMilissegundos([&]() { atualizarColisoes(sistema, objetos); });
+
+    const int frames = 120;
+    double msTotal = 0.0;
+    size_t trocas = 0;
+    for (int f = 0; f < frames; f++)
+    {
+        for (int i = 0; i < corpos; i++)
+        {
+            objetos[i].posX += velocidades[i].x;
+            objetos[i].posY += velocidades[i].y;
+            objetos[i].posZ += velocidades[i].z;
+        }
+        atualizarTransformacoes(objetos, 0.0f);
+        atualizarColisoes(sistema, objetos);
+        msTotal += sistema.msUltimoFrame;
+        trocas += sistema.trocas;
+    }
+    int emContato = 0;
+    for (const auto &par : sistema.pares) emContato += par.second;
+
+    // Conferência: os mesmos contatos que o teste de todos os pares, nos primeiros corpos
+    const int conferidos = 5000;
+    int divergencias = 0;
+    for (int a = 0; a < conferidos; a++)
+    {
+        for (int b = a + 1; b < conferidos; b++)
+        {
+            glm::vec3 entre = glm::vec3(sistema.esferas[b]) - glm::vec3(sistema.esferas[a]);
+            float soma = sistema.esferas[a].w + sistema.esferas[b].w;
+            bool tocando = glm::dot(entre, entre) <= soma * soma;
+            auto par = sistema.pares.find(chaveDoPar(a, b));
+            if (tocando != (par != sistema.pares.end() && par->second)) divergencias++;
+        }
+    }
+    encerrarSistemaDeJobs(sistemaDeJobs);
+
+    cout << std::fixed << std::setprecision(3) << "Colisoes: " << corpos << " corpos, primeira ordenacao em " << msConstrucao << " ms" << endl;
+    cout << "  atualizacao incremental: " << msTotal / frames << " ms por frame, " << trocas / frames << " trocas por frame, " << sistema.pares.size()
+         << " pares na fase ampla, " << emContato << " em contato" << endl;
+    cout << "  eventos: " << comecos << " inicios e " << fins << " fins de contato; " << divergencias << " divergencias contra a forca bruta em " << conferidos << " corpos" << endl;
+    return 0;
+}
+
+// --bench-oclusao: uma parede de luas na frente de uma multidão de objetos pequenos; mede o culling por oclusão depois
+// do culling por frustum, com a câmera andando de lado, sem abrir janela
+int executarBenchmarkOclusao()
+{
+    iniciarJobsDoBenchmark();
+    MalhaOBJ malha = lerArquivoOBJ("../assets/Modelos3D/Moon.obj", false);
+    if (!malha.valida || !malha.oclusor || malha.oclusor->empty())
+    {
+        encerrarSistemaDeJobs(sistemaDeJobs);
+        return 1;
+    }
+
+    std::vector<Object> objetos;
+    for (int i = 0; i < 8; i++)
+    {
+        Object lua;
+        lua.tamanhoEscala = 3.0f / malha.raio;
+        lua.posX = (i % 4 - 1.5f) * 6.0f;
+        lua.posY = (i / 4 - 0.5f) * 6.0f;
+        lua.posZ = -20.0f;
+        lua.centroLocal = malha.centro;
+        lua.raioLocal = malha.raio;
+        lua.oclusor = malha.oclusor;
+        objetos.push_back(lua);
+    }
+    unsigned semente = 21;
+    for (int i = 0; i < 20000; i++)
+    {
+        Object pequeno;
+        pequeno.posX = (aleatorioBenchmark(semente) - 0.5f) * 40.0f;
+        pequeno.posY = (aleatorioBenchmark(semente) - 0.5f) * 20.0f;
+        pequeno.posZ = -25.0f - aleatorioBenchmark(semente) * 60.0f;
+        pequeno.raioLocal = 0.3f;
+        objetos.push_back(pequeno);
+    }
+    atualizarTransformacoes(objetos, 0.0f);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+
+    BufferOclusao buffer;
+    const int frames = 120;
+    double msTotal = 0.0;
+    long ocultos = 0, visiveis = 0;
+    size_t triangulos = 0;
+    for (int f = 0; f < frames; f++)
+    {
+        glm::vec3 olho((f - frames / 2) * 0.1f, 0.0f, 0.0f);
+        glm::mat4 viewProjection = projection * glm::lookAt(olho, olho + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        visiveis += cullingPorFrustum(objetos, viewProjection);
+        ocultos += cullingPorOclusao(buffer, objetos, viewProjection);
+        msTotal += buffer.msUltimoFrame;
+        triangulos += buffer.triangulos.size();
+    }
+    encerrarSistemaDeJobs(sistemaDeJobs);
+
+    cout << std::fixed << std::setprecision(3) << "Oclusao: " << malha.oclusor->size() / 3 << " triangulos por lua, buffer " << BufferOclusao::LARGURA << "x"
+         << BufferOclusao::ALTURA << endl;
+    cout << "  " << msTotal / frames << " ms por frame, " << triangulos / frames << " triangulos rasterizados, " << ocultos / frames << " de "
+         << visiveis / frames << " objetos no frustum ocultos" << endl;
+    return 0;
+}
+
+// Escolhe o alvo das consultas (o conservador só existe a partir da OpenGL 4.3) e compila o shader das caixas
+void iniciarConsultasDeOclusao(ConsultasDeOclusao &consultas, GLuint VAOCubo)
+{
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    consultas.alvo = (major > 4 || (major == 4 && minor >= 3)) ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED;
+    consultas.programa = setupShaderCaixa();
+    consultas.locMVP = glGetUniformLocation(consultas.programa, "mvp");
+    consultas.VAOCubo = VAOCubo;
+    cout << "Consultas de oclusao com " << (consultas.alvo == GL_ANY_SAMPLES_PASSED_CONSERVATIVE ? "GL_ANY_SAMPLES_PASSED_CONSERVATIVE" : "GL_ANY_SAMPLES_PASSED") << endl;
+}
+
+// Antes de desenhar um objeto: lê o resultado da última consulta se ele já chegou (sem esperar a GPU) e abre o
+// desenho condicional. Com GL_QUERY_NO_WAIT, se o resultado ainda não chegou a GPU desenha o objeto normalmente.
+// Retorna true se o desenho condicional foi aberto (e precisa de glEndConditionalRender)
+bool iniciarDesenhoCondicional(ConsultasDeOclusao &consultas, Object &obj)
+{
+    if (modoOclusao != OCLUSAO_CONSULTAS || !obj.consultaDeOclusao || !obj.consultaValida) return false;
+
+    GLuint disponivel = 0;
+    glGetQueryObjectuiv(obj.consulta, GL_QUERY_RESULT_AVAILABLE, &disponivel);
+    if (disponivel)
+    {
+        GLuint passou = 0;
+        glGetQueryObjectuiv(obj.consulta, GL_QUERY_RESULT, &passou);
+        obj.visivelNaConsulta = passou != 0;
+        if (!passou) consultas.puladosFrameAtual++; // a GPU vai descartar este desenho
+    }
+    glBeginConditionalRender(obj.consulta, GL_QUERY_NO_WAIT);
+    return true;
+}
+
+// Depois de todos os objetos desenhados: desenha a caixa de cada objeto no frustum numa consulta, sem escrever cor
+// nem profundidade. Coerência temporal: objetos ocultos são consultados todo frame (para reaparecerem logo) e os
+// visíveis só a cada intervaloConsultasVisiveis frames, continuando a ser desenhados com o último resultado
+void emitirConsultasDeOclusao(ConsultasDeOclusao &consultas, std::vector<Object> &objs, const glm::mat4 &viewProjection, glm::vec3 posCamera)
+{
+    consultas.frame++;
+    consultas.emitidasUltimoFrame = 0;
+    consultas.puladosUltimoFrame = consultas.puladosFrameAtual;
+    consultas.pulados += consultas.puladosFrameAtual;
+    consultas.puladosFrameAtual = 0;
+
+    glUseProgram(consultas.programa);
+    glBindVertexArray(consultas.VAOCubo);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    for (Object &obj : objs)
+    {
+        // Fora do frustum o resultado antigo não vale mais: ao voltar, o objeto é desenhado sem condição até a nova consulta
+        if (!obj.visivel || !obj.consultaDeOclusao)
+        {
+            obj.consultaValida = false;
+            continue;
+        }
+        CaixaEnvolvente caixa = caixaDoObjeto(obj);
+
+        // Com a câmera dentro da caixa (aumentada por mais que o plano near) as faces da frente são recortadas e
+        // a consulta poderia dar oculto para um objeto visível
+        const float folga = 0.2f;
+        if (posCamera.x > caixa.minimo.x - folga && posCamera.y > caixa.minimo.y - folga && posCamera.z > caixa.minimo.z - folga &&
+            posCamera.x < caixa.maximo.x + folga && posCamera.y < caixa.maximo.y + folga && posCamera.z < caixa.maximo.z + folga)
+        {
+            obj.consultaValida = false;
+            obj.visivelNaConsulta = true;
+            continue;
+        }
+        if (obj.consultaValida && obj.visivelNaConsulta && consultas.frame < obj.proximaConsulta) continue;
+
+        if (!obj.consulta) glGenQueries(1, &obj.consulta);
+        glm::mat4 caixaModel = glm::translate(glm::mat4(1.0f), (caixa.minimo + caixa.maximo) * 0.5f);
+        caixaModel = glm::scale(caixaModel, (caixa.maximo - caixa.minimo) * 0.5f);
+        glm::mat4 mvp = viewProjection * caixaModel;
+        glUniformMatrix4fv(consultas.locMVP, 1, GL_FALSE, glm::value_ptr(mvp));
+        glBeginQuery(consultas.alvo, obj.consulta);
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+        glEndQuery(consultas.alvo);
+
+        obj.consultaValida = true;
+        obj.proximaConsulta = consultas.frame + intervaloConsultasVisiveis;
+        consultas.emitidasUltimoFrame++;
+    }
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+    glBindVertexArray(0);
+    consultas.emitidas += consultas.emitidasUltimoFrame;
+}
+
+void encerrarConsultasDeOclusao(ConsultasDeOclusao &consultas, std::vector<Object> &objs)
+{
+    for (Object &obj : objs)
+    {
+        if (obj.consulta) glDeleteQueries(1, &obj.consulta);
+        obj.consulta = 0;
+    }
+    if (consultas.programa) glDeleteProgram(consultas.programa);
+    consultas.programa = 0;
+}